@@ -24,5 +24,6 @@ static std::map<const char*, const char*> DefaultSettings({
     { "plugins/plugins_directory", "./Plugins" },
     { "filesystem/game", "NieRAutomata" },
     { "filesystem/subdir", "data" },
-    { "filesystem/fallback", "C:/" }
+    { "filesystem/fallback", "C:/" },
+    { "filesystem/prefetch", "true" }
     });
@@ -20,6 +20,8 @@
 
 #include <QtWidgets/QMainWindow>
 
+#include <vector>
+
 #define NAOQT_VERSION_MAJOR 1
 #define NAOQT_VERSION_MINOR 0
 
@@ -28,6 +30,11 @@ class QLineEdit;
 class QTreeWidget;
 class QTreeWidgetItem;
 
+class NTreeNode;
+
+template <typename T>
+class NaoVector;
+
 class NaoQt : public QMainWindow {
     Q_OBJECT
 
@@ -67,6 +74,36 @@ class NaoQt : public QMainWindow {
     void _load_plugins();
     void _init_filesystem();
     void _move_async(const QString& to, bool _refresh = false);
+    void _refresh_async();
+
+    // Everything a row shows, so nodes are only read while they can't change
+    struct Row {
+        NTreeNode* node;
+        QString name;
+        QString display_name;
+        QString path;
+        QString description;
+        bool dir;
+        int64_t size;
+        double ratio;
+        bool exists;
+    };
+
+    // Reads a node's row, on the thread that changes the tree or while holding the read lock
+    static Row _make_row(NTreeNode* node);
+
+    // Fills in a row, doesn't touch the node
+    void _fill_item(QTreeWidgetItem* item, const Row& row) const;
+
+    // Clears the view for new rows
+    void _begin_rows();
+
+    // Adds rows for nodes, unsorted
+    void _add_rows(const NaoVector<NTreeNode*>& nodes);
+    void _add_rows(const std::vector<Row>& rows);
+
+    // Shows the node whose rows were added, then sizes and sorts the view
+    void _end_rows(NTreeNode* node);
 
     // Private members
 
@@ -28,6 +28,7 @@
 #include <Filesystem/NaoFileSystemManager.h>
 #include <Filesystem/Filesystem.h>
 #include <Filesystem/NTreeNode.h>
+#include <Plugin/NaoPlugin.h>
 #include <Utils/SteamUtils.h>
 #include <Utils/DesktopUtils.h>
 #include <UI/NaoUIManager.h>
@@ -45,6 +46,8 @@
 #include <QFileDialog>
 #include <QMetaType>
 
+#include <unordered_set>
+
 #ifdef N_WINDOWS
 #   include <shellapi.h>
 #endif
@@ -115,7 +118,7 @@ void NaoQt::_load_settings() {
     for (const std::pair<const char*, const char*> pair : DefaultSettings) {
         // If a key doesn't exist
         if (!existings_keys.contains(pair.first)) {
-            // Use it's default value
+            // Use its default value
             settings.setValue(pair.first, pair.second);
         }
 
@@ -256,6 +259,8 @@ void NaoQt::_init_filesystem() {
         _m_settings.at("filesystem/subdir"),
         _m_settings.at("filesystem/fallback"));
 
+    NFSM.set_prefetch_enabled(_m_settings.at("filesystem/prefetch") == "true");
+
     auto future_watcher = new QFutureWatcher<bool>(this);
 
     connect(future_watcher, &QFutureWatcher<bool>::finished, this, [future_watcher, this] {
@@ -289,11 +294,23 @@ void NaoQt::_move_async(const QString& to, bool _refresh) {
 
     _is_moving = true;
 
+    // Whether rows were added while the node was being populated
+    auto streamed = std::make_shared<bool>(false);
+
     auto future_watcher = new QFutureWatcher<bool>(this);
 
-    (void) connect(future_watcher, &QFutureWatcher<bool>::finished, this, [future_watcher, this] {
+    (void) connect(future_watcher, &QFutureWatcher<bool>::finished, this, [future_watcher, streamed, this] {
         if (future_watcher->isCanceled() || !future_watcher->result()) {
             QMessageBox::critical(this, "NaoFSM::move", "Move error");
+
+            // Go back to the node we're still at
+            if (*streamed) {
+                fsm_object_changed();
+            }
+        } else if (*streamed) {
+            const auto lock = NFSM.read_lock();
+
+            _end_rows(NFSM.current());
         } else {
             fsm_object_changed();
         }
@@ -303,7 +320,154 @@ void NaoQt::_move_async(const QString& to, bool _refresh) {
 
     (void) connect(future_watcher, &QFutureWatcher<bool>::finished, &QFutureWatcher<bool>::deleteLater);
 
-    future_watcher->setFuture(QtConcurrent::run(&NFSM, &NaoFileSystemManager::move, to));
+    // Batches arrive on the moving thread, rows are added on ours, always before finished() is handled.
+    // The nodes may be moved or freed by the time the rows are added, so they're read right away
+    NaoPlugin::PopulateCallback callback = [to, streamed, this](const NaoVector<NTreeNode*>& batch) {
+        std::vector<Row> rows;
+        rows.reserve(std::size(batch));
+
+        for (NTreeNode* node : batch) {
+            rows.push_back(_make_row(node));
+        }
+
+        (void) QMetaObject::invokeMethod(this, [to, rows = std::move(rows), streamed, this] {
+            if (!*streamed) {
+                *streamed = true;
+
+                _begin_rows();
+                _m_path_display->setText(to);
+            }
+
+            _add_rows(rows);
+        }, Qt::QueuedConnection);
+    };
+
+    future_watcher->setFuture(QtConcurrent::run([to, callback] {
+        return NFSM.move(to, callback);
+    }));
+}
+
+void NaoQt::_refresh_async() {
+    if (_is_moving) {
+        nerr << "Already moving";
+        return;
+    }
+
+    _is_moving = true;
+
+    auto changes = std::make_shared<NaoPlugin::Changes>();
+    auto future_watcher = new QFutureWatcher<bool>(this);
+
+    (void) connect(future_watcher, &QFutureWatcher<bool>::finished, this, [future_watcher, changes, this] {
+        _is_moving = false;
+
+        // Can't be refreshed incrementally, populate again instead
+        if (future_watcher->isCanceled() || !future_watcher->result()) {
+            _move_async(NFSM.current()->path(), true);
+            return;
+        }
+
+        if (std::size(changes->added) == 0
+            && std::size(changes->removed) == 0
+            && std::size(changes->modified) == 0) {
+            return;
+        }
+
+        const auto lock = NFSM.read_lock();
+
+        nlog << "Refreshed with" << std::size(changes->added) << "added,"
+            << std::size(changes->removed) << "removed and"
+            << std::size(changes->modified) << "modified";
+
+        // Modified rows are recreated
+        std::unordered_set<NTreeNode*> outdated(changes->removed.begin(), changes->removed.end());
+        outdated.insert(changes->modified.begin(), changes->modified.end());
+
+        for (int i = _m_tree_widget->topLevelItemCount() - 1; i >= 0; --i) {
+            NTreeNode* node = _m_tree_widget->topLevelItem(i)->data(0, NodeRole).value<NTreeNode*>();
+
+            if (outdated.count(node) > 0) {
+                delete _m_tree_widget->takeTopLevelItem(i);
+            }
+        }
+
+        _add_rows(changes->added);
+        _add_rows(changes->modified);
+
+        // Re-sort
+        view_sort_column(_m_tree_widget->header()->sortIndicatorSection(), _m_tree_widget->header()->sortIndicatorOrder());
+    });
+
+    (void) connect(future_watcher, &QFutureWatcher<bool>::finished, &QFutureWatcher<bool>::deleteLater);
+
+    future_watcher->setFuture(QtConcurrent::run([changes] {
+        return NFSM.refresh(*changes);
+    }));
+}
+
+NaoQt::Row NaoQt::_make_row(NTreeNode* node) {
+    Row row { node, node->name(), node->display_name(), node->path(),
+        NFSM.description(node), node->is_dir(), -1, 1., true };
+
+    if (!row.dir) {
+        NaoIO* io = node->io();
+
+        row.size = io->size();
+        row.ratio = io->size() / double(io->virtual_size());
+
+        // If the file doesn't exist it can be compressed
+        row.exists = QFile(row.path).exists();
+    }
+
+    return row;
+}
+
+void NaoQt::_fill_item(QTreeWidgetItem* item, const Row& row) const {
+    // Static file provider
+    static QFileIconProvider ficonprovider;
+
+    // Display name
+    item->setText(0, row.display_name);
+
+    // Description
+    item->setText(2, row.description);
+
+    // If it's a directory
+    item->setData(0, IsDirectoryRole, row.dir);
+
+    // Set the node
+    item->setData(0, NodeRole, QVariant::fromValue(row.node));
+
+    // Icon based on if it's a directory or not
+    if (row.dir) {
+        // Folder icon
+        item->setIcon(0, ficonprovider.icon(QFileIconProvider::Folder));
+
+        // No size
+        item->setData(1, ItemSizeRole, -1i64);
+    } else {
+        // Icon from existing file
+        item->setIcon(0, ficonprovider.icon(QFileInfo(row.path)));
+
+        // Set real size attributes
+        item->setText(1, NaoString::bytes(row.size));
+        item->setData(1, ItemSizeRole, row.size);
+
+        // If no description was set
+        if (item->text(2).isEmpty()) {
+            // Try to retrieve it
+            static QMimeDatabase db;
+            item->setText(2, db.mimeTypeForUrl(
+                QUrl::fromLocalFile(row.name)).comment());
+        }
+
+        // Compression ratio
+        item->setData(3, CompressionRatioRole, row.ratio);
+
+        if (!row.exists) {
+            item->setText(3, QString("%0%").arg(qRound(100. * row.ratio)));
+        }
+    }
 }
 
 //// Slots
@@ -360,6 +524,67 @@ void NaoQt::view_context_menu(const QPoint& pos) {
         }
 
     } else {
+        NTreeNode* node = item->data(0, NodeRole).value<NTreeNode*>();
+
+        NaoPlugin* plugin = nullptr;
+        NaoVector<NaoAction*> actions;
+
+        {
+            const auto lock = NFSM.read_lock();
+
+            if ((plugin = NPM.populate_plugin(node))) {
+                actions = plugin->actions(node);
+            }
+
+            // Files inside an archive get their actions from the archive's plugin
+            if (actions.empty() && node->parent() && (plugin = NPM.populate_plugin(node->parent()))) {
+                actions = plugin->actions(node);
+            }
+        }
+
+        if (!actions.empty()) {
+            nlog << NaoString("Using plugin \"" + plugin->display_name() + '"');
+
+            menu->addSection(plugin->display_name());
+
+            // Actions that weren't triggered are deleted along with the menu
+            auto pending = std::make_shared<NaoVector<NaoAction*>>(actions);
+            connect(menu, &QObject::destroyed, [pending] {
+                for (NaoAction* action : *pending) {
+                    delete action;
+                }
+            });
+
+            for (NaoAction* action : actions) {
+                QAction* act = new QAction(action->name(), menu);
+                connect(act, &QAction::triggered, this, [this, action, node, pending] {
+                    pending->erase(std::find(std::begin(*pending), std::end(*pending), action));
+
+                    // The node, its archive and their IO's must survive moving elsewhere while the action runs
+                    NFSM.lock(node);
+
+                    auto watcher = new QFutureWatcher<bool>(this);
+                    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, action, node, watcher] {
+                        NFSM.unlock(node);
+
+                        if (!watcher->result()) {
+                            QMessageBox::warning(this, "Action failed",
+                                "Failed executing action \"" + action->name() + "\"");
+                        }
+
+                        delete action;
+                    });
+                    connect(watcher, &QFutureWatcher<bool>::finished, &QFutureWatcher<bool>::deleteLater);
+
+                    watcher->setFuture(QtConcurrent::run([action, node] { return action->execute(node); }));
+                });
+
+                menu->addAction(act);
+            }
+
+            nlog << "Added" << std::size(actions) << "action(s)";
+        }
+
         /*NaoObject* object = item->data(0, ObjectRole).value<NaoObject*>();
 
         nlog << "Object name:" << object->name();
@@ -535,7 +760,7 @@ void NaoQt::view_up() {
 }
 
 void NaoQt::view_refresh() {
-    _move_async(NFSM.current()->path(), true);
+    _refresh_async();
 }
 
 void NaoQt::open_folder() {
@@ -575,82 +800,57 @@ void NaoQt::path_display_changed() {
 }
 
 void NaoQt::fsm_object_changed() {
+    // Keep the tree from changing while we read it
+    const auto lock = NFSM.read_lock();
+
     // Retrieve current node
     NTreeNode* current_object = NFSM.current();
 
-    // Disable buttons as needed
-    NTreeNode* parent = current_object->parent();
-    if (!parent) {
-        _m_up_button->setEnabled(false);
-    } else {
-        _m_up_button->setEnabled(true);
-    }
+    _begin_rows();
+    _add_rows(current_object->children());
+    _end_rows(current_object);
+}
 
+void NaoQt::_begin_rows() {
     // Clear view
     _m_tree_widget->clear();
+}
 
-    // Set path display to path of current object
-    _m_path_display->setText(current_object->path());
+void NaoQt::_add_rows(const NaoVector<NTreeNode*>& nodes) {
+    std::vector<Row> rows;
+    rows.reserve(std::size(nodes));
 
-    // Static file provider
-    static QFileIconProvider ficonprovider;
+    for (NTreeNode* child : nodes) {
+        rows.push_back(_make_row(child));
+    }
+
+    _add_rows(rows);
+}
 
-    // Iterate over all children
-    for (NTreeNode* const& child : current_object->children()) {
+void NaoQt::_add_rows(const std::vector<Row>& rows) {
+    // Iterate over all rows
+    for (const Row& row : rows) {
         // New item
         QTreeWidgetItem* item = new QTreeWidgetItem(_m_tree_widget);
 
-        // Display name
-        item->setText(0, child->display_name());
-
-        // Description
-        item->setText(2, NFSM.description(child));
-
-        // If it's a directory
-        item->setData(0, IsDirectoryRole, child->is_dir());
-
-        // Set the node
-        item->setData(0, NodeRole, QVariant::fromValue(child));
-
-        // Icon based on if it's a directory or not
-        if (child->is_dir()) {
-            // Folder icon
-            item->setIcon(0, ficonprovider.icon(QFileIconProvider::Folder));
-
-            // No size
-            item->setData(1, ItemSizeRole, -1i64);
-        } else {
-            // Icon from existing file
-            item->setIcon(0, ficonprovider.icon(QFileInfo(child->path())));
-
-            // Store IO
-            NaoIO* io = child->io();
-
-            // Set real size attributes
-            item->setText(1, NaoString::bytes(io->size()));
-            item->setData(1, ItemSizeRole, io->size());
-
-            // If no description was set
-            if (item->text(2).isEmpty()) {
-                // Try to retrieve it
-                static QMimeDatabase db;
-                item->setText(2, db.mimeTypeForUrl(
-                    QUrl::fromLocalFile(child->name())).comment());
-            }
-
-            // Compression ratio
-            double ratio = io->size() / double(io->virtual_size());
-            item->setData(3, CompressionRatioRole, ratio);
-
-            // If the file doesn't exist it can be compressed
-            if (!QFile(child->path()).exists()) {
-                item->setText(3, QString("%0%").arg(qRound(100. * ratio)));
-            }
-        }
+        _fill_item(item, row);
 
         // Add item
         _m_tree_widget->addTopLevelItem(item);
     }
+}
+
+void NaoQt::_end_rows(NTreeNode* node) {
+    // Disable buttons as needed
+    NTreeNode* parent = node->parent();
+    if (!parent) {
+        _m_up_button->setEnabled(false);
+    } else {
+        _m_up_button->setEnabled(true);
+    }
+
+    // Set path display to path of the node
+    _m_path_display->setText(node->path());
 
     // Resize all columns
     for (int i = 0; i < _m_tree_widget->columnCount(); ++i) {
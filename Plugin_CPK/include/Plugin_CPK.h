@@ -28,40 +28,67 @@ class Plugin_CPK final : public NaoPlugin {
     public:
     Plugin_CPK() = default;
 
-    N_NODISCARD NaoString Name() const override;
-    N_NODISCARD NaoString DisplayName() const override;
-    N_NODISCARD NaoString PluginDescription() const override;
-    N_NODISCARD NaoString VersionString() const override;
+    N_NODISCARD NaoString name() const override;
+    N_NODISCARD NaoString display_name() const override;
+    N_NODISCARD NaoString plugin_description() const override;
+    N_NODISCARD NaoString version_string() const override;
 
-    N_NODISCARD NaoString AuthorName() const override;
-    N_NODISCARD NaoString AuthorDescription() const override;
+    N_NODISCARD NaoString author_name() const override;
+    N_NODISCARD NaoString author_description() const override;
 
-    N_NODISCARD bool HasDescription(NaoObject* object) override;
-    N_NODISCARD bool PrioritiseDescription() const override;
-    N_NODISCARD NaoString Description() const override;
+    N_NODISCARD NaoVector<Signature> signatures() const override;
 
-    N_NODISCARD bool CanEnter(NaoObject* object) override;
-    bool Enter(NaoObject* object) override;
+    N_NODISCARD bool can_populate(NTreeNode* node) override;
+    bool populate(NTreeNode* node) override;
+    bool populate_batched(NTreeNode* node, const PopulateCallback& callback) override;
 
-    N_NODISCARD bool ShouldLeave(NaoObject* object) override;
-    bool Leave(NaoObject* object) override;
+    N_NODISCARD bool has_description(NTreeNode* node) override;
+    N_NODISCARD NaoString description(NTreeNode* node) override;
 
-    N_NODISCARD bool HasContextMenu(NaoObject* object) override;
-    //N_NODISCARD NaoVector<NaoAction*> ContextMenu(NaoObject* object) override;
+    N_NODISCARD NaoVector<NaoAction*> actions(NTreeNode* node) override;
 
-    N_NODISCARD Event SubscribedEvents() const override;
-    bool TriggerEvent(Event event, EventArgs* args) override;
+    private:
+    // The node itself or its nearest ancestor that is a CPK archive, or nullptr
+    N_NODISCARD static NTreeNode* _archive_of(NTreeNode* node);
+
+    // Builds the directory tree below node, which is the archive or a directory inside it.
+    // Only node and its new descendants are changed, the archive is only read from
+    static bool _populate_archive(NTreeNode* archive, NTreeNode* node, const PopulateCallback& callback);
+};
 
-    N_NODISCARD bool ProvidesNewRoot(NaoObject* from, NaoObject* to) override;
-    N_NODISCARD NaoObject* NewRoot(NaoObject* from, NaoObject* to) override;
+// Extracts a single file from the archive it's in
+class ExtractOneAction final : public NaoAction {
+    public:
+    ExtractOneAction(NaoPlugin* parent, NTreeNode* archive);
 
-    N_NODISCARD bool ProvidesChild(const NaoString& name) override;
-    N_NODISCARD NaoObject* GetChild(const NaoString& name) override;
+    N_NODISCARD NaoString name() const override;
+    bool execute(NTreeNode* node) override;
 
     private:
-    NaoObject* _m_root;
-    bool _m_state;
-    NaoVector<NaoObject*> _m_children;
+    NTreeNode* _m_archive;
+};
+
+// Extracts a directory inside an archive, including all subdirectories
+class ExtractDirectoryAction final : public NaoAction {
+    public:
+    ExtractDirectoryAction(NaoPlugin* parent, NTreeNode* archive);
+
+    N_NODISCARD NaoString name() const override;
+    bool execute(NTreeNode* node) override;
 
-    bool MoveEvent(MoveEventArgs* args);
+    private:
+    NTreeNode* _m_archive;
+};
+
+// Extracts every file in the archive to a folder, keeping the directory layout
+class ExtractAllAction final : public NaoAction {
+    public:
+    // Recursive extraction also extracts the contents of archives inside the archive
+    ExtractAllAction(NaoPlugin* parent, bool recursive);
+
+    N_NODISCARD NaoString name() const override;
+    bool execute(NTreeNode* node) override;
+
+    private:
+    bool _m_recursive;
 };
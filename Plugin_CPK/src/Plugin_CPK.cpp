@@ -20,10 +20,13 @@
 #define N_LOG_ID "Plugin_CPK"
 #include <Logging/NaoLogging.h>
 #include <NaoObject.h>
+#include <Filesystem/NTreeNode.h>
 #include <IO/NaoIO.h>
+#include <Utils/ArchiveUtils.h>
+#include <Utils/DesktopUtils.h>
+#include <Decoding/Archives/NaoArchiveFormat.h>
 #include <Decoding/Archives/NaoCPKReader.h>
 #include <Decoding/NaoDecodingException.h>
-#include <Plugin/NaoPluginManager.h>
 
 NaoPlugin* GetNaoPlugin() {
     return new Plugin_CPK();
@@ -31,31 +34,31 @@ NaoPlugin* GetNaoPlugin() {
 
 #pragma region Plugin info
 
-NaoString Plugin_CPK::Name() const {
+NaoString Plugin_CPK::name() const {
     return "libnao CPK plugin";
 }
 
-NaoString Plugin_CPK::DisplayName() const {
+NaoString Plugin_CPK::display_name() const {
     return "libnao CPK";
 }
 
-NaoString Plugin_CPK::PluginDescription() const {
+NaoString Plugin_CPK::plugin_description() const {
     return "Adds support for CPK archives";
 }
 
-NaoString Plugin_CPK::VersionString() const {
-    return "1.1";
+NaoString Plugin_CPK::version_string() const {
+    return "1.4";
 }
 
 #pragma endregion 
 
 #pragma region Author info
 
-NaoString Plugin_CPK::AuthorName() const {
+NaoString Plugin_CPK::author_name() const {
     return "TypeA2/I_Copy_Jokes";
 }
 
-NaoString Plugin_CPK::AuthorDescription() const {
+NaoString Plugin_CPK::author_description() const {
     return "License: LGPLv3 or later<br>"
         "<a href=\"https://github.com/TypeA2\">Github</a><br>"
         "<a href=\"https://steamcommunity.com/id/TypeA2/\">Steam</a>";
@@ -63,228 +66,291 @@ NaoString Plugin_CPK::AuthorDescription() const {
 
 #pragma endregion 
 
-#pragma region Description
+#pragma region Format detection
+
+// Whether a file node is a CPK archive
+static bool is_cpk(NTreeNode* node) {
+    const NaoBytes header = node->io()->read_singleshot(NaoArchiveFormat::header_size());
 
-bool Plugin_CPK::HasDescription(NaoObject* object) {
-    return !object->is_dir()
-        && object->file_ref().io->read_singleshot(4) == NaoBytes("CPK ", 4);
+    return NaoArchiveFormat::detect(header.const_data(), std::size(header)) == NaoArchiveFormat::CPK;
 }
 
-bool Plugin_CPK::PrioritiseDescription() const {
-    return true;
+NaoVector<NaoPlugin::Signature> Plugin_CPK::signatures() const {
+    // The magic is only listed by libnao, so the plugin and NaoArchiveFormat detect the same files
+    NaoVector<Signature> result = NaoArchiveFormat::signatures(NaoArchiveFormat::CPK);
+
+    for (Signature& signature : result) {
+        signature.capabilities = Populate | Description;
+    }
+
+    return result;
 }
 
-NaoString Plugin_CPK::Description() const {
+#pragma endregion
+
+#pragma region Description
+
+bool Plugin_CPK::has_description(NTreeNode* node) {
+    return !node->is_dir() && is_cpk(node);
+}
+
+NaoString Plugin_CPK::description(N_UNUSED NTreeNode* node) {
     return "CPK Archive";
 }
 
 #pragma endregion 
 
-#pragma region Actions 
+#pragma region Populating
+
+bool Plugin_CPK::can_populate(NTreeNode* node) {
+    // Either the archive itself or a directory inside one
+    return _archive_of(node) != nullptr;
+}
 
-bool Plugin_CPK::CanEnter(NaoObject* object) {
-    if (_m_state) {
-        // Is root
-        if (object->name() == _m_root->name()) {
-            return true;
-;       }
+bool Plugin_CPK::populate(NTreeNode* node) {
+    return populate_batched(node, nullptr);
+}
 
-        // Is a known child
-        for (NaoObject* child : _m_children) {
-            if (child->is_dir()
-                && child->name() == object->name()) {
-                return true;
-            }
-        }
+bool Plugin_CPK::populate_batched(NTreeNode* node, const PopulateCallback& callback) {
+    NTreeNode* archive = _archive_of(node);
+
+    if (!archive) {
+        nerr << "Node is not inside a CPK archive";
+        return false;
     }
 
-    // Is a CPK archive
-    return !object->is_dir()
-        && object->file_ref().io->read_singleshot(4) == NaoBytes("CPK ", 4);
+    // The node may be populated outside of the tree, so the archive itself is only read from
+    return _populate_archive(archive, node, callback);
 }
 
-bool Plugin_CPK::Enter(NaoObject* object) {
-    if (!_m_state) {
-        NaoIO* io = object->file_ref().io;
+// Path of a node relative to the archive it's in, as stored in the archive
+static NaoString path_in_archive(NTreeNode* archive, NTreeNode* node) {
+    NaoString path = node->name();
 
-        NaoCPKReader* reader = nullptr;
-        try {
-            reader = new NaoCPKReader(io);
-        } catch (const NaoDecodingException & e) {
-            nerr << e.what();
-            return false;
-        }
-
-        for (NaoObject* file : reader->take_files()) {
-            file->set_name(object->name() + N_PATHSEP + file->name());
+    for (NTreeNode* parent = node->parent(); parent && parent != archive; parent = parent->parent()) {
+        path = parent->name() + N_PATHSEP + path;
+    }
 
-            // I don't even know why this check is needed
-            // but everything explodes without it
-            if (!std::empty(file->description())) {
-                PluginManager.set_description(file);
-            }
+    return path;
+}
 
-            _m_children.push_back(file);
+NTreeNode* Plugin_CPK::_archive_of(NTreeNode* node) {
+    while (node) {
+        if (!node->is_dir()) {
+            return is_cpk(node) ? node : nullptr;
         }
 
-        delete reader;
+        node = node->parent();
+    }
+
+    return nullptr;
+}
+
+bool Plugin_CPK::_populate_archive(NTreeNode* archive, NTreeNode* node, const PopulateCallback& callback) {
+    // Entries below the node start with this, nothing for the archive itself
+    const NaoString prefix = (node == archive) ? NaoString() : (path_in_archive(archive, node) + N_PATHSEP);
 
-        _m_root = object;
-        _m_state = true;
+    NaoCPKReader* reader = nullptr;
+    try {
+        reader = new NaoCPKReader(archive->io());
+    } catch (const NaoDecodingException& e) {
+        nerr << e.what();
+        return false;
     }
-    
-    const NaoString& subpath = object->name();
-   
-    for (NaoObject* file : _m_children) {
-        if (file == object) {
+
+    BatchEmitter emitter(callback);
+
+    const NaoVector<NaoArchiveIndexCache::Entry>& entries = reader->entries();
+
+    for (size_t index = 0; index < std::size(entries); ++index) {
+        const NaoArchiveIndexCache::Entry& entry = entries[index];
+
+        // Entries elsewhere in the archive, or the node itself
+        if (!entry.name.starts_with(prefix) || std::size(entry.name) == std::size(prefix)) {
             continue;
         }
 
-        if (file->direct_child_of(subpath)) {
-            object->add_child(file);
+        // Paths in archives are short, this keeps the components out of the heap
+        const NaoSmallVector<NaoString, 8> parts = entry.name.substr(std::size(prefix)).split_small(N_PATHSEP);
+
+        NTreeNode* parent = node;
+
+        // Directories leading up to this entry, including the entry itself if it's a directory
+        const size_t dirs = entry.is_dir ? std::size(parts) : (std::size(parts) - 1);
+
+        for (size_t i = 0; i < dirs; ++i) {
+            NTreeNode* next = parent->get_child(parts[i]);
+
+            if (!next) {
+                next = new NTreeNode(parts[i], parent);
+
+                if (parent == node) {
+                    emitter.add(next);
+                }
+            }
+
+            next->set_populated(true);
+            parent = next;
+        }
+
+        if (!entry.is_dir && !parent->has_child(parts.back())) {
+            // Only entries that end up in the tree get an IO
+            NTreeNode* child = new NTreeNode(parts.back(), parent);
+            child->set_io(reader->open_entry(index));
+
+            if (parent == node) {
+                emitter.add(child);
+            }
         }
     }
 
-    return true;
-}
+    delete reader;
 
-bool Plugin_CPK::ShouldLeave(NaoObject* object) {
-    return object->is_child_of(_m_root) || object == _m_root;
-}
+    emitter.flush();
 
-bool Plugin_CPK::Leave(NaoObject* object) {
+    node->set_populated(true);
     return true;
 }
 
-bool Plugin_CPK::HasContextMenu(NaoObject* object) {
-    return false;
-}
+#pragma endregion
 
-NaoPlugin::Event Plugin_CPK::SubscribedEvents() const {
-    return Move;
-}
+#pragma region Actions
 
-bool Plugin_CPK::TriggerEvent(Event event, EventArgs* args) {
-    if (!args) {
-        return false;
-    }
+NaoVector<NaoAction*> Plugin_CPK::actions(NTreeNode* node) {
+    NaoVector<NaoAction*> actions;
 
-    switch (event) {
-        case Move:
-            return MoveEvent(static_cast<MoveEventArgs*>(args));
+    if (node->is_dir()) {
+        if (NTreeNode* archive = _archive_of(node)) {
+            actions.push_back(new ExtractDirectoryAction(this, archive));
+        }
 
-        default:
-            return false;
+        return actions;
     }
-}
 
-bool Plugin_CPK::MoveEvent(MoveEventArgs* args) {
-    if (!args->from || !args->to) {
-        return false;
+    // A file inside an archive, which may be an archive itself as well
+    if (NTreeNode* archive = _archive_of(node->parent())) {
+        actions.push_back(new ExtractOneAction(this, archive));
     }
 
-    auto [from, to] = *args;
+    if (_archive_of(node) == node) {
+        actions.push_back(new ExtractAllAction(this, false));
+        actions.push_back(new ExtractAllAction(this, true));
+    }
+
+    return actions;
+}
 
-    if (_m_state) {
-        // Exiting this archive, free up everything
-        if (!(to->name().starts_with(_m_root->name()))) {
-            nlog << "Leaving archive";
+/*
+ * Extracts all files in archive whose path starts with prefix: everything for an empty prefix,
+ * a directory if it ends with a separator and a single file otherwise. Files in a directory are
+ * written to target followed by the rest of their path after the prefix, a single file to target.
+ */
+static bool extract(NTreeNode* archive, const NaoString& prefix, const NaoString& target, bool recursive = false) {
+    const bool whole_dir = std::empty(prefix) || prefix.ends_with(N_PATHSEP);
+
+    return ArchiveUtils::extract(archive, [&](NaoIO* io, NaoVector<ArchiveUtils::File>& files) {
+        const NaoCPKReader reader(io);
+
+        // Only the index is scanned, matching files are read straight from the archive
+        for (const NaoArchiveIndexCache::Entry& entry : reader.entries()) {
+            if (entry.is_dir) {
+                continue;
+            }
 
-            _m_state = false;
+            const NaoString& path = entry.name;
 
-            for (NaoObject* child : _m_children) {
-                if (child == from) {
-                    continue;
-                }
-                
-                delete child;
+            if (whole_dir ? !path.starts_with(prefix) : (path != prefix)) {
+                continue;
             }
 
-            _m_children.clear();
+            // A single file's path is the whole prefix
+            files.push_back({ entry, whole_dir ? (target + path.substr(std::size(prefix))) : target });
+        }
 
-            (void) _m_root->take_children();
+        return true;
+    }, recursive);
+}
 
-            if (from != _m_root) {
-                delete _m_root;
-            }
+#pragma endregion
 
-            _m_state = false;
+#pragma region ExtractOneAction
 
-            return true;
-        }
-        
-    }
+ExtractOneAction::ExtractOneAction(NaoPlugin* parent, NTreeNode* archive)
+    : NaoAction(parent)
+    , _m_archive(archive) {
 
-    return true;
 }
 
-bool Plugin_CPK::ProvidesNewRoot(NaoObject* from, NaoObject* to) {
-    if (!_m_state) {
-        return false;
-    }
+NaoString ExtractOneAction::name() const {
+    return "Extract";
+}
+
+bool ExtractOneAction::execute(NTreeNode* node) {
+    const NaoString target = DesktopUtils::save_as_file(ArchiveUtils::existing_dir(_m_archive), node->name());
 
-    if (to->name() == _m_root->name()) {
+    if (std::empty(target)) {
         return true;
     }
 
-    for (NaoObject* child : _m_children) {
-        if (child->name() == to->name()) {
-            return true;
-        }
-    }
+    nlog << "Extracting to" << target;
 
-    return false;
+    return extract(_m_archive, path_in_archive(_m_archive, node), target);
 }
 
-NaoObject* Plugin_CPK::NewRoot(NaoObject* from, NaoObject* to) {
-    (void) from->take_children();
+#pragma endregion
 
-    if (to->name() == _m_root->name()) {
-        return _m_root;
-    }
+#pragma region ExtractDirectoryAction
 
-    for (NaoObject* child : _m_children) {
-        if (child->name() == to->name()) {
-            return child;
-        }
-    }
+ExtractDirectoryAction::ExtractDirectoryAction(NaoPlugin* parent, NTreeNode* archive)
+    : NaoAction(parent)
+    , _m_archive(archive) {
 
-    return to;
 }
 
-bool Plugin_CPK::ProvidesChild(const NaoString& name) {
-    if (!_m_state) {
-        return false;
-    }
+NaoString ExtractDirectoryAction::name() const {
+    return "Extract directory";
+}
+
+bool ExtractDirectoryAction::execute(NTreeNode* node) {
+    const NaoString out_dir = ArchiveUtils::ask_target_dir(_m_archive, node->name());
 
-    if (_m_root->name() == name) {
+    if (std::empty(out_dir)) {
         return true;
     }
 
-    for (NaoObject* child : _m_children) {
-        if (child->name() == name) {
-            return true;
-        }
-    }
+    nlog << "Extracting to" << out_dir;
 
-    return false;
+    return extract(_m_archive, path_in_archive(_m_archive, node) + N_PATHSEP, out_dir + N_PATHSEP);
 }
 
-NaoObject* Plugin_CPK::GetChild(const NaoString& name) {
-    if (_m_root->name() == name) {
-        return _m_root;
-    }
+#pragma endregion
 
-    for (NaoObject* child : _m_children) {
-        if (child->name() == name) {
-            return child;
-        }
+#pragma region ExtractAllAction
+
+ExtractAllAction::ExtractAllAction(NaoPlugin* parent, bool recursive)
+    : NaoAction(parent)
+    , _m_recursive(recursive) {
+
+}
+
+NaoString ExtractAllAction::name() const {
+    return _m_recursive ? "Extract all (recursive)" : "Extract all";
+}
+
+bool ExtractAllAction::execute(NTreeNode* node) {
+    const NaoString out_dir = ArchiveUtils::ask_target_dir(node, node->name().copy().clean_dir_name());
+
+    if (std::empty(out_dir)) {
+        return true;
     }
 
-    return nullptr;
+    nlog << "Extracting to" << out_dir;
+
+    return extract(node, NaoString(), out_dir + N_PATHSEP, _m_recursive);
 }
 
 #pragma endregion
+
 /*
 namespace Plugin {
 
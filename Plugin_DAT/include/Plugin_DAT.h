@@ -25,37 +25,47 @@ LIBNAO_PLUGIN_CALL LIBNAO_PLUGIN_DECL NaoPlugin* GetNaoPlugin();
 
 class Plugin_DAT final : public NaoPlugin {
     public:
-    N_NODISCARD NaoString Name() const override;
-    N_NODISCARD NaoString DisplayName() const override;
-    N_NODISCARD NaoString PluginDescription() const override;
-    N_NODISCARD NaoString VersionString() const override;
+    N_NODISCARD NaoString name() const override;
+    N_NODISCARD NaoString display_name() const override;
+    N_NODISCARD NaoString plugin_description() const override;
+    N_NODISCARD NaoString version_string() const override;
 
-    N_NODISCARD NaoString AuthorName() const override;
-    N_NODISCARD NaoString AuthorDescription() const override;
+    N_NODISCARD NaoString author_name() const override;
+    N_NODISCARD NaoString author_description() const override;
 
-    N_NODISCARD bool HasDescription(NaoObject* object) override;
-    N_NODISCARD bool PrioritiseDescription() const override;
-    N_NODISCARD NaoString Description() const override;
+    N_NODISCARD NaoVector<Signature> signatures() const override;
 
-    N_NODISCARD bool CanEnter(NaoObject* object) override;
-    bool Enter(NaoObject* object) override;
+    N_NODISCARD bool can_populate(NTreeNode* node) override;
+    bool populate(NTreeNode* node) override;
+    bool populate_batched(NTreeNode* node, const PopulateCallback& callback) override;
 
-    N_NODISCARD bool HasContextMenu(NaoObject* object) override;
-    NaoVector<NaoAction*> ContextMenu(NaoObject* object) override;
+    N_NODISCARD bool has_description(NTreeNode* node) override;
+    N_NODISCARD NaoString description(NTreeNode* node) override;
+
+    N_NODISCARD NaoVector<NaoAction*> actions(NTreeNode* node) override;
 };
 
-class ExtractAllAction final : public NaoAction {
+// Extracts a single file from the archive it's in
+class ExtractOneAction final : public NaoAction {
     public:
-    ExtractAllAction(NaoPlugin* parent);
+    ExtractOneAction(NaoPlugin* parent, NTreeNode* archive);
+
+    N_NODISCARD NaoString name() const override;
+    bool execute(NTreeNode* node) override;
 
-    N_NODISCARD NaoString ActionName() override;
-    bool Execute(NaoObject* object) override;
+    private:
+    NTreeNode* _m_archive;
 };
 
-class ExtractOneAction final : public NaoAction {
+// Extracts every file in the archive to a folder through the extraction pipeline
+class ExtractAllAction final : public NaoAction {
     public:
-    ExtractOneAction(NaoPlugin* parent);
+    // Recursive extraction also extracts the contents of archives inside the archive
+    ExtractAllAction(NaoPlugin* parent, bool recursive);
+
+    N_NODISCARD NaoString name() const override;
+    bool execute(NTreeNode* node) override;
 
-    N_NODISCARD NaoString ActionName() override;
-    bool Execute(NaoObject* object) override;
+    private:
+    bool _m_recursive;
 };
@@ -20,15 +20,15 @@
 #define N_LOG_ID "Plugin_DAT"
 #include <Logging/NaoLogging.h>
 #include <NaoObject.h>
-#include <IO/NaoFileIO.h>
+#include <Filesystem/NTreeNode.h>
+#include <IO/NaoIO.h>
 #include <Plugin/NaoPluginManager.h>
+#include <Utils/ArchiveUtils.h>
 #include <Utils/DesktopUtils.h>
-#include <UI/NaoUIManager.h>
-#include <UI/NProgressDialog.h>
 #include <Decoding/NaoDecodingException.h>
+#include <Decoding/Archives/NaoArchiveFormat.h>
 #include <Decoding/Archives/NaoDATReader.h>
 
-#include <numeric>
 
 NaoPlugin* GetNaoPlugin() {
     return new Plugin_DAT();
@@ -36,31 +36,31 @@ NaoPlugin* GetNaoPlugin() {
 
 #pragma region Plugin info
 
-NaoString Plugin_DAT::Name() const {
+NaoString Plugin_DAT::name() const {
     return "libnao DAT plugin";
 }
 
-NaoString Plugin_DAT::DisplayName() const {
+NaoString Plugin_DAT::display_name() const {
     return "libnao DAT";
 }
 
-NaoString Plugin_DAT::PluginDescription() const {
+NaoString Plugin_DAT::plugin_description() const {
     return "Adds support for DAT archives";
 }
 
-NaoString Plugin_DAT::VersionString() const {
-    return "1.1";
+NaoString Plugin_DAT::version_string() const {
+    return "1.4";
 }
 
 #pragma endregion 
 
 #pragma region Author info
 
-NaoString Plugin_DAT::AuthorName() const {
+NaoString Plugin_DAT::author_name() const {
     return "TypeA2/I_Copy_Jokes";
 }
 
-NaoString Plugin_DAT::AuthorDescription() const {
+NaoString Plugin_DAT::author_description() const {
     return "License: LGPLv3 or later<br>"
         "<a href=\"https://github.com/TypeA2\">Github</a><br>"
         "<a href=\"https://steamcommunity.com/id/TypeA2/\">Steam</a>";
@@ -68,246 +68,188 @@ NaoString Plugin_DAT::AuthorDescription() const {
 
 #pragma endregion 
 
-#pragma region Description
+#pragma region Format detection
+
+// Whether a file node is a DAT archive
+static bool is_dat(NTreeNode* node) {
+    const NaoBytes header = node->io()->read_singleshot(NaoArchiveFormat::header_size());
 
-bool Plugin_DAT::HasDescription(NaoObject* object) {
-    return CanEnter(object);
+    return NaoArchiveFormat::detect(header.const_data(), std::size(header)) == NaoArchiveFormat::DAT;
 }
 
-bool Plugin_DAT::PrioritiseDescription() const {
-    return false;
+NaoVector<NaoPlugin::Signature> Plugin_DAT::signatures() const {
+    // The magic is only listed by libnao, so the plugin and NaoArchiveFormat detect the same files
+    NaoVector<Signature> result = NaoArchiveFormat::signatures(NaoArchiveFormat::DAT);
+
+    for (Signature& signature : result) {
+        signature.capabilities = Populate | Description;
+    }
+
+    return result;
+}
+
+#pragma endregion
+
+#pragma region Description
+
+bool Plugin_DAT::has_description(NTreeNode* node) {
+    return !node->is_dir() && is_dat(node);
 }
 
-NaoString Plugin_DAT::Description() const {
+NaoString Plugin_DAT::description(N_UNUSED NTreeNode* node) {
     return "DAT Archive";
 }
 
 #pragma endregion 
 
-#pragma region Actions
+#pragma region Populating
 
-bool Plugin_DAT::CanEnter(NaoObject* object) {
-    return !object->is_dir()
-        && object->file_ref().io->read_singleshot(4)
-            == NaoBytes("DAT\0", 4);
+bool Plugin_DAT::can_populate(NTreeNode* node) {
+    // DAT archives have no directories
+    return !node->is_dir() && is_dat(node);
 }
 
-bool Plugin_DAT::Enter(NaoObject* object) {
-    NaoIO* io = object->file_ref().io;
+bool Plugin_DAT::populate(NTreeNode* node) {
+    return populate_batched(node, nullptr);
+}
 
+bool Plugin_DAT::populate_batched(NTreeNode* node, const PopulateCallback& callback) {
     NaoDATReader* reader = nullptr;
     try {
-        reader = new NaoDATReader(io);
+        reader = new NaoDATReader(node->io());
     } catch (const NaoDecodingException& e) {
         nerr << e.what();
         return false;
     }
 
-    int64_t subsequent_errors = 0;
+    BatchEmitter emitter(callback);
 
     for (NaoObject* file : reader->take_files()) {
-        file->file_ref().name = object->name() + N_PATHSEP + file->name();
+        NTreeNode* child = new NTreeNode(file->name());
 
-        if (!PluginManager.set_description(file)) {
-            if (subsequent_errors < N_SUBSEQUENT_ERRMSG_LIMIT_HINT) {
-                nwarn << "Failed to set description for"
-                    << file->name();
-            }
-
-            ++subsequent_errors;
-        }
+        // Take ownership of the IO
+        child->set_io(file->file_ref().io);
+        file->file_ref().io = nullptr;
 
-        object->add_child(file);
-    }
+        delete file;
 
-    if (subsequent_errors > N_SUBSEQUENT_ERRMSG_LIMIT_HINT) {
-        nwarn << (subsequent_errors - N_SUBSEQUENT_ERRMSG_LIMIT_HINT)
-            << "messages suppressed.";
+        if (node->add_child(child)) {
+            emitter.add(child);
+        } else {
+            delete child;
+        }
     }
 
     delete reader;
 
+    emitter.flush();
+
+    node->set_populated(true);
     return true;
 }
 
-#pragma endregion 
+#pragma endregion
 
-#pragma region Context menu
+#pragma region Actions
 
-bool Plugin_DAT::HasContextMenu(NaoObject* object) {
-    return CanEnter(object) || CanEnter(object->parent());
-}
+NaoVector<NaoAction*> Plugin_DAT::actions(NTreeNode* node) {
+    NaoVector<NaoAction*> actions;
 
-NaoVector<NaoAction*> Plugin_DAT::ContextMenu(NaoObject* object) {
-    if (CanEnter(object)) {
-        return { new ExtractAllAction(this) };
+    // A file inside an archive, which may be an archive itself as well
+    if (node->parent() && can_populate(node->parent())) {
+        actions.push_back(new ExtractOneAction(this, node->parent()));
     }
 
-    if (CanEnter(object->parent())) {
-        return { new ExtractOneAction(this) };
+    if (can_populate(node)) {
+        actions.push_back(new ExtractAllAction(this, false));
+        actions.push_back(new ExtractAllAction(this, true));
     }
 
-    return { };
-}
-
-#pragma endregion
-
-#pragma region ExtractAllAction
-
-ExtractAllAction::ExtractAllAction(NaoPlugin* parent)
-    : NaoAction(parent) { }
-
-NaoString ExtractAllAction::ActionName() {
-    return "Extract";
+    return actions;
 }
 
-bool ExtractAllAction::Execute(NaoObject* object) {
-    NaoString fname = fs::path(object->name()).filename();
-
-    ndebug << object->top_existing_dir();
-
-//#error SHGetFileInfo() timed out for  D:\Games\Steam\SteamApps\common\NieRAutomata\data\data000.cpk\core\coreeff.dat
-
-    NaoString target = DesktopUtils::save_as_dir(
-        object->top_existing_dir(),
-        "",
-        "Select target folder");
-
-    NaoString out_dir;
-
-    if (!std::empty(target)
-        && DesktopUtils::confirm_overwrite(
-        (out_dir = target + N_PATHSEP + fname.copy().clean_dir_name()), true)) {
-
-        nlog << "Extracting to" << target;
-
-        if (!parent()->Enter(object)) {
-            nerr << "Failed populating extraction target";
-            return false;
-        }
-
-        NaoVector<NaoObject*> children = object->take_children();
-
-        uint64_t total = std::accumulate(children.cbegin(), children.cend(),
-            0ui64,
-            [](uint64_t i, NaoObject * object) -> uint64_t {
-            return i + object->file_ref().real_size;
-        });
-
-        nlog << "Found" << children.size()
-            << (children.size() > 1 ? "children" : "child")
-            << "with a total size of" << NaoString::bytes(total);
-
-        NProgressDialog progress(UIWindow);
-
-        progress.set_title("Extracting" + fname);
-        progress.set_max(total);
-        progress.start();
-
-        for (NaoObject* child : children) {
-            // Shouldn't be possible
-            if (child->is_dir()) {
-                delete child;
-                continue;
-            }
-
-            const NaoObject::File& info = child->file_ref();
-
-            progress.set_text("Extracting: " + fs::path(info.name).filename());
-
-            if (!info.io->open()) {
-                nerr << "Failed opening input io with name" << info.name;
-                delete child;
-                continue;
-            }
-
-            if (!info.io->seek(0)) {
-                nerr << "Failed seeking to start in input io with name" << info.name;
-            }
-
-            NaoFileIO output_file(out_dir + N_PATHSEP + fs::path(info.name).filename());
-
-            if (!output_file.open(NaoIO::WriteOnly)) {
-                nerr << "Failed opening output io with name" << output_file.path();
-                delete child;
-                continue;
+/*
+ * Extracts the file called name from archive to target, or every file into the directory
+ * target if name is empty.
+ */
+static bool extract(NTreeNode* archive, const NaoString& name, const NaoString& target, bool recursive = false) {
+    return ArchiveUtils::extract(archive, [&](NaoIO* io, NaoVector<ArchiveUtils::File>& files) {
+        const NaoDATReader reader(io);
+        const NaoVector<NaoArchiveIndexCache::Entry>& entries = reader.entries();
+
+        if (std::empty(name)) {
+            for (const NaoArchiveIndexCache::Entry& entry : entries) {
+                files.push_back({ entry, target + N_PATHSEP + fs::path(entry.name).filename() });
             }
 
-            if (output_file.write(info.io->read_all()) != info.real_size) {
-                nerr << "Failed writing all data from" << info.name;
-            } else {
-                nlog << "Wrote" << NaoString::bytes(info.real_size) << "to" << output_file.path();
-            }
+            return true;
+        }
 
-            progress.add_progress(info.real_size);
+        // Single files are looked up through the archive's hash table
+        const int64_t index = reader.index_of(name);
 
-            output_file.close();
-            delete child;
+        if (index < 0) {
+            nerr << "File" << name << "not found in" << archive->name();
+            return false;
         }
 
-        progress.close();
-    }
+        files.push_back({ entries[index], target });
 
-    return true;
+        return true;
+    }, recursive);
 }
 
 #pragma endregion
 
 #pragma region ExtractOneAction
 
-ExtractOneAction::ExtractOneAction(NaoPlugin* parent)
-    : NaoAction(parent) { }
+ExtractOneAction::ExtractOneAction(NaoPlugin* parent, NTreeNode* archive)
+    : NaoAction(parent)
+    , _m_archive(archive) {
+
+}
 
-NaoString ExtractOneAction::ActionName() {
+NaoString ExtractOneAction::name() const {
     return "Extract";
 }
 
-bool ExtractOneAction::Execute(NaoObject* object) {
-    if (object->is_dir()) {
-        nerr << "Shouldn't be possible to extract a directory";
-        return false;
+bool ExtractOneAction::execute(NTreeNode* node) {
+    const NaoString target = DesktopUtils::save_as_file(ArchiveUtils::existing_dir(_m_archive),
+        fs::path(node->name()).filename());
+
+    if (std::empty(target)) {
+        return true;
     }
 
-    nlog << "Saving file" << object->name();
+    nlog << "Extracting to" << target;
 
-    NaoString target = DesktopUtils::save_as_file(object->name(),
-        fs::path(object->name()).filename());
+    return extract(_m_archive, node->name(), target);
+}
 
-    if (!std::empty(target)) {
-        nlog << "Writing to " << target;
+#pragma endregion
 
-        NaoIO* source = object->file_ref().io;
-        if (!source->open()) {
-            nerr << "Failed opening source";
-            return false;
-        }
+#pragma region ExtractAllAction
 
-        if (!source->seek(0)) {
-            nerr << "Failed seeking in source";
-            return false;
-        }
+ExtractAllAction::ExtractAllAction(NaoPlugin* parent, bool recursive)
+    : NaoAction(parent)
+    , _m_recursive(recursive) {
 
-        NaoFileIO io(target);
-        if (!io.open(NaoIO::WriteOnly)) {
-            nerr << "Failed opening target";
-            return false;
-        }
+}
 
-        int64_t written = io.write(source->read_all());
-        if (written != source->size()) {
-            nerr << "Could not write all data, missing" << (source->size() - written) << "bytes";
-            source->close();
-            io.close();
-            return false;
-        }
+NaoString ExtractAllAction::name() const {
+    return _m_recursive ? "Extract all (recursive)" : "Extract all";
+}
 
-        nlog << "Wrote" << NaoString::bytes(written) << ('(' + NaoString::number(written) + ") bytes");
+bool ExtractAllAction::execute(NTreeNode* node) {
+    const NaoString out_dir = ArchiveUtils::ask_target_dir(node, node->name().copy().clean_dir_name());
 
-        source->close();
-        io.close();
+    if (std::empty(out_dir)) {
+        return true;
     }
 
-    return true;
+    nlog << "Extracting to" << out_dir;
+
+    return extract(node, NaoString(), out_dir, _m_recursive);
 }
 
 #pragma endregion
@@ -21,6 +21,13 @@
 
 #include <Plugin/NaoPlugin.h>
 
+#include <vector>
+#include <memory>
+#include <mutex>
+
+class NaoDirectoryWatcher;
+struct DiskEntry;
+
 LIBNAO_PLUGIN_CALL LIBNAO_PLUGIN_DECL NaoPlugin* GetNaoPlugin();
 
 class Plugin_DiskDirectory final : public NaoPlugin {
@@ -35,4 +42,35 @@ class Plugin_DiskDirectory final : public NaoPlugin {
 
     N_NODISCARD bool can_populate(NTreeNode* node) override;
     bool populate(NTreeNode* node) override;
+    bool populate_batched(NTreeNode* node, const PopulateCallback& callback) override;
+
+    bool refresh(NTreeNode* node, Changes& changes, const CommitCallback& commit) override;
+
+    private:
+    // Start watching a directory, replacing the least recently used watcher if needed
+    void _watch(const NaoString& path);
+
+    // Retrieve changes for a directory, false if it must be rescanned
+    bool _poll(const NaoString& path, NaoVector<NaoString>& names);
+
+    // A change to a single child, prepared without locking the tree
+    struct DiskChange {
+        // Existing child, nullptr for a new entry
+        NTreeNode* child;
+
+        // New node for what's on disk, nullptr if it was removed
+        NTreeNode* entry;
+    };
+
+    // Compare a single child with what's on disk, disk_entry is nullptr if it doesn't exist.
+    // Returns whether the child changed, if so change describes how
+    static bool _compare(NTreeNode* node, const NaoString& path, const NaoString& name,
+        const DiskEntry* disk_entry, bool notified, DiskChange& change);
+
+    // Bring a single child in line with what's on disk
+    static void _apply(NTreeNode* node, const DiskChange& change, Changes& changes);
+
+    // Watchers for recently populated directories, least recently used first
+    std::vector<std::unique_ptr<NaoDirectoryWatcher>> _m_watchers;
+    std::mutex _m_watchers_mutex;
 };
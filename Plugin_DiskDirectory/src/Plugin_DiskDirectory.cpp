@@ -21,12 +21,22 @@
 #include <Logging/NaoLogging.h>
 #include <Filesystem/Filesystem.h>
 #include <Filesystem/NTreeNode.h>
+#include <Filesystem/NaoDirectoryWatcher.h>
 #include <IO/NaoFileIO.h>
+#include <Functionality/NaoParallel.h>
+
+#include <unordered_set>
 
 #ifdef N_WINDOWS
 #   include <Windows.h>
 #endif
 
+// Number of directories to keep watching
+static constexpr size_t max_watchers = 16;
+
+// Directories with at least this many entries create their nodes in parallel
+static constexpr size_t parallel_threshold = 4096;
+
 NaoPlugin* GetNaoPlugin() {
     return new Plugin_DiskDirectory();
 }
@@ -46,7 +56,7 @@ NaoString Plugin_DiskDirectory::plugin_description() const {
 }
 
 NaoString Plugin_DiskDirectory::version_string() const {
-    return "1.1";
+    return "1.3";
 }
 
 NaoString Plugin_DiskDirectory::author_name() const {
@@ -61,12 +71,170 @@ NaoString Plugin_DiskDirectory::author_description() const {
 
 #pragma endregion
 
+// A directory entry with everything needed to create its node
+struct DiskEntry {
+    NaoString name;
+    bool dir;
+    int64_t size;
+
+    // Last write time in the platform's own units, only compared for equality
+    int64_t write_time;
+};
+
+#ifdef N_WINDOWS
+
+// Whether an entry with these attributes should be shown
+static bool accept(const NaoString& path, DWORD attrs) {
+    // OS stuff we don't want to touch
+    if (attrs & FILE_ATTRIBUTE_SYSTEM) {
+        nlog << "Skipping hidden"
+            << (attrs & FILE_ATTRIBUTE_DIRECTORY ? "directory" : "file")
+            << path;
+        return false;
+    }
+
+    // Other hidden files and directories
+    if (attrs & FILE_ATTRIBUTE_HIDDEN) {
+        nlog << "Skipping hidden"
+            << (attrs & FILE_ATTRIBUTE_DIRECTORY ? "directory" : "file")
+            << path;
+        return false;
+    }
+
+    return true;
+}
+
+// Convert find data to an entry
+static DiskEntry to_entry(const WIN32_FIND_DATAA& data) {
+    return {
+        data.cFileName,
+        (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0,
+        (int64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow,
+        (int64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime
+    };
+}
+
+#endif
+
+// Pass every entry in a directory (path ends in a separator) to func as it's listed,
+// type and size come with the listing so no entry is stat'ed separately
+template <typename Func>
+static void for_each_entry(const NaoString& path, Func&& func) {
+#ifdef N_WINDOWS
+    WIN32_FIND_DATAA data;
+
+    // Basic info skips the short name, large fetch reads more entries per call
+    HANDLE find = FindFirstFileExA(path + '*', FindExInfoBasic, &data,
+        FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+
+    if (find == INVALID_HANDLE_VALUE) {
+        nerr << "Failed listing" << path;
+        return;
+    }
+
+    do {
+        // Skip "." and ".."
+        if (data.cFileName[0] == '.'
+            && (data.cFileName[1] == '\0' || (data.cFileName[1] == '.' && data.cFileName[2] == '\0'))) {
+            continue;
+        }
+
+        if (accept(path + data.cFileName, data.dwFileAttributes)) {
+            func(to_entry(data));
+        }
+    } while (FindNextFileA(find, &data));
+
+    FindClose(find);
+#else
+    std::error_code ec;
+
+    // The iterator caches the type, so only regular files are stat'ed for their size
+    for (const fs::directory_entry& entry : fs::directory_iterator(path.c_str(), ec)) {
+        if (entry.is_directory(ec)) {
+            func(DiskEntry { entry.path().filename(), true, 0, 0 });
+        } else if (entry.is_regular_file(ec)) {
+            func(DiskEntry { entry.path().filename(), false, int64_t(entry.file_size(ec)),
+                int64_t(entry.last_write_time(ec).time_since_epoch().count()) });
+        }
+    }
+#endif
+}
+
+// List a directory (path ends in a separator)
+static NaoVector<DiskEntry> list_directory(const NaoString& path) {
+    NaoVector<DiskEntry> entries;
+
+    for_each_entry(path, [&](const DiskEntry& entry) {
+        entries.push_back(entry);
+    });
+
+    return entries;
+}
+
+// Retrieve a single entry, false if it doesn't exist or should be skipped
+static bool stat_entry(const NaoString& path, DiskEntry& entry) {
+#ifdef N_WINDOWS
+    WIN32_FIND_DATAA data;
+
+    HANDLE find = FindFirstFileExA(path, FindExInfoBasic, &data,
+        FindExSearchNameMatch, nullptr, 0);
+
+    if (find == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    FindClose(find);
+
+    if (!accept(path, data.dwFileAttributes)) {
+        return false;
+    }
+
+    entry = to_entry(data);
+    return true;
+#else
+    std::error_code ec;
+    const fs::file_status status = fs::status(path.c_str(), ec);
+
+    if (fs::is_directory(status)) {
+        entry = { fs::path(path.c_str()).filename(), true, 0, 0 };
+        return true;
+    }
+
+    if (fs::is_regular_file(status)) {
+        entry = { fs::path(path.c_str()).filename(), false, int64_t(fs::file_size(path.c_str(), ec)),
+            int64_t(fs::last_write_time(path.c_str(), ec).time_since_epoch().count()) };
+        return true;
+    }
+
+    // Neither a file nor a directory
+    return false;
+#endif
+}
+
+// Create a node for an entry in the directory at path
+static NTreeNode* make_node(const NaoString& path, const DiskEntry& entry) {
+    NTreeNode* new_node = new NTreeNode(entry.name);
+
+    if (!entry.dir) {
+        // Size is already known, the write time tells a later refresh whether it changed
+        new_node->set_io(new NaoFileIO(path + entry.name, entry.size, entry.write_time));
+    }
+
+    return new_node;
+}
+
 bool Plugin_DiskDirectory::can_populate(NTreeNode* node) {
     // Root node or existing directory
     return !node->parent() || (node->is_dir() && fs::is_directory(node->path()));
 }
 
 bool Plugin_DiskDirectory::populate(NTreeNode* node) {
+    return populate_batched(node, nullptr);
+}
+
+bool Plugin_DiskDirectory::populate_batched(NTreeNode* node, const PopulateCallback& callback) {
+    BatchEmitter emitter(callback);
+
     // New node
     NTreeNode* new_node = nullptr;
 
@@ -88,74 +256,245 @@ bool Plugin_DiskDirectory::populate(NTreeNode* node) {
                 new_node = new NTreeNode(NaoString(str).substr(0, 2));
                 new_node->set_display_name(*str);
 
-                // Add new node
-                if (!node->has_child(new_node->name())) {
-                    node->add_child(new_node);
+                // Add new node, delete if it already exists
+                if (node->add_child(new_node)) {
+                    emitter.add(new_node);
                 } else {
-                    // Delete if it already exists
                     delete new_node;
                 }
             }
         }
     } else {
 #endif
-        //new_node->set_description(Description());
-        NaoString path_str;
+        const NaoString path = node->path();
+
+        // Start watching first so no changes are missed
+        _watch(path);
+
+        if (callback) {
+            // Pass children on while the listing is still running
+            for_each_entry(path, [&](const DiskEntry& entry) {
+                new_node = make_node(path, entry);
+
+                // Add new node, delete if it already exists
+                if (node->add_child(new_node)) {
+                    emitter.add(new_node);
+                } else {
+                    delete new_node;
+                }
+            });
+        } else {
+            const NaoVector<DiskEntry> entries = list_directory(path);
+
+            std::vector<NTreeNode*> nodes(std::size(entries));
 
-        // Check all contents
-        for (const fs::directory_entry& entry : fs::directory_iterator(node->path())) {
-            // Save the path for easy access
-            path_str = entry.path();
+            // Creating nodes and their IO's adds up in huge directories
+            NaoParallel::for_each_index(std::size(entries), [&](size_t i) {
+                nodes[i] = make_node(path, entries[i]);
+            }, (std::size(entries) >= parallel_threshold) ? NaoParallel::io_threads() : 1);
+
+            for (NTreeNode* child : nodes) {
+                // Add new node, delete if it already exists
+                if (!node->add_child(child)) {
+                    delete child;
+                }
+            }
+        }
 
-            // Windows extra check
 #ifdef N_WINDOWS
-            DWORD attrs = GetFileAttributesA(path_str);
+    }
+#endif
+
+    emitter.flush();
 
-            // Something went wrong
-            if (attrs == INVALID_FILE_ATTRIBUTES) {
-                nlog << "Invalid attributes, skipping" << path_str;
+    node->set_populated(true);
+    return true;
+}
+
+#pragma region Refreshing
+
+bool Plugin_DiskDirectory::refresh(NTreeNode* node, Changes& changes, const CommitCallback& commit) {
+    // Drive view is cheap enough to populate again
+    if (!node->parent() || !node->is_dir() || !node->populated()) {
+        return false;
+    }
+
+    const NaoString path = node->path();
+
+    // Everything is compared before the tree is locked, only applying the result locks it
+    NaoVector<DiskChange> pending;
+    DiskChange change;
+
+    NaoVector<NaoString> names;
+
+    if (_poll(path, names)) {
+        // Only look at what was reported
+        std::unordered_set<std::string> done;
+
+        for (const NaoString& name : names) {
+            if (!done.insert(name).second) {
                 continue;
             }
 
-            // OS stuff we don't want to touch
-            if (attrs & FILE_ATTRIBUTE_SYSTEM) {
-                nlog << "Skipping hidden"
-                    << (attrs & FILE_ATTRIBUTE_DIRECTORY ? "directory" : "file")
-                    << path_str;
-                continue;
+            DiskEntry entry;
+
+            if (_compare(node, path, name, stat_entry(path + name, entry) ? &entry : nullptr, true, change)) {
+                pending.push_back(change);
             }
+        }
+    } else {
+        nlog << "Rescanning" << path;
 
-            // Other hidden files and directories
-            if (attrs & FILE_ATTRIBUTE_HIDDEN) {
-                nlog << "Skipping hidden"
-                    << (attrs & FILE_ATTRIBUTE_DIRECTORY ? "directory" : "file")
-                    << path_str;
-                continue;
+        // Compare everything on disk and everything we have
+        std::unordered_set<std::string> seen;
+
+        for (const DiskEntry& entry : list_directory(path)) {
+            seen.insert(entry.name);
+
+            if (_compare(node, path, entry.name, &entry, false, change)) {
+                pending.push_back(change);
             }
+        }
 
-#endif
+        for (NTreeNode* child : node->children()) {
+            if (seen.count(child->name()) == 0 && _compare(node, path, child->name(), nullptr, false, change)) {
+                pending.push_back(change);
+            }
+        }
+    }
 
-            if (fs::is_directory(path_str)) {
-                new_node = new NTreeNode(entry.path().filename());
-            } else if (is_regular_file(entry.path())) {
-                // Also create IO object
-                new_node = new NTreeNode(entry.path().filename());
-                new_node->set_io(new NaoFileIO(path_str));
+    if (std::size(pending) > 0) {
+        commit([&] {
+            for (const DiskChange& update : pending) {
+                _apply(node, update, changes);
             }
+        });
+    }
+
+    return true;
+}
+
+void Plugin_DiskDirectory::_watch(const NaoString& path) {
+    std::lock_guard lock(_m_watchers_mutex);
+
+    for (auto it = _m_watchers.begin(); it != _m_watchers.end(); ++it) {
+        if ((*it)->path() == path) {
+            // Already watching, start over since we just listed the directory
+            _m_watchers.erase(it);
+            break;
+        }
+    }
+
+    if (std::size(_m_watchers) >= max_watchers) {
+        _m_watchers.erase(_m_watchers.begin());
+    }
+
+    _m_watchers.push_back(std::make_unique<NaoDirectoryWatcher>(path));
+}
+
+bool Plugin_DiskDirectory::_poll(const NaoString& path, NaoVector<NaoString>& names) {
+    {
+        std::lock_guard lock(_m_watchers_mutex);
+
+        for (auto it = _m_watchers.begin(); it != _m_watchers.end(); ++it) {
+            if ((*it)->path() == path) {
+                // Most recently used
+                std::unique_ptr<NaoDirectoryWatcher> watcher = std::move(*it);
+                _m_watchers.erase(it);
 
-            // Add new node
-            if (!node->has_child(new_node->name())) {
-                node->add_child(new_node);
-            } else {
-                // Delete if it already exists
-                delete new_node;
+                const bool complete = watcher->poll(names);
+
+                _m_watchers.push_back(std::move(watcher));
+
+                return complete;
             }
         }
+    }
 
-#ifdef N_WINDOWS
+    // Not watched, rescan and watch from now on
+    _watch(path);
+
+    return false;
+}
+
+bool Plugin_DiskDirectory::_compare(NTreeNode* node, const NaoString& path, const NaoString& name,
+    const DiskEntry* disk_entry, bool notified, DiskChange& change) {
+    NTreeNode* child = node->get_child(name);
+
+    // Removed from disk
+    if (!disk_entry) {
+        change = { child, nullptr };
+        return child != nullptr;
     }
-#endif
 
-    node->set_populated(true);
+    // New entry
+    if (!child) {
+        change = { nullptr, make_node(path, *disk_entry) };
+        return true;
+    }
+
+    // A directory's contents changed, but not the directory itself
+    if (disk_entry->dir && child->is_dir()) {
+        return false;
+    }
+
+    // Without a notification, the file changed if its size or last write time did
+    if (!notified && !disk_entry->dir && !child->is_dir() && child->io()->size() == disk_entry->size) {
+        const NaoFileIO* io = dynamic_cast<NaoFileIO*>(child->io());
+
+        if (io && io->write_time() == disk_entry->write_time) {
+            return false;
+        }
+    }
+
+    change = { child, make_node(path, *disk_entry) };
     return true;
 }
+
+void Plugin_DiskDirectory::_apply(NTreeNode* node, const DiskChange& change, Changes& changes) {
+    NTreeNode* child = change.child;
+    NTreeNode* entry = change.entry;
+
+    // Removed from disk
+    if (!entry) {
+        if (node->remove_child(child)) {
+            changes.removed.push_back(child);
+        }
+
+        return;
+    }
+
+    // New entry
+    if (!child) {
+        if (node->add_child(entry)) {
+            changes.added.push_back(entry);
+        } else {
+            delete entry;
+        }
+
+        return;
+    }
+
+    // Changed file, children of populated files would refer to the old IO and locked files are still being read
+    if (!entry->is_dir() && !child->is_dir() && std::size(child->children()) == 0 && !child->locked()) {
+        // Readers may still be using the old IO, the caller deletes it later
+        changes.replaced.push_back(child->io());
+
+        child->set_io(entry->io());
+        entry->set_io(nullptr);
+
+        delete entry;
+
+        changes.modified.push_back(child);
+        return;
+    }
+
+    // Type changed, or a populated file changed, replace it entirely
+    node->remove_child(child);
+    changes.removed.push_back(child);
+
+    node->add_child(entry);
+    changes.added.push_back(entry);
+}
+
+#pragma endregion
@@ -0,0 +1,160 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+/**
+ * \file NaoBoundedQueue.h
+ *
+ * \brief Contains the NaoBoundedQueue template class.
+ */
+
+#include "libnao.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+/**
+ * \ingroup containers
+ *
+ * \brief A fixed-capacity queue that any number of threads can push to and pop from without locking.
+ *
+ * Every slot carries a sequence number that tells producers and consumers whose turn it is,
+ * so a push or pop is a single compare-exchange on the head or tail index in the common case.
+ * `T` should be cheap to move, pointers are the intended use.
+ */
+template <typename T>
+class NaoBoundedQueue {
+    public:
+    /**
+     * \brief Construct with a given capacity.
+     * \param[in] capacity The maximum number of elements, rounded up to a power of 2.
+     */
+    explicit NaoBoundedQueue(size_t capacity)
+        : _m_mask(_capacity_for(capacity) - 1)
+        , _m_slots(std::make_unique<Slot[]>(_m_mask + 1))
+        , _m_head(0)
+        , _m_tail(0) {
+
+        for (size_t i = 0; i <= _m_mask; ++i) {
+            _m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    NaoBoundedQueue(const NaoBoundedQueue&) = delete;
+    NaoBoundedQueue& operator=(const NaoBoundedQueue&) = delete;
+
+    /**
+     * \brief Append an element, unless the queue is full.
+     * \param[in] value The element to append.
+     * \return Whether the element was appended.
+     */
+    bool try_push(T value) {
+        size_t pos = _m_tail.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Slot& slot = _m_slots[pos & _m_mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+
+            if (diff == 0) {
+                // The slot is free, claim it
+                if (_m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // The slot still holds an element from the previous lap
+                return false;
+            } else {
+                pos = _m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * \brief Remove the first element, unless the queue is empty.
+     * \param[out] value Receives the removed element.
+     * \return Whether an element was removed.
+     */
+    bool try_pop(T& value) {
+        size_t pos = _m_head.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Slot& slot = _m_slots[pos & _m_mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(sequence) - intptr_t(pos + 1);
+
+            if (diff == 0) {
+                // The slot holds an element, claim it
+                if (_m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(slot.value);
+                    slot.sequence.store(pos + _m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // Nothing was pushed to this slot yet
+                return false;
+            } else {
+                pos = _m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * \return The maximum number of elements.
+     */
+    N_NODISCARD size_t capacity() const {
+        return _m_mask + 1;
+    }
+
+    /**
+     * \return The number of elements at the time of the call, only a hint while other threads use the queue.
+     */
+    N_NODISCARD size_t size_hint() const {
+        const size_t tail = _m_tail.load(std::memory_order_relaxed);
+        const size_t head = _m_head.load(std::memory_order_relaxed);
+
+        return (tail > head) ? (tail - head) : 0;
+    }
+
+    private:
+    static size_t _capacity_for(size_t capacity) {
+        size_t result = 2;
+        while (result < capacity) {
+            result *= 2;
+        }
+
+        return result;
+    }
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // Head and tail are written by different threads, keep them on separate cache lines
+    static constexpr size_t cache_line = 64;
+
+    const size_t _m_mask;
+    std::unique_ptr<Slot[]> _m_slots;
+
+    alignas(cache_line) std::atomic<size_t> _m_head;
+    alignas(cache_line) std::atomic<size_t> _m_tail;
+};
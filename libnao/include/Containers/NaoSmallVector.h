@@ -0,0 +1,741 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+/**
+ * \file NaoSmallVector.h
+ * 
+ * \brief Contains the NaoSmallVector template class.
+ */
+
+#include "libnao.h"
+
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef max // a random max gets picked up somewhere
+#undef max
+#endif
+
+/**
+ * \ingroup containers
+ * 
+ * \brief A NaoVector with inline storage for the first N elements.
+ * 
+ * Elements are stored in the object itself until there are more than N of them, only
+ * then is storage allocated on the heap. Meant for short lists on hot paths, like the
+ * components of a path. Has the same interface as NaoVector.
+ */
+template <typename T, size_t N>
+class NaoSmallVector {
+    static_assert(N > 0, "NaoSmallVector needs room for at least 1 element");
+
+    public:
+
+#pragma region Required STL stuff
+
+    /**
+     * \name Typedefs
+     * \brief Type aliases.
+     * \{
+     */
+    using value_type = T;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using reference = T & ;
+    using const_reference = const T &;
+    using pointer = T * ;
+    using const_pointer = const T * ;
+    using iterator = T * ;
+    using const_iterator = const T * ;
+    /**
+     * \}
+     */
+
+    // Config
+    /**
+     * \brief Size of each element.
+     */
+    static constexpr size_type element_size = sizeof(T);
+
+    /**
+     * \brief Number of elements that fit without allocating.
+     */
+    static constexpr size_type inline_capacity = N;
+
+    /**
+     * \brief Capacity is multiplied by this factor when the vector is full.
+     */
+    static constexpr size_type growth_factor = 2;
+
+    /**
+     * \brief Default empty constructor.
+     * \note Does not allocate.
+     */
+    NaoSmallVector() noexcept
+        : _m_data(_inline_data())
+        , _m_size(0)
+        , _m_allocated(N) { }
+
+    /**
+     * \brief Construct at a given size.
+     * \param[in] size The number of value-initialized elements the vector initially holds.
+     */
+    explicit NaoSmallVector(size_type size)
+        : NaoSmallVector() {
+        reserve(size);
+
+        std::uninitialized_value_construct_n(_m_data, size);
+        _m_size = size;
+    }
+
+    /**
+     * \brief Constructs from a std::initializer_list.
+     * \param[in] ilist The std::initializer list to copy from.
+     */
+    NaoSmallVector(std::initializer_list<T> ilist)
+        : NaoSmallVector() {
+        _assign(std::begin(ilist), std::end(ilist), std::size(ilist));
+    }
+
+    /**
+     * \brief Constructs from another NaoSmallVector.
+     * \param[in] other The NaoSmallVector to copy.
+     */
+    NaoSmallVector(const NaoSmallVector& other)
+        : NaoSmallVector() {
+        _assign(std::begin(other), std::end(other), other._m_size);
+    }
+
+    /**
+     * \brief Move constructor.
+     * \param[in] other The instance to move from.
+     * \note Elements stored inline are moved one by one, heap storage is taken over.
+     */
+    NaoSmallVector(NaoSmallVector&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+        : NaoSmallVector() {
+        _take(std::move(other));
+    }
+
+    /**
+     * \brief Destructor that destroys all elements and releases any heap storage.
+     */
+    ~NaoSmallVector() {
+        std::destroy(begin(), end());
+
+        if (!is_inline()) {
+            _deallocate(_m_data);
+        }
+    }
+
+    /**
+     * \brief Assign from another vector.
+     * \param[in] other The NaoSmallVector to copy from.
+     * \return `*this`.
+     */
+    NaoSmallVector& operator=(const NaoSmallVector& other) {
+        if (this != &other) {
+            _assign(std::begin(other), std::end(other), other._m_size);
+        }
+
+        return *this;
+    }
+
+    /**
+     * \brief Moves from another vector.
+     * \param[in] other The vector to move from.
+     * \return `*this`.
+     */
+    NaoSmallVector& operator=(NaoSmallVector&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        if (this != &other) {
+            _reset();
+            _take(std::move(other));
+        }
+
+        return *this;
+    }
+
+    /**
+     * \brief Assigns from a std::initializer_list.
+     * \param[in] ilist The std::initializer_list to copy from.
+     * \return `*this`.
+     */
+    NaoSmallVector& operator=(std::initializer_list<T> ilist) {
+        _assign(std::begin(ilist), std::end(ilist), std::size(ilist));
+
+        return *this;
+    }
+
+    /**
+     * \brief Array access.
+     * \param[in] pos The index of the requested element.
+     * \return Reference to the element as position `pos`.
+     */
+    N_NODISCARD reference at(size_type pos) {
+        if (pos >= _m_size) {
+            throw std::out_of_range("index is out of range");
+        }
+
+        return _m_data[pos];
+    }
+
+    /**
+     * \brief `const` version of at().
+     */
+    N_NODISCARD const_reference at(size_type pos) const {
+        if (pos >= _m_size) {
+            throw std::out_of_range("index is out of range");
+        }
+
+        return _m_data[pos];
+    }
+
+    /**
+     * \brief Array access.
+     * \param[in] pos The index of the requested element.
+     * \return Reference to the element at position `pos`.
+     * \note Functionality is identical to at().
+     */
+    N_NODISCARD reference operator[](size_type pos) {
+        return at(pos);
+    }
+
+    /**
+     * \brief `const` version of operator[]().
+     */
+    N_NODISCARD const_reference operator[](size_type pos) const {
+        return at(pos);
+    }
+
+    /**
+     * \brief Access the first element.
+     * \return Reference to the first element in the array.
+     */
+    N_NODISCARD reference front() {
+        return _m_data[0];
+    }
+
+    /**
+     * \brief `const` version of front().
+     */
+    N_NODISCARD const_reference front() const {
+        return _m_data[0];
+    }
+
+    /**
+     * \brief Access the last element.
+     * \return Reference to the last element in the array.
+     */
+    N_NODISCARD reference back() {
+        return _m_data[_m_size - 1];
+    }
+
+    /**
+     * \brief `const` version of back().
+     */
+    N_NODISCARD const_reference back() const {
+        return _m_data[_m_size - 1];
+    }
+
+    /**
+     * \brief Access underlying array.
+     * \return Pointer to the underlying array.
+     */
+    N_NODISCARD T* data() noexcept {
+        return _m_data;
+    }
+
+    /**
+     * \brief `const` version of data().
+     */
+    N_NODISCARD const T* data() const noexcept {
+        return _m_data;
+    }
+
+    /**
+     * \brief Get the begin iterator.
+     * \return Iterator pointing to the first element of the array.
+     */
+    N_NODISCARD iterator begin() noexcept {
+        return _m_data;
+    }
+
+    /**
+     * \brief `const` version of begin().
+     */
+    N_NODISCARD const_iterator begin() const noexcept {
+        return _m_data;
+    }
+
+    /**
+     * \brief `const` version of begin().
+     */
+    N_NODISCARD const_iterator cbegin() const noexcept {
+        return _m_data;
+    }
+
+    /**
+     * \brief Get the past-the-end iterator.
+     * \return The past-the-end iterator of the held array.
+     */
+    N_NODISCARD iterator end() noexcept {
+        return _m_data + _m_size;
+    }
+
+    /**
+     * \brief `const` version of end().
+     */
+    N_NODISCARD const_iterator end() const noexcept {
+        return _m_data + _m_size;
+    }
+
+    /**
+     * \brief `const` version of end().
+     */
+    N_NODISCARD const_iterator cend() const noexcept {
+        return _m_data + _m_size;
+    }
+
+    /**
+     * \brief Check if the vector is empty.
+     * \return Whether the vector is empty.
+     */
+    N_NODISCARD bool empty() const noexcept {
+        return _m_size == 0;
+    }
+
+    /**
+     * \brief Get the number of elements held.
+     * \return The number of elements the vector contains.
+     */
+    N_NODISCARD size_type size() const noexcept {
+        return _m_size;
+    }
+
+    // ReSharper disable once CppMemberFunctionMayBeStatic
+    /**
+     * \brief The maximum number of allocatable entries.
+     * \return The maximum number of indexes possible.
+     */
+    N_NODISCARD size_type max_size() const noexcept {
+        return std::numeric_limits<size_type>::max();
+    }
+
+    /**
+     * \brief Pre-allocate memory.
+     * \param[in] new_cap The desired new maximum number of elements.
+     * \note Does not allocate if `new_cap` fits inline. Does not shrink vector.
+     */
+    void reserve(size_type new_cap) {
+        // Don't allocate too much
+        if (new_cap > max_size() / element_size) {
+            throw std::length_error("new cap is too large for size_type");
+        }
+
+        if (new_cap > _m_allocated) {
+            _relocate(_allocate(new_cap), new_cap);
+        }
+    }
+
+    /**
+     * \brief Get the total amount of allocated memory.
+     * \return The number of elements that fit without reallocating, at least `N`.
+     */
+    N_NODISCARD size_type capacity() const noexcept {
+        return _m_allocated;
+    }
+
+    /**
+     * \brief Whether the elements are stored inline, without any heap storage.
+     */
+    N_NODISCARD bool is_inline() const noexcept {
+        return _m_data == _inline_data();
+    }
+
+    /**
+     * \brief Shrinks the array to the minimum required size.
+     * \note Moves the elements back inline if they fit.
+     */
+    void shrink_to_fit() {
+        if (is_inline() || _m_allocated == _m_size) {
+            return;
+        }
+
+        if (_m_size <= N) {
+            _relocate(_inline_data(), N);
+        } else {
+            _relocate(_allocate(_m_size), _m_size);
+        }
+    }
+
+    /**
+     * \brief Clear all elements.
+     * \note Does not change capacity.
+     */
+    void clear() noexcept {
+        std::destroy(begin(), end());
+
+        // Reset size to 0
+        _m_size = 0;
+    }
+
+    /**
+     * \brief Add an element to the back of the vector.
+     * \param[in] value The element to add.
+     */
+    void push_back(const T& value) {
+        emplace_back(value);
+    }
+
+    /**
+     * \brief Move an element to the back of the vector.
+     * \param[in] value The element to move.
+     */
+    void push_back(T&& value) {
+        emplace_back(std::move(value));
+    }
+
+    /**
+     * \brief Construct an element in place at the back of the vector.
+     * \param[in] args Arguments for the constructor of `T`.
+     * \return Reference to the new element.
+     * \note Amortized constant time, only allocates once there are more than `N` elements.
+     */
+    template <typename... Args>
+    reference emplace_back(Args&&... args) {
+        if (_m_size < _m_allocated) {
+            ::new (static_cast<void*>(end())) T(std::forward<Args>(args)...);
+        } else {
+            const size_type new_cap = _grown(_m_size + 1);
+            T* new_data = _allocate(new_cap);
+
+            // Construct before relocating, args may refer to an element of this vector
+            ::new (static_cast<void*>(new_data + _m_size)) T(std::forward<Args>(args)...);
+
+            _relocate(new_data, new_cap);
+        }
+
+        ++_m_size;
+
+        return back();
+    }
+
+    /**
+     * \brief Swap 2 vectors.
+     * \param[in] other The vector to swap with.
+     * \note Elements stored inline are moved.
+     */
+    void swap(NaoSmallVector& other) {
+        NaoSmallVector tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    /**
+     * \brief Inserts a range of elements.
+     * \param[in] pos The position to insert the elements at.
+     * \param[in] first Iterator pointing to the first element to insert.
+     * \param[in] last Past-the-end iterator for the array of elements to insert.
+     * \return Iterator pointing to the first inserted element.
+     */
+    template <class InputIt>
+    iterator insert(const_iterator pos, InputIt first, InputIt last) {
+        const size_type index = std::distance(cbegin(), pos);
+
+        // Nothing to insert, don't shift anything onto itself
+        if (first == last) {
+            return _m_data + index;
+        }
+
+        // Get total amount of elements we're inserting
+        const size_type count = std::distance(first, last);
+
+        // If we need to grow
+        if (_m_size + count > _m_allocated) {
+            const size_type new_cap = _grown(_m_size + count);
+            T* new_data = _allocate(new_cap);
+
+            // Copy inserted elements, then move old elements around them
+            std::uninitialized_copy(first, last, new_data + index);
+            _uninitialized_relocate(_m_data, _m_data + index, new_data);
+            _uninitialized_relocate(_m_data + index, end(), new_data + index + count);
+
+            std::destroy(begin(), end());
+            _release();
+
+            _m_data = new_data;
+            _m_allocated = new_cap;
+        } else {
+            // Don't need to grow
+            iterator insert_pos = _m_data + index;
+            iterator old_end = end();
+            const size_type trailing = std::distance(insert_pos, old_end);
+
+            if (trailing > count) {
+                // Trailing elements end up partly in unconstructed storage
+                std::uninitialized_move(old_end - count, old_end, old_end);
+                std::move_backward(insert_pos, old_end - count, old_end);
+                std::copy(first, last, insert_pos);
+            } else {
+                // Some inserted elements end up in unconstructed storage
+                InputIt middle = first;
+                std::advance(middle, trailing);
+
+                std::uninitialized_copy(middle, last, old_end);
+                std::uninitialized_move(insert_pos, old_end, insert_pos + count);
+                std::copy(first, middle, insert_pos);
+            }
+        }
+
+        // Fix size
+        _m_size += count;
+
+        return _m_data + index;
+    }
+
+    /**
+     * \brief Erase a range of elements.
+     * \param[in] first Iterator pointing to the first element to remove.
+     * \param[in] last Past-the-end iterator for the elements to remove.
+     * \return Iterator pointing to the last removed element, or end().
+     */
+    iterator erase(const_iterator first, const_iterator last) {
+        const size_type first_index = std::distance(cbegin(), first);
+        const size_type last_index = std::distance(cbegin(), last);
+
+        // Empty range, don't move trailing elements onto themselves
+        if (first_index == last_index) {
+            return _m_data + first_index;
+        }
+
+        // Just move trailing elements on top of the elements to remove, then destroy what's left behind
+        iterator new_end = std::move(_m_data + last_index, end(), _m_data + first_index);
+        std::destroy(new_end, end());
+
+        // fix size
+        _m_size -= last_index - first_index;
+
+        // Iterator to the last element removed, or end()
+        return (last_index < _m_size) ? _m_data + last_index : end();
+    }
+
+    /**
+     * \brief Erase a single position.
+     * \param[in] pos Iterator pointing to the element to erase.
+     * \return Iterator pointing past the removed element.
+     */
+    iterator erase(const_iterator pos) {
+        // Move all elements past the element to remove back by 1
+        const size_type index = std::distance(cbegin(), pos);
+
+        std::move(_m_data + index + 1, end(), _m_data + index);
+        std::destroy_at(end() - 1);
+        --_m_size;
+
+        // Iterator pointing past the removed element
+        return _m_data + index;
+    }
+
+#pragma endregion
+
+    /**
+     * \brief Find the index of a value.
+     * \param[in] val The value to find the index of.
+     * \return The index of the value if found, else `size_t(-1)`.
+     */
+    N_NODISCARD size_type index_of(const T& val) const {
+        for (size_type i = 0; i < _m_size; ++i) {
+            if (_m_data[i] == val) {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    /**
+     * \brief Check whether the vector contains a specific element.
+     * \param[in] val The value to check for.
+     * \return Whether the vector contains the element or not.
+     */
+    N_NODISCARD bool contains(const T& val) const {
+        return index_of(val) != size_type(-1);
+    }
+
+    private:
+    /**
+     * \brief Start of the inline storage.
+     */
+    N_NODISCARD T* _inline_data() noexcept {
+        return reinterpret_cast<T*>(_m_inline);
+    }
+
+    /**
+     * \brief `const` version of _inline_data().
+     */
+    N_NODISCARD const T* _inline_data() const noexcept {
+        return reinterpret_cast<const T*>(_m_inline);
+    }
+
+    /**
+     * \brief Capacity to grow to so that at least `size` elements fit.
+     * \param[in] size The required number of elements.
+     * \return The larger of `size` and the current capacity times `growth_factor`.
+     */
+    N_NODISCARD size_type _grown(size_type size) const {
+        if (size > max_size() / element_size) {
+            throw std::length_error("new size is too large for size_type");
+        }
+
+        const size_type grown = (_m_allocated > (max_size() / element_size) / growth_factor)
+            ? size : _m_allocated * growth_factor;
+
+        return std::max<size_type>(size, grown);
+    }
+
+    /**
+     * \brief Allocates uninitialized heap storage for `count` elements.
+     */
+    static T* _allocate(size_type count) {
+        if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return static_cast<T*>(::operator new(count * element_size, std::align_val_t(alignof(T))));
+        } else {
+            return static_cast<T*>(::operator new(count * element_size));
+        }
+    }
+
+    /**
+     * \brief Releases heap storage from _allocate().
+     * \note Does not destroy any elements.
+     */
+    static void _deallocate(T* data) noexcept {
+        if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(data, std::align_val_t(alignof(T)));
+        } else {
+            ::operator delete(data);
+        }
+    }
+
+    /**
+     * \brief Releases the current storage if it is on the heap.
+     * \note Does not destroy any elements or update any members.
+     */
+    void _release() noexcept {
+        if (!is_inline()) {
+            _deallocate(_m_data);
+        }
+    }
+
+    /**
+     * \brief Moves elements to unconstructed storage, copies them if moving may throw.
+     * \return Past-the-end iterator of the constructed elements.
+     */
+    static iterator _uninitialized_relocate(iterator first, iterator last, iterator dest) {
+        if constexpr (std::is_nothrow_move_constructible_v<T> || !std::is_copy_constructible_v<T>) {
+            return std::uninitialized_move(first, last, dest);
+        } else {
+            return std::uninitialized_copy(first, last, dest);
+        }
+    }
+
+    /**
+     * \brief Moves all elements to new storage and releases the old storage.
+     * \param[in] new_data Heap storage from _allocate() or the inline storage.
+     * \param[in] new_cap Number of elements `new_data` can hold.
+     */
+    void _relocate(T* new_data, size_type new_cap) {
+        _uninitialized_relocate(begin(), end(), new_data);
+
+        std::destroy(begin(), end());
+        _release();
+
+        _m_data = new_data;
+        _m_allocated = new_cap;
+    }
+
+    /**
+     * \brief Destroys all elements and goes back to the inline storage.
+     */
+    void _reset() noexcept {
+        clear();
+        _release();
+
+        _m_data = _inline_data();
+        _m_allocated = N;
+    }
+
+    /**
+     * \brief Takes the elements of another vector.
+     * \param[in] other The vector to take the elements of, left empty.
+     * \note This vector must be empty and use its inline storage.
+     */
+    void _take(NaoSmallVector&& other) {
+        if (other.is_inline()) {
+            std::uninitialized_move(other.begin(), other.end(), _m_data);
+            _m_size = other._m_size;
+
+            other.clear();
+        } else {
+            _m_data = other._m_data;
+            _m_size = other._m_size;
+            _m_allocated = other._m_allocated;
+
+            other._m_data = other._inline_data();
+            other._m_size = 0;
+            other._m_allocated = N;
+        }
+    }
+
+    /**
+     * \brief Replaces all elements with copies of a range.
+     * \param[in] first Iterator pointing to the first element to copy.
+     * \param[in] last Past-the-end iterator of the elements to copy.
+     * \param[in] count Number of elements in the range.
+     */
+    template <class InputIt>
+    void _assign(InputIt first, InputIt last, size_type count) {
+        clear();
+
+        if (count > _m_allocated) {
+            _reset();
+
+            _m_data = _allocate(count);
+            _m_allocated = count;
+        }
+
+        std::uninitialized_copy(first, last, _m_data);
+        _m_size = count;
+    }
+
+    // Data pointer, either to the inline storage or to the heap
+    T* _m_data;
+
+    // Amount of element stored
+    size_type _m_size;
+
+    // Amount of elements that fit in the current storage
+    size_type _m_allocated;
+
+    // Storage for the first N elements
+    alignas(T) unsigned char _m_inline[N * sizeof(T)];
+};
@@ -31,6 +31,7 @@
 
 #include "Filesystem/Filesystem.h"
 #include "Containers/NaoVector.h"
+#include "Containers/NaoSmallVector.h"
 
 #ifdef QT_VERSION
 /**
@@ -48,7 +49,7 @@
  * \brief Encapsulates a wide (UTF-16) string.
  *
  * Temporary class to take ownership of a `wchar*` wide string,
- * and deallocates it at the end of it's lifetime.
+ * and deallocates it at the end of its lifetime.
  */
 class LIBNAO_API NaoWStringConst {
     public:
@@ -163,7 +164,7 @@ class LIBNAO_API NaoString {
      * \brief Copy constructor
      * \param[in] other - The instance to copy from.
      *
-     * Copies parameters from the source instance and also copies it's buffer.
+     * Copies parameters from the source instance and also copies its buffer.
      */
     NaoString(const NaoString& other);
 
@@ -335,6 +336,13 @@ class LIBNAO_API NaoString {
      */
     void reserve(size_t size);
 
+    /**
+     * \brief Resizes the string, keeping existing contents.
+     * \param[in] size The new size.
+     * \param[in] fill Character to initialise new characters with.
+     */
+    void resize(size_t size, char fill = '\0');
+
     /**
      * \brief Returns the allocated amount of bytes.
      * \returns The size of the current string buffer.
@@ -526,6 +534,14 @@ class LIBNAO_API NaoString {
      */
     N_NODISCARD NaoVector<NaoString> split(char delim) const;
 
+    /**
+     * \brief Splits the string at the specified delimiter, without allocating for short lists.
+     * \param[in] delim The delimiter to split at.
+     * \return A vector containing all parts, only allocates for more than 8 parts.
+     * \note Meant for path components and other strings with few parts.
+     */
+    N_NODISCARD NaoSmallVector<NaoString, 8> split_small(char delim) const;
+
     /**
      * \brief Counts the number of occurences of a character.
      * \param[in] ch The character to count.
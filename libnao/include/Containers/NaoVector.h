@@ -28,7 +28,11 @@
 #include "Functionality/NaoMath.h"
 
 #include <iterator>
+#include <limits>
 #include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
 
 #ifdef max // a random max gets picked up somewhere
 #undef max
@@ -38,6 +42,10 @@
  * \ingroup containers
  * 
  * \brief A managed vector with insert capability.
+ * 
+ * Elements live in raw storage and are only constructed when added, so spare capacity
+ * costs no constructor calls and `T` only needs to be default constructible for
+ * NaoVector(size_t). Capacity grows geometrically and elements are moved to new storage.
  */
 template <typename T>
 class NaoVector {
@@ -70,21 +78,25 @@ class NaoVector {
     static constexpr size_type element_size = sizeof(T);
 
     /**
-     * \brief Memory will be allocated in blocks of this size.
+     * \brief Capacity is always a multiple of this many elements.
      */
     static constexpr size_type data_alignment = 16;
 
+    /**
+     * \brief Capacity is multiplied by this factor when the vector is full.
+     */
+    static constexpr size_type growth_factor = 2;
+
     /**
      * \brief Construct at a given size.
-     * \param[in] size The number of elements the vector can initially hold.
+     * \param[in] size The number of value-initialized elements the vector initially holds.
      */
     explicit NaoVector(size_t size) 
-        : _m_size(size) {
-        // Round size
-        _m_allocated = NaoMath::round_up(size, data_alignment);
-
-        // Allocate memory
-        _m_data = new T[_m_allocated]();
+        : _m_data(_allocate(_round(size)))
+        , _m_size(size)
+        , _m_allocated(_round(size))
+        , _m_end(nullptr) {
+        std::uninitialized_value_construct_n(_m_data, _m_size);
 
         // Find end iterator
         _m_end = _m_data + _m_size;
@@ -92,35 +104,39 @@ class NaoVector {
 
     /**
      * \brief Default empty constructor.
+     * \note Does not allocate.
      */
-    NaoVector() : NaoVector(0) { }
+    NaoVector() noexcept
+        : _m_data(nullptr)
+        , _m_size(0)
+        , _m_allocated(0)
+        , _m_end(nullptr) { }
 
     /**
      * \brief Constructs from a std::initializer_list.
      * \param[in] ilist The std::initializer list to copy from.
      */
     NaoVector(std::initializer_list<T> ilist)
-        : _m_size(std::size(ilist))
-        , _m_allocated(NaoMath::round_up(_m_size, data_alignment))
-        , _m_data(nullptr)
+        : _m_data(_allocate(_round(std::size(ilist))))
+        , _m_size(std::size(ilist))
+        , _m_allocated(_round(std::size(ilist)))
         , _m_end(nullptr) {
-        _m_data = new T[_m_allocated]();
 
         // Copy all elements
-        _m_end = std::copy(std::begin(ilist), std::end(ilist), _m_data);
+        _m_end = std::uninitialized_copy(std::begin(ilist), std::end(ilist), _m_data);
     }
 
     /**
      * \brief Constructs from another NaoVector.
      * \param[in] other The NaoVector to copy.
+     * \note Only allocates as much as needed for the elements of `other`.
      */
     NaoVector(const NaoVector<T>& other)
-        : _m_size(other._m_size)
-        , _m_allocated(other._m_allocated)
-        , _m_data(nullptr)
+        : _m_data(_allocate(_round(other._m_size)))
+        , _m_size(other._m_size)
+        , _m_allocated(_round(other._m_size))
         , _m_end(nullptr) {
-        _m_data = new T[_m_allocated]();
-        _m_end = std::copy(std::begin(other), std::end(other), _m_data);
+        _m_end = std::uninitialized_copy(std::begin(other), std::end(other), _m_data);
     }
 
     /**
@@ -140,33 +156,24 @@ class NaoVector {
     }
 
     /**
-     * \brief Destructor that deletes the held array.
+     * \brief Destructor that destroys all elements and releases the storage.
      */
     ~NaoVector() {
-        if (_m_allocated) {
-            delete[] _m_data;
-        }
+        std::destroy(_m_data, _m_end);
+        _deallocate(_m_data);
     }
 
     /**
      * \brief Assign from another vector.
      * \param[in] other The NaoVector to copy from.
      * \return `*this`.
+     * \note Keeps the current storage if it is large enough.
      */
     NaoVector& operator=(const NaoVector& other) {
-        // Release any held memory
-        if (_m_allocated) {
-            delete[] _m_data;
+        if (this != &other) {
+            _assign(std::begin(other), std::end(other), other._m_size);
         }
 
-        // Copy parameters
-        _m_size = other._m_size;
-        _m_allocated = other._m_allocated;
-
-        // Allocate new memory and copy elements
-        _m_data = new T[_m_allocated]();
-        _m_end = std::copy(std::begin(other), std::end(other), _m_data);
-
         return *this;
     }
 
@@ -176,10 +183,14 @@ class NaoVector {
      * \return `*this`.
      */
     NaoVector& operator=(NaoVector&& other) noexcept {
-        if (_m_allocated) {
-            delete[] _m_data;
+        if (this == &other) {
+            return *this;
         }
 
+        // Release any held memory
+        std::destroy(_m_data, _m_end);
+        _deallocate(_m_data);
+
         // Same as move constructor
         _m_size = other._m_size;
         _m_allocated = other._m_allocated;
@@ -200,14 +211,7 @@ class NaoVector {
      * \return `*this`.
      */
     NaoVector& operator=(std::initializer_list<T> ilist) {
-        if (_m_allocated) {
-            delete[] _m_data;
-        }
-
-        _m_size = std::size(ilist);
-        _m_allocated = NaoMath::round_up(_m_size, data_alignment);
-        _m_data = new T[_m_allocated]();
-        _m_end = std::copy(std::begin(ilist), std::end(ilist), _m_data);
+        _assign(std::begin(ilist), std::end(ilist), std::size(ilist));
 
         return *this;
     }
@@ -384,12 +388,14 @@ class NaoVector {
      */
     void reserve(size_type new_cap) {
         // Don't allocate too much
-        if (new_cap > max_size()) {
+        if (new_cap > max_size() / element_size) {
             throw std::length_error("new cap is too large for size_type");
         }
 
-        // Grow if needed
-        _reallocate_to(new_cap);
+        // Grow if needed, to exactly what was asked for
+        if (new_cap > _m_allocated) {
+            _reallocate(_round(new_cap));
+        }
     }
 
     /**
@@ -407,19 +413,11 @@ class NaoVector {
      */
     void shrink_to_fit() {
         // Optimal size
-        size_type allocate_target = NaoMath::round_up(_m_size, data_alignment);
+        size_type allocate_target = _round(_m_size);
 
         // If we need to shrink
         if (_m_allocated > allocate_target) {
-            // Shrink manually
-
-            _m_allocated = allocate_target;
-            T* new_data = new T[_m_allocated]();
-
-            _m_end = std::copy(_m_data, _m_end, new_data);
-
-            delete[] _m_data;
-            _m_data = new_data;
+            _reallocate(allocate_target);
         }
     }
 
@@ -428,11 +426,10 @@ class NaoVector {
      * \note Does not change capacity.
      */
     void clear() noexcept {
+        std::destroy(_m_data, _m_end);
+
         // Reset size to 0
-        delete[] _m_data;
         _m_size = 0;
-        
-        _m_data = new T[_m_allocated]();
         _m_end = _m_data;
     }
 
@@ -441,13 +438,41 @@ class NaoVector {
      * \param[in] value The element to add.
      */
     void push_back(const T& value) {
-        // Make sure we have enough memory
-        _reallocate_to(_m_size + 1);
+        emplace_back(value);
+    }
+
+    /**
+     * \brief Move an element to the back of the vector.
+     * \param[in] value The element to move.
+     */
+    void push_back(T&& value) {
+        emplace_back(std::move(value));
+    }
+
+    /**
+     * \brief Construct an element in place at the back of the vector.
+     * \param[in] args Arguments for the constructor of `T`.
+     * \return Reference to the new element.
+     * \note Amortized constant time, capacity grows by `growth_factor` when full.
+     */
+    template <typename... Args>
+    reference emplace_back(Args&&... args) {
+        if (_m_size < _m_allocated) {
+            ::new (static_cast<void*>(_m_end)) T(std::forward<Args>(args)...);
+        } else {
+            const size_type new_cap = _grown(_m_size + 1);
+            T* new_data = _allocate(new_cap);
+
+            // Construct before relocating, args may refer to an element of this vector
+            ::new (static_cast<void*>(new_data + _m_size)) T(std::forward<Args>(args)...);
+
+            _relocate(new_data, new_cap);
+        }
 
-        // Assign element
-        *_m_end = value;
         ++_m_end;
         ++_m_size;
+
+        return back();
     }
 
     /**
@@ -483,50 +508,57 @@ class NaoVector {
      */
     template <class InputIt>
     iterator insert(const_iterator pos, InputIt first, InputIt last) {
-        // Get total amount of elements we're inserting
-        size_type count = std::distance(first, last);
-
-        // New size
-        size_type allocate_target = NaoMath::round_up(_m_size + count, data_alignment);
+        const size_type index = std::distance(cbegin(), pos);
 
-        // If we need to grow
-        if (_m_allocated < allocate_target) {
-            // Allocate new memory
-            _m_allocated = allocate_target;
-            T* new_data = new T[_m_allocated]();
+        // Nothing to insert, don't shift anything onto itself
+        if (first == last) {
+            return _m_data + index;
+        }
 
-            // Copy old data up to insert index
-            iterator insert_pos = std::copy(const_iterator(_m_data), pos, new_data);
+        // Get total amount of elements we're inserting
+        const size_type count = std::distance(first, last);
 
-            // Copy inserted elements
-            iterator continue_pos = std::copy(first, last, insert_pos);
+        // If we need to grow
+        if (_m_size + count > _m_allocated) {
+            const size_type new_cap = _grown(_m_size + count);
+            T* new_data = _allocate(new_cap);
 
-            // Copy remaining old elements
-            _m_end = std::copy(pos, const_iterator(_m_end), continue_pos);
+            // Copy inserted elements, then move old elements around them
+            std::uninitialized_copy(first, last, new_data + index);
+            _uninitialized_relocate(_m_data, _m_data + index, new_data);
+            _uninitialized_relocate(_m_data + index, _m_end, new_data + index + count);
 
-            // Fix size
-            _m_size += count;
+            std::destroy(_m_data, _m_end);
+            _deallocate(_m_data);
 
-            // Assign new data
-            delete[] _m_data;
             _m_data = new_data;
-
-            return insert_pos;
+            _m_allocated = new_cap;
+        } else {
+            // Don't need to grow
+            iterator insert_pos = _m_data + index;
+            const size_type trailing = std::distance(insert_pos, _m_end);
+
+            if (trailing > count) {
+                // Trailing elements end up partly in unconstructed storage
+                std::uninitialized_move(_m_end - count, _m_end, _m_end);
+                std::move_backward(insert_pos, _m_end - count, _m_end);
+                std::copy(first, last, insert_pos);
+            } else {
+                // Some inserted elements end up in unconstructed storage
+                InputIt middle = first;
+                std::advance(middle, trailing);
+
+                std::uninitialized_copy(middle, last, _m_end);
+                std::uninitialized_move(insert_pos, _m_end, insert_pos + count);
+                std::copy(first, middle, insert_pos);
+            }
         }
 
-        // Don't need to grow
-
-        // Move trailing elements to the back
-        std::copy_backward(pos, const_iterator(_m_end), _m_end + count);
-
-        // Insert new elements in between
-        std::copy(first, last, const_cast<iterator>(pos));
-
         // Fix sizes
-        _m_end += count;
         _m_size += count;
+        _m_end = _m_data + _m_size;
 
-        return const_cast<iterator>(pos);
+        return _m_data + index;
     }
 
     /**
@@ -536,8 +568,18 @@ class NaoVector {
      * \return Iterator pointing to the last removed element, or end().
      */
     iterator erase(const_iterator first, const_iterator last) {
+        // Empty range, don't move trailing elements onto themselves
+        if (first == last) {
+            return _m_data + std::distance(cbegin(), first);
+        }
+
         // Just move trailing elements on top of the elements to remove
-        _m_end = std::copy(last, cend(), begin() + std::distance(cbegin(), first));
+        iterator new_end = std::move(_m_data + std::distance(cbegin(), last), _m_end,
+            _m_data + std::distance(cbegin(), first));
+
+        // Destroy what's left behind
+        std::destroy(new_end, _m_end);
+        _m_end = new_end;
 
         // fix size
         _m_size -= std::distance(first, last);
@@ -555,7 +597,10 @@ class NaoVector {
      */
     iterator erase(const_iterator pos) {
         // Move all elements past the element to remove back by 1
-        _m_end = std::copy(const_iterator(pos + 1), cend(), iterator(pos));
+        const size_type index = std::distance(cbegin(), pos);
+
+        std::move(_m_data + index + 1, _m_end, _m_data + index);
+        std::destroy_at(--_m_end);
         --_m_size;
 
         // Iterator pointing past the removed element
@@ -596,22 +641,122 @@ class NaoVector {
 
     private:
     /**
-     * \brief Reallocates the vector to a new vector if it needs to grow.
-     * \param[in] size The desired new size.
+     * \brief Rounds a number of elements up to a multiple of `data_alignment`.
+     */
+    static constexpr size_type _round(size_type size) noexcept {
+        return ((size + data_alignment - 1) / data_alignment) * data_alignment;
+    }
+
+    /**
+     * \brief Capacity to grow to so that at least `size` elements fit.
+     * \param[in] size The required number of elements.
+     * \return The larger of `size` and the current capacity times `growth_factor`, rounded.
+     */
+    N_NODISCARD size_type _grown(size_type size) const {
+        if (size > max_size() / element_size) {
+            throw std::length_error("new size is too large for size_type");
+        }
+
+        const size_type grown = (_m_allocated > (max_size() / element_size) / growth_factor)
+            ? size : _m_allocated * growth_factor;
+
+        return _round(std::max<size_type>(size, grown));
+    }
+
+    /**
+     * \brief Allocates uninitialized storage for `count` elements.
+     * \return Pointer to the storage, `nullptr` if `count` is 0.
      */
-    void _reallocate_to(size_t size) {
-        size = NaoMath::round_up(size, data_alignment);
+    static T* _allocate(size_type count) {
+        if (count == 0) {
+            return nullptr;
+        }
+
+        if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return static_cast<T*>(::operator new(count * element_size, std::align_val_t(alignof(T))));
+        } else {
+            return static_cast<T*>(::operator new(count * element_size));
+        }
+    }
 
-        if (_m_allocated < size) {
-            T* old_data = _m_data;
+    /**
+     * \brief Releases storage from _allocate().
+     * \note Does not destroy any elements.
+     */
+    static void _deallocate(T* data) noexcept {
+        if (!data) {
+            return;
+        }
 
-            _m_allocated = size;
-            _m_data = new T[_m_allocated]();
-            _m_end = std::move(old_data, _m_end, _m_data);
-            delete[] old_data;
+        if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(data, std::align_val_t(alignof(T)));
+        } else {
+            ::operator delete(data);
         }
     }
 
+    /**
+     * \brief Moves elements to unconstructed storage, copies them if moving may throw.
+     * \return Past-the-end iterator of the constructed elements.
+     */
+    static iterator _uninitialized_relocate(iterator first, iterator last, iterator dest) {
+        if constexpr (std::is_nothrow_move_constructible_v<T> || !std::is_copy_constructible_v<T>) {
+            return std::uninitialized_move(first, last, dest);
+        } else {
+            return std::uninitialized_copy(first, last, dest);
+        }
+    }
+
+    /**
+     * \brief Moves all elements to new storage and releases the old storage.
+     * \param[in] new_data Storage from _allocate(), which is taken over.
+     * \param[in] new_cap Number of elements `new_data` can hold.
+     */
+    void _relocate(T* new_data, size_type new_cap) {
+        _uninitialized_relocate(_m_data, _m_end, new_data);
+
+        std::destroy(_m_data, _m_end);
+        _deallocate(_m_data);
+
+        _m_data = new_data;
+        _m_end = _m_data + _m_size;
+        _m_allocated = new_cap;
+    }
+
+    /**
+     * \brief Moves all elements to new storage with the given capacity.
+     * \param[in] new_cap The new capacity, at least size().
+     */
+    void _reallocate(size_type new_cap) {
+        _relocate(_allocate(new_cap), new_cap);
+    }
+
+    /**
+     * \brief Replaces all elements with copies of a range.
+     * \param[in] first Iterator pointing to the first element to copy.
+     * \param[in] last Past-the-end iterator of the elements to copy.
+     * \param[in] count Number of elements in the range.
+     */
+    template <class InputIt>
+    void _assign(InputIt first, InputIt last, size_type count) {
+        clear();
+
+        if (count > _m_allocated) {
+            _deallocate(_m_data);
+
+            // Stay valid if allocating throws
+            _m_data = nullptr;
+            _m_end = nullptr;
+            _m_allocated = 0;
+
+            _m_data = _allocate(_round(count));
+            _m_allocated = _round(count);
+        }
+
+        _m_end = std::uninitialized_copy(first, last, _m_data);
+        _m_size = count;
+    }
+
     // Data pointer
     T* _m_data;
 
@@ -0,0 +1,62 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "libnao.h"
+
+#include "Decoding/Archives/NaoArchiveIndexCache.h"
+#include "Plugin/NaoPlugin.h"
+
+class NaoIO;
+
+/*
+ * Archive formats that libnao can index on its own. Formats are detected with
+ * the same NaoSignatureTable that NaoPluginManager picks plugins with, and the
+ * plugins for these formats register the signatures listed here.
+ */
+namespace NaoArchiveFormat {
+    enum Format {
+        Unknown,
+        CPK,
+        DAT
+    };
+
+    // Signatures that identify a format, without any capabilities set
+    LIBNAO_API NaoVector<NaoPlugin::Signature> signatures(Format format);
+
+    // Number of bytes needed to test every signature
+    LIBNAO_API size_t header_size();
+
+    // Format of the archive starting with header
+    LIBNAO_API Format detect(const char* header, size_t size);
+
+    // Format of the data in a range of io, a negative size means everything after offset.
+    // Compressed data is detected from the stored CRILAYLA header, without decompressing.
+    LIBNAO_API Format detect(NaoIO* io, int64_t offset = 0, int64_t size = -1);
+
+    // Index of the archive in io, throws NaoDecodingException if it can't be read
+    LIBNAO_API NaoVector<NaoArchiveIndexCache::Entry> index(NaoIO* io, Format format);
+
+    // Open the archive in a range of io for reading, or return nullptr if it isn't one. Compressed archives
+    // are decompressed into memory, others are read in place through io. Throws NaoDecodingException if the
+    // range is an archive that can't be read. The caller owns the returned IO, which must not outlive io.
+    LIBNAO_API NaoIO* open(NaoIO* io, int64_t offset = 0, int64_t size = -1);
+
+    // Path of the directory that the archive at path is expanded into, with a cleaned file name
+    LIBNAO_API NaoString expanded_path(const NaoString& path);
+}
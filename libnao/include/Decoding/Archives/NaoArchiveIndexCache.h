@@ -0,0 +1,65 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "libnao.h"
+
+#include "Containers/NaoString.h"
+#include "Containers/NaoVector.h"
+
+class NaoIO;
+
+/*
+ * Persistent per-archive index, so archives don't need to be fully parsed every time they're entered.
+ * Only archives backed directly by a NaoFileIO are cached. Indices that weren't used for a long time
+ * are removed, as are the least recently used ones once the cache directory grows too large.
+ */
+class LIBNAO_API NaoArchiveIndexCache {
+    public:
+    // A single file or directory in an archive
+    struct Entry {
+        NaoString name;
+
+        int64_t offset;
+        int64_t binary_size;
+        int64_t real_size;
+
+        bool is_dir;
+    };
+
+    // Load the index for the archive in io, returns false if there is no (valid) cached index
+    static bool load(NaoIO* io, uint32_t fourcc, NaoVector<Entry>& entries);
+
+    // Store the index for the archive in io, replacing any previous index
+    static bool store(NaoIO* io, uint32_t fourcc, const NaoVector<Entry>& entries);
+
+    // Directory the cache files are stored in
+    N_NODISCARD static NaoString cache_dir();
+
+    private:
+    struct Key;
+
+    static bool _make_key(NaoIO* io, uint32_t fourcc, Key& key);
+    N_NODISCARD static NaoString _cache_path(const NaoString& archive);
+
+    // Name suffix for temporary files, unique per process and thread
+    N_NODISCARD static NaoString _temp_suffix();
+
+    // Remove old indices and temporary files, then the least recently used indices until the cache is small enough
+    static void _prune();
+};
@@ -20,6 +20,7 @@
 #include "libnao.h"
 
 #include "NaoObject.h"
+#include "Decoding/Archives/NaoArchiveIndexCache.h"
 
 class NaoIO;
 
@@ -29,13 +30,30 @@ class LIBNAO_API NaoCPKReader {
 
     ~NaoCPKReader();
 
+    // Index of all files and directories, read without creating any objects or IOs
+    N_NODISCARD const NaoVector<NaoArchiveIndexCache::Entry>& entries() const;
+
+    // The IO entry offsets are relative to
+    N_NODISCARD NaoIO* io() const;
+
+    // New IO for the file at the given index, owned by the caller
+    N_NODISCARD NaoIO* open_entry(size_t index) const;
+
+    // Objects are only created on the first call to either of these
     N_NODISCARD const NaoVector<NaoObject*>& files() const;
     N_NODISCARD NaoVector<NaoObject*> take_files();
 
     private:
     void _read_archive();
-    void _resolve_structure();
+    void _parse_archive(NaoVector<NaoArchiveIndexCache::Entry>& entries);
+    void _resolve_structure() const;
+    void _create_files() const;
 
     NaoIO* _m_io;
-    NaoVector<NaoObject*> _m_files;
+
+    struct NCREntriesWrapper;
+    NCREntriesWrapper* _m_entries;
+
+    mutable NaoVector<NaoObject*> _m_files;
+    mutable bool _m_files_created;
 };
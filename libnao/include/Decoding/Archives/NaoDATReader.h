@@ -20,6 +20,7 @@
 #include "libnao.h"
 
 #include "NaoObject.h"
+#include "Decoding/Archives/NaoArchiveIndexCache.h"
 
 class NaoIO;
 
@@ -29,12 +30,54 @@ class LIBNAO_API NaoDATReader {
 
     ~NaoDATReader();
 
+    // Index of all files, read without creating any objects or IOs
+    N_NODISCARD const NaoVector<NaoArchiveIndexCache::Entry>& entries() const;
+
+    // The IO entry offsets are relative to
+    N_NODISCARD NaoIO* io() const;
+
+    // New IO for the file at the given index, owned by the caller
+    N_NODISCARD NaoIO* open_entry(size_t index) const;
+
+    // Objects are only created on the first call to either of these
     N_NODISCARD const NaoVector<NaoObject*>& files() const;
     N_NODISCARD NaoVector<NaoObject*> take_files();
 
+    // Number of files in the archive, unaffected by take_files()
+    N_NODISCARD size_t file_count() const;
+
+    // Index of the file with the given name (case-insensitive), or -1
+    N_NODISCARD int64_t index_of(const NaoString& name) const;
+
+    // File with the given name, or nullptr if it doesn't exist or files were taken
+    N_NODISCARD NaoObject* find(const NaoString& name) const;
+
+    // Extension of the file at the given index, without a leading dot
+    N_NODISCARD const NaoString& extension(size_t index) const;
+
+    // All distinct extensions in this archive
+    N_NODISCARD NaoVector<NaoString> extensions() const;
+
+    // Indices of all files with the given extension (with or without leading dot)
+    N_NODISCARD NaoVector<uint32_t> indices_with_extension(const NaoString& ext) const;
+
+    // All files with the given extension, empty if files were taken
+    N_NODISCARD NaoVector<NaoObject*> files_with_extension(const NaoString& ext) const;
+
     private:
     void _read_archive();
+    void _parse_archive(NaoVector<NaoArchiveIndexCache::Entry>& entries);
+    bool _read_hash_table(uint32_t offset, uint32_t file_count);
+    void _build_hash_table();
+    void _derive_extensions();
+    void _build_extension_index();
+    void _create_files() const;
 
     NaoIO* _m_io;
-    NaoVector<NaoObject*> _m_files;
+
+    mutable NaoVector<NaoObject*> _m_files;
+    mutable bool _m_files_created;
+
+    struct NDRIndex;
+    NDRIndex* _m_index;
 };
@@ -0,0 +1,48 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "libnao.h"
+
+#include "Containers/NaoBytes.h"
+
+/*
+ * CRI's LZ variant, used for compressed CPK entries. The first 256 bytes of the
+ * output are stored as-is at the end of the input, the rest is decompressed
+ * back to front from a bitstream that is also read back to front.
+ */
+namespace NaoCRILAYLA {
+    // Size of the stored header that precedes the decompressed data
+    constexpr size_t header_size = 0x100;
+
+    // Whether data starts with the CRILAYLA magic
+    LIBNAO_API bool is_compressed(const char* data, size_t size);
+
+    // Size of the decompressed data, or -1 if data isn't valid CRILAYLA
+    LIBNAO_API int64_t decompressed_size(const char* data, size_t size);
+
+    // Decompress into out, which must hold decompressed_size() bytes, returns false on malformed input
+    LIBNAO_API bool decompress(const char* data, size_t size, char* out);
+
+    // Decompress a whole buffer, throws NaoDecodingException on malformed input
+    LIBNAO_API NaoBytes decompress(const NaoBytes& data);
+
+    // Decompress data in place if it is compressed and leave anything else as-is, always returns true.
+    // Usable as a NaoExtractionPipeline transform, throws NaoDecodingException on malformed input.
+    LIBNAO_API bool decompress_in_place(NaoBytes& data);
+}
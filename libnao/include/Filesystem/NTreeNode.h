@@ -20,8 +20,12 @@
 #include "libnao.h"
 #include "Containers/NaoVector.h"
 #include "Containers/NaoString.h"
+#include "Containers/NaoBytes.h"
+
+#include <atomic>
 
 class LIBNAO_API NaoIO;
+class LIBNAO_API NaoPlugin;
 
 class LIBNAO_API NTreeNode;
 
@@ -38,9 +42,22 @@ class LIBNAO_API NTreeNode {
     public:
     /**
      * \brief Destructor that also deletes child nodes.
+     * \note Descendants are deleted iteratively, so deep trees don't exhaust the stack.
      */
     ~NTreeNode();
 
+    /**
+     * \brief Allocates nodes from a shared pool of fixed-size slabs.
+     */
+    static void* operator new(size_t size);
+
+    /**
+     * \brief Returns a node to the shared pool.
+     *
+     * Slabs are freed once none of their nodes are in use.
+     */
+    static void operator delete(void* ptr, size_t size);
+
     /**
      * \brief Default empty constructor.
      */
@@ -74,7 +91,7 @@ class LIBNAO_API NTreeNode {
      * \brief Lock this node.
      * \return Whether the lock state was successfully changed.
      *
-     * If a node is locked, none of it's descendants will be deleted automatically.
+     * If a node is locked, none of its descendants will be deleted automatically.
      * This can be used to prevent an expensive operation to happen multiple times.
      * Locked nodes will however be deleted if they are no longer in scope.
      */
@@ -112,6 +129,14 @@ class LIBNAO_API NTreeNode {
      */
     bool set_parent(NTreeNode* parent);
 
+    /**
+     * \brief Set this node's parent without becoming one of its children.
+     * \param[in] parent The parent node.
+     * \note The parent's children aren't read, so this is safe for a node that's
+     *     populated outside of the tree while the tree is being changed.
+     */
+    void set_detached_parent(NTreeNode* parent);
+
     /**
      * \brief Get the parent node.
      * \return This node's parent node.
@@ -123,9 +148,18 @@ class LIBNAO_API NTreeNode {
      * \param[in] child The new child node to add.
      * \return Whether the child was successfully added.
      * \note Fails if `child` is already a child or there is another child with the same name.
+     * \note On success, this node becomes `child`'s parent.
      */
     bool add_child(NTreeNode* child);
 
+    /**
+     * \brief Removes a child node from this node without deleting it.
+     * \param[in] child The child node to remove.
+     * \return Whether `child` was a child of this node.
+     * \note On success, `child` no longer has a parent.
+     */
+    bool remove_child(NTreeNode* child);
+
     /**
      * \brief Get child nodes.
      * \return NaoVector containing pointers to child nodes.
@@ -153,6 +187,14 @@ class LIBNAO_API NTreeNode {
      */
     N_NODISCARD NTreeNode* get_child(const NaoString& name) const;
 
+    /**
+     * \brief Get a pointer to the child with the specified name, or `nullptr`.
+     * \param[in] name The name of the child to retrieve, doesn't need to be null-terminated.
+     * \param[in] size The length of `name`.
+     * \return Pointer to the child if found, else `nullptr`.
+     */
+    N_NODISCARD NTreeNode* get_child(const char* name, size_t size) const;
+
     /**
      * \brief Remove all of a node's children.
      */
@@ -172,6 +214,8 @@ class LIBNAO_API NTreeNode {
     /**
      * \brief Constructs the node's path.
      * \return Complete path pointing to the node, using N_PATHSEP.
+     * \note The parent's path is memoized, so siblings only pay for their own name.
+     * \note Renaming or moving a node only invalidates the memoized paths below it.
      */
     N_NODISCARD NaoString path() const;
 
@@ -186,12 +230,68 @@ class LIBNAO_API NTreeNode {
      */
     N_NODISCARD NaoIO* io() const;
 
+    /**
+     * \brief Caches the first bytes of this node's data.
+     * \param[in] header The header bytes.
+     */
+    void set_header(const NaoBytes& header);
+
+    /**
+     * \return The cached header, empty if there is none.
+     */
+    N_NODISCARD const NaoBytes& header() const;
+
+    /**
+     * \return Whether a header has been cached for this node.
+     * \note Setting a new IO object clears the cached header.
+     */
+    N_NODISCARD bool has_header() const;
+
     /**
      * \return Whether this node represents a directory or a file.
      * \note This function checks if an IO object is present. If so, it's considered a file.
      */
     N_NODISCARD bool is_dir() const;
 
+    /**
+     * \brief Caches the plugin that populates this node.
+     * \param[in] plugin The plugin, or nullptr if no plugin can populate this node.
+     * \note Setting a new IO object or name clears the cached plugin.
+     *
+     * May be called by readers holding only a shared lock on the tree.
+     */
+    void set_populate_plugin(NaoPlugin* plugin);
+
+    /**
+     * \return The cached populate plugin, nullptr if there is none.
+     */
+    N_NODISCARD NaoPlugin* populate_plugin() const;
+
+    /**
+     * \return Whether a populate plugin has been cached for this node.
+     */
+    N_NODISCARD bool has_populate_plugin() const;
+
+    /**
+     * \brief Caches this node's description.
+     * \param[in] description The description.
+     * \note Setting a new IO object or name clears the cached description.
+     *
+     * May be called by readers holding only a shared lock on the tree,
+     * the first description to be cached is kept.
+     */
+    void set_description(const NaoString& description);
+
+    /**
+     * \return The cached description, empty if there is none.
+     */
+    N_NODISCARD NaoString description() const;
+
+    /**
+     * \return Whether a description has been cached for this node.
+     */
+    N_NODISCARD bool has_description() const;
+
     /**
      * \brief Sets this node's display name.
      * \param[in] name THe new display name.
@@ -204,6 +304,22 @@ class LIBNAO_API NTreeNode {
     N_NODISCARD const NaoString& display_name() const;
 
     private:
+    // Find a direct child by name
+    N_NODISCARD NTreeNode* _find_child(const NaoString& name) const;
+    N_NODISCARD NTreeNode* _find_child(const char* name, size_t size) const;
+
+    // Build the hash index over all current children
+    void _build_index();
+
+    // Forget the cached plugin and description
+    void _clear_resolved();
+
+    // Path with leading and trailing separators, memoized on this node
+    N_NODISCARD const NaoString& _raw_path() const;
+
+    // Give this node a new generation after it was renamed or moved
+    void _touch();
+
     // Parent node of this node
     NTreeNode* _m_parent;
 
@@ -222,6 +338,36 @@ class LIBNAO_API NTreeNode {
     // Whether an IO object if this node represents a file, or nullptr if it's a directory
     NaoIO* _m_io;
 
-    // The node's display name
-    NaoString _m_display_name;
+    // The node's display name, nullptr if it's the same as the name
+    NaoString* _m_display_name;
+
+    // Cached start of the data, used for format detection
+    NaoBytes _m_header;
+
+    // Whether _m_header is valid
+    bool _m_has_header;
+
+    // Cached populate plugin, valid if _m_has_populate_plugin is set, readers may fill it in
+    std::atomic<NaoPlugin*> _m_populate_plugin;
+    std::atomic<bool> _m_has_populate_plugin;
+
+    // Cached description, nullptr if it's not known yet, readers may fill it in
+    std::atomic<NaoString*> _m_description;
+
+    // Hash index from name to child, only present for nodes with many children
+    struct NTNIndex;
+    NTNIndex* _m_index;
+
+    // Memoized raw path
+    mutable NaoString* _m_path;
+
+    // Generation of the last rename or move of this node
+    uint64_t _m_generation;
+
+    // One more than the newest generation on the parent chain when _m_path was built, 0 if it wasn't.
+    // The memo is valid while no node on the chain has a newer generation.
+    mutable std::atomic<uint64_t> _m_path_stamp;
+
+    // Held while _m_path is rebuilt
+    mutable std::atomic<bool> _m_path_locked;
 };
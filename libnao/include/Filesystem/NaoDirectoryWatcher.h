@@ -0,0 +1,80 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "libnao.h"
+
+#include "Containers/NaoString.h"
+#include "Containers/NaoVector.h"
+
+/**
+ * \ingroup libnao
+ *
+ * \brief Reports which entries of a directory changed.
+ *
+ * Uses the operating system's change notifications where possible, and falls
+ * back to comparing directory listings otherwise. Subdirectories aren't watched.
+ */
+class LIBNAO_API NaoDirectoryWatcher {
+    public:
+    /**
+     * \brief Starts watching a directory.
+     * \param[in] path The directory to watch.
+     */
+    explicit NaoDirectoryWatcher(const NaoString& path);
+
+    /**
+     * \brief Stops watching.
+     */
+    ~NaoDirectoryWatcher();
+
+    NaoDirectoryWatcher(const NaoDirectoryWatcher&) = delete;
+    NaoDirectoryWatcher& operator=(const NaoDirectoryWatcher&) = delete;
+
+    /**
+     * \return The watched directory.
+     */
+    N_NODISCARD const NaoString& path() const;
+
+    /**
+     * \return Whether change notifications are used instead of polling.
+     */
+    N_NODISCARD bool native() const;
+
+    /**
+     * \brief Retrieves the entries that changed since the last call.
+     * \param[out] names Receives the names of all entries that were added, removed or modified.
+     * \return Whether all changes were reported, if not the directory must be rescanned.
+     *
+     * A name may be reported more than once.
+     */
+    bool poll(NaoVector<NaoString>& names);
+
+    private:
+    // (Re)start listening for notifications
+    bool _listen();
+
+    // Compare the directory to the last listing
+    bool _poll_listing(NaoVector<NaoString>& names);
+
+    NaoString _m_path;
+
+    struct NDWState;
+    NDWState* _m_state;
+};
@@ -19,7 +19,10 @@
 
 #include "libnao.h"
 
+#include "Plugin/NaoPlugin.h"
+
 #include <memory>
+#include <shared_mutex>
 
 #define NFSM NaoFileSystemManager::global_instance()
 
@@ -33,6 +36,10 @@ class NFSMPrivate;
  * \ingroup libnao
  *
  * \brief Singleton class which keeps track of a filesystem tree.
+ *
+ * Changes to the tree (moving, refreshing and probing) happen one at a time. Any number
+ * of threads may read the tree while holding read_lock(). Readers are only blocked while
+ * a change is committed, nodes are populated outside of the tree and then moved in at once.
  */
 class NaoFileSystemManager {
     public:
@@ -50,7 +57,7 @@ class NaoFileSystemManager {
     LIBNAO_API bool init(const NaoString& start_dir) const;
 
     /**
-     * \brief Creates a node (and all it's parent nodes if needed).
+     * \brief Creates a node (and all its parent nodes if needed).
      * \param[in] path The path of the node to create.
      * \return Pointer to the newly created node.
      */
@@ -63,18 +70,105 @@ class NaoFileSystemManager {
      */
     LIBNAO_API bool move(const NaoString& path) const;
 
+    /**
+     * \brief Moves the current node to the new path, passing on the new children as they're added.
+     * \param[in] path The path of the new position.
+     * \param[in] callback Receives the new children in batches, called on the moving thread.
+     * \return Whether the operation succeeded.
+     *
+     * The headers of every batch are probed before it's passed on. The callback is
+     * only used if the node has to be populated, if it's already populated (or was
+     * prefetched) its children are available through current() once this returns.
+     */
+    LIBNAO_API bool move(const NaoString& path, const NaoPlugin::PopulateCallback& callback) const;
+
     /**
      * \return Pointer to the currently active node.
      */
     N_NODISCARD LIBNAO_API NTreeNode* current() const;
 
+    /**
+     * \brief Locks the tree for reading.
+     * \return A lock that keeps the tree from changing for as long as it's held.
+     *
+     * Hold this while walking nodes that are part of the tree from another thread than the one that changes it.
+     * Don't call any of the changing functions while holding it.
+     */
+    N_NODISCARD LIBNAO_API std::shared_lock<std::shared_mutex> read_lock() const;
+
+    /**
+     * \brief Keeps a node, its descendants and its parents from being removed to save memory.
+     * \param[in] node The node to lock, which must be part of the tree.
+     *
+     * Use this to keep using a node after the read lock was released, like on a worker thread.
+     * A node may be locked more than once, it stays locked until it's unlocked as often.
+     * Locked nodes are still changed when they're refreshed.
+     */
+    LIBNAO_API void lock(NTreeNode* node) const;
+
+    /**
+     * \brief Releases a lock taken with lock().
+     * \param[in] node The node to unlock.
+     */
+    LIBNAO_API void unlock(NTreeNode* node) const;
+
     /**
      * \brief Get a node's plugin-supplied description.
      * \param[in] node The node to fetch the description for.
      * \return The description for the specified note.
+     *
+     * The description is cached on the node until its IO or name changes.
+     * Safe to call while holding read_lock().
      */
     N_NODISCARD LIBNAO_API NaoString description(NTreeNode* node) const;
 
+    /**
+     * \brief Reads and caches the headers of all of a node's file children at once.
+     * \param[in] node The node whose children to probe.
+     * \param[in] size Number of bytes to read, or -1 for what the plugins need.
+     *
+     * Files on disk are read concurrently. Headers that were already cached are kept.
+     */
+    LIBNAO_API void probe(NTreeNode* node, int64_t size = -1) const;
+
+    /**
+     * \brief Applies changes on disk to the current node's children.
+     * \param[out] changes Receives the children that were added, removed or modified.
+     * \return Whether the node was refreshed, if not it has to be moved to again.
+     *
+     * Only the changed children are touched. Removed children stay valid until the next move or refresh.
+     */
+    LIBNAO_API bool refresh(NaoPlugin::Changes& changes) const;
+
+    /**
+     * \brief Sets how much memory recently visited nodes may keep using.
+     * \param[in] bytes Approximate number of bytes, 0 to only keep the current node.
+     *
+     * Retained nodes stay populated, so moving back to them doesn't populate them again.
+     * The least recently visited nodes are released first when the budget is exceeded.
+     */
+    LIBNAO_API void set_retention_budget(int64_t bytes) const;
+
+    /**
+     * \return The memory budget for recently visited nodes, in bytes.
+     */
+    N_NODISCARD LIBNAO_API int64_t retention_budget() const;
+
+    /**
+     * \brief Enables or disables background prefetching.
+     * \param[in] enabled Whether to prefetch.
+     *
+     * After every move, the children that are most likely to be opened next
+     * are populated on a low-priority thread. Moving into one of them uses
+     * the prefetched result. A move always cancels prefetching first.
+     */
+    LIBNAO_API void set_prefetch_enabled(bool enabled) const;
+
+    /**
+     * \return Whether background prefetching is enabled.
+     */
+    N_NODISCARD LIBNAO_API bool prefetch_enabled() const;
+
     //LIBNAO_API bool move(const NaoString& target);
 
     //N_NODISCARD LIBNAO_API NaoObject* current_object() const;
@@ -19,6 +19,18 @@
 
 #include "libnao.h"
 
+#include "Plugin/NaoPlugin.h"
+
+#include "Containers/NaoVector.h"
+#include "Containers/NaoString.h"
+
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_map>
+
 class NTreeNode;
 
 /**
@@ -54,6 +66,66 @@ class NFSMPrivate {
      */
     N_NODISCARD NTreeNode* root() const;
 
+    /**
+     * \brief Locks the tree for reading.
+     * \return A shared lock on the tree.
+     */
+    N_NODISCARD std::shared_lock<std::shared_mutex> read_lock() const;
+
+    /**
+     * \brief Keeps a node, its descendants and its parents from being removed by gc().
+     * \param[in] node The node to lock.
+     *
+     * Locks are counted, the node is unlocked once unlock() was called as often.
+     */
+    void lock(NTreeNode* node);
+
+    /**
+     * \brief Releases a lock taken with lock().
+     * \param[in] node The node to unlock.
+     */
+    void unlock(NTreeNode* node);
+
+    /**
+     * \brief Serialises everything that changes the tree.
+     * \return The mutex held by every move, refresh and probe.
+     *
+     * The writer holding this may read the tree without locking it,
+     * and only locks it exclusively while committing a change.
+     */
+    N_NODISCARD std::mutex& write_mutex();
+
+    /**
+     * \brief Finds the node at a path, creating it and its parents if needed.
+     * \param[in] path The path of the node.
+     * \return The node, or nullptr if the path is invalid.
+     *
+     * Recently resolved paths are cached, so resolving one again is a single lookup.
+     * The cache is cleared whenever nodes are removed from the tree.
+     */
+    N_NODISCARD NTreeNode* retrieve_node(const NaoString& path);
+
+    /**
+     * \brief Populates a node outside of the tree, then moves the result into it.
+     * \param[in] node The node to populate.
+     * \param[in] plugin The plugin to populate with.
+     * \param[in] callback Receives batches of new children as they're added, may be empty.
+     * \return Whether the node was populated.
+     *
+     * Readers never see a partially populated node. The new children are probed before
+     * they're passed on or committed.
+     */
+    bool populate(NTreeNode* node, NaoPlugin* plugin, const NaoPlugin::PopulateCallback& callback);
+
+    /**
+     * \brief Reads and caches the headers of all file nodes that don't have one yet.
+     * \param[in] nodes The nodes to probe.
+     * \param[in] size Number of bytes to read.
+     * \param[in] in_tree Whether the nodes are part of the tree, if so the headers are stored
+     *     under an exclusive lock.
+     */
+    void probe(const NaoVector<NTreeNode*>& nodes, int64_t size, bool in_tree);
+
     /**
      * \brief Sets the currently active node.
      * \param[in] node The new active node.
@@ -72,17 +144,178 @@ class NFSMPrivate {
      * A node is considered needed if any of the following apply:
      *  - It's a descendant of a locked node.
      *  - It's a parent of a locked node.
-     * The currently selected node is also considered locked.
+     *  - It's a child or parent of a retained node.
+     * The currently selected node is also considered retained.
+     *
+     * Recently visited nodes are retained, together with their children,
+     * until their estimated size exceeds the retention budget. The least
+     * recently visited nodes are released first. Populated subtrees below a
+     * retained node's children are released unless they lead to another
+     * retained node.
+     *
+     * Removed subtrees are deleted on a background thread. Holds the tree lock exclusively.
      */
     void gc();
 
+    /**
+     * \brief Sets the memory budget for retained nodes.
+     * \param[in] bytes Approximate number of bytes to retain, 0 to only keep the current node.
+     */
+    void set_retention_budget(int64_t bytes);
+
+    /**
+     * \return The memory budget for retained nodes, in bytes.
+     */
+    N_NODISCARD int64_t retention_budget() const;
+
+    /**
+     * \brief Enables or disables background prefetching.
+     * \param[in] enabled Whether to prefetch.
+     */
+    void set_prefetch_enabled(bool enabled);
+
+    /**
+     * \return Whether background prefetching is enabled.
+     */
+    N_NODISCARD bool prefetch_enabled() const;
+
+    /**
+     * \brief Start populating the children of a node that are likely to be opened next.
+     * \param[in] node The node whose children to prefetch.
+     *
+     * Children are populated into separate nodes on a low-priority thread,
+     * and only become part of the tree when adopt_prefetched() is called.
+     * Recently visited children go first, then archives from large to small,
+     * then directories.
+     */
+    void prefetch(NTreeNode* node);
+
+    /**
+     * \brief Stops prefetching after the node that is currently being populated.
+     *
+     * Results that were already finished are kept.
+     */
+    void cancel_prefetch();
+
+    /**
+     * \brief Moves prefetched children into a node.
+     * \param[in] node The node to populate.
+     * \return Whether a prefetched result was used, in which case the node is populated.
+     */
+    bool adopt_prefetched(NTreeNode* node);
+
+    /**
+     * \brief Applies changes to a node's children using the plugin that populated it.
+     * \param[in] node The node to refresh.
+     * \param[out] changes Receives the changed children.
+     * \return Whether the node was refreshed, if not it must be populated again.
+     *
+     * Removed children and replaced IO's stay valid until the next gc() or refresh.
+     */
+    bool refresh(NTreeNode* node, NaoPlugin::Changes& changes);
+
     private:
 
+    // A recently visited node
+    struct Retained {
+        NTreeNode* node;
+
+        // Estimated size of the node and its children
+        int64_t cost;
+    };
+
+    // A recently resolved path
+    struct CachedPath {
+        NaoString path;
+        NTreeNode* node;
+    };
+
+    // Marks the current node as the most recently visited one
+    void _touch();
+
+    // Estimate memory usage of a node and its children, which is what gc() keeps for a retained node
+    N_NODISCARD static int64_t _retained_cost(NTreeNode* node);
+
+    // Queue detached subtrees for deletion, except for those that contain a locked node
+    void _release_detached();
+
+    // Queue subtrees for deletion
+    void _release(const NaoVector<NTreeNode*>& nodes);
+    void _release(NTreeNode* const* first, NTreeNode* const* last);
+
+    // Deletes queued subtrees until stopped
+    void _release_worker();
+
+    // A node to prefetch
+    struct PrefetchTarget {
+        NaoString name;
+        NaoString path;
+
+        // Directories don't have an IO
+        bool dir;
+    };
+
+    // A populated node that isn't part of the tree yet
+    struct Prefetched {
+        NaoString path;
+        NTreeNode* node;
+    };
+
+    // Populates prefetch targets until stopped
+    void _prefetch_worker();
+
     // Root tree node
     NTreeNode* _m_root;
 
     // Current node
-    NTreeNode* _m_current;
+    std::atomic<NTreeNode*> _m_current;
+
+    // Recently resolved paths by their hash, only used by the writer
+    std::unordered_map<uint64_t, CachedPath> _m_path_cache;
+
+    // Held for the whole of every change to the tree
+    std::mutex _m_write_mutex;
+
+    // Shared by readers, exclusive while a change is committed
+    mutable std::shared_mutex _m_tree_mutex;
+
+    // Retained nodes, least recently visited first
+    NaoVector<Retained> _m_retained;
+
+    // Maximum estimated size of all retained nodes
+    std::atomic<int64_t> _m_retention_budget;
+
+    // Nodes removed by a refresh, deleted on the next gc() or refresh once nothing in them is locked
+    NaoVector<NTreeNode*> _m_detached;
+
+    // Locked nodes, once per lock, gc() reads them under the exclusive tree lock
+    NaoVector<NTreeNode*> _m_locked;
+    std::mutex _m_locked_mutex;
+
+    // Recently visited paths, least recent first, outlives retention
+    NaoVector<NaoString> _m_history;
+
+    // Background prefetching
+    std::atomic<bool> _m_prefetch_enabled;
+    NTreeNode* _m_prefetch_parent;
+    NaoVector<PrefetchTarget> _m_prefetch_queue;
+    NaoVector<Prefetched> _m_prefetched;
+
+    // Node being prefetched from, gc() must not delete it
+    NTreeNode* _m_prefetch_pinned;
+    std::mutex _m_prefetch_mutex;
+    std::condition_variable _m_prefetch_cond;
+    bool _m_prefetch_stop;
+
+    // Started by the first prefetch() that has work for it
+    std::thread _m_prefetch_thread;
+
+    // Subtrees waiting to be deleted
+    NaoVector<NTreeNode*> _m_release_queue;
+    std::mutex _m_release_mutex;
+    std::condition_variable _m_release_cond;
+    bool _m_release_stop;
+    std::thread _m_release_thread;
 
 #if 0
     public:
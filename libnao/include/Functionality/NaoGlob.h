@@ -0,0 +1,76 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+/**
+ * \file NaoGlob.h
+ *
+ * \brief Contains the NaoGlob class.
+ */
+
+#include "libnao.h"
+
+#include "Containers/NaoString.h"
+
+/**
+ * \ingroup libnao
+ *
+ * \brief Shell-style wildcard pattern for paths inside archives.
+ *
+ * - `*` matches anything within a single path component
+ * - `**` matches anything including separators, `**` followed by a separator may also match no directories at all
+ * - `?` matches a single character other than a separator
+ * - `[abc]`, `[a-z]` and `[!abc]` match a single character from (or not from) a set
+ *
+ * `/` and `\\` are equivalent and matching is case-insensitive. A pattern
+ * without separators is matched against the last path component only.
+ */
+class LIBNAO_API NaoGlob {
+    public:
+
+    /**
+     * \brief Compile a pattern.
+     * \param[in] pattern The pattern to match paths against.
+     */
+    explicit NaoGlob(const NaoString& pattern);
+
+    /**
+     * \brief Test a path against the pattern.
+     * \param[in] path The path to test, using either separator.
+     * \return Whether the whole path (or its last component) matches.
+     */
+    N_NODISCARD bool matches(const NaoString& path) const;
+
+    /**
+     * \overload
+     */
+    N_NODISCARD bool matches(const char* path, size_t size) const;
+
+    /**
+     * \return The pattern, lowercase and with `/` as separator.
+     */
+    N_NODISCARD const NaoString& pattern() const;
+
+    private:
+
+    // Lowercase, with '/' as separator
+    NaoString _m_pattern;
+
+    // Whether only the last path component is matched
+    bool _m_basename;
+};
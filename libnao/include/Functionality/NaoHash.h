@@ -0,0 +1,80 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "libnao.h"
+
+#include <array>
+
+namespace NaoHash {
+    // Lookup table for the reflected CRC-32 polynomial (same as zlib)
+    constexpr std::array<uint32_t, 256> crc32_table = [] {
+        std::array<uint32_t, 256> table { };
+
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+
+            for (int j = 0; j < 8; ++j) {
+                c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+            }
+
+            table[i] = c;
+        }
+
+        return table;
+    }();
+
+    // ASCII-only lowercase, names in archives are never anything else
+    constexpr char to_lower(char c) noexcept {
+        return (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+    }
+
+    // Standard CRC-32 of a buffer
+    constexpr uint32_t crc32(const char* data, size_t size, uint32_t crc = 0) noexcept {
+        crc = ~crc;
+
+        for (size_t i = 0; i < size; ++i) {
+            crc = crc32_table[(crc ^ uint8_t(data[i])) & 0xFF] ^ (crc >> 8);
+        }
+
+        return ~crc;
+    }
+
+    // CRC-32 of a buffer as if it were converted to lowercase first
+    constexpr uint32_t crc32_lower(const char* data, size_t size, uint32_t crc = 0) noexcept {
+        crc = ~crc;
+
+        for (size_t i = 0; i < size; ++i) {
+            crc = crc32_table[(crc ^ uint8_t(to_lower(data[i]))) & 0xFF] ^ (crc >> 8);
+        }
+
+        return ~crc;
+    }
+
+    // 64-bit FNV-1a, for in-memory hash tables
+    constexpr uint64_t fnv1a(const char* data, size_t size) noexcept {
+        uint64_t hash = 0xCBF29CE484222325;
+
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= uint8_t(data[i]);
+            hash *= 0x100000001B3;
+        }
+
+        return hash;
+    }
+}
@@ -0,0 +1,106 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "libnao.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/*
+ * Work is run on a single pool of threads that lives as long as the process. Idle
+ * threads pick up new tasks, a new thread is started only when none is idle, and
+ * threads that stay idle for a while exit. Long-running tasks (like the stages of
+ * NaoExtractionPipeline) therefore never hold up short ones.
+ */
+namespace NaoParallel {
+    // Number of threads to use for IO-bound work, which benefits from more threads than cores
+    inline size_t io_threads() {
+        return std::max<size_t>(4, size_t(std::thread::hardware_concurrency()) * 2);
+    }
+
+    // Run task on a pool thread
+    LIBNAO_API void submit(std::function<void()> task);
+
+    // Number of threads in the pool, idle or not
+    LIBNAO_API size_t pool_size();
+
+    // Call func(i) for every i in [0, count), spread over at most `threads` threads
+    template <typename Func>
+    void for_each_index(size_t count, Func func, size_t threads = io_threads()) {
+        threads = std::min<size_t>(threads, count);
+
+        if (threads <= 1) {
+            for (size_t i = 0; i < count; ++i) {
+                func(i);
+            }
+
+            return;
+        }
+
+        // Outlives this call, for helpers that are only started after it returned
+        struct Shared {
+            std::atomic<size_t> next = 0;
+
+            std::mutex mutex;
+            std::condition_variable cond;
+            size_t active = 0;
+            bool closed = false;
+        };
+
+        const std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+
+        auto work = [&func, count](Shared& state) {
+            for (size_t i = state.next++; i < count; i = state.next++) {
+                func(i);
+            }
+        };
+
+        for (size_t i = 0; i < threads - 1; ++i) {
+            submit([shared, &work] {
+                {
+                    // Everything was already done by the time this helper started
+                    std::lock_guard lock(shared->mutex);
+                    if (shared->closed) {
+                        return;
+                    }
+
+                    ++shared->active;
+                }
+
+                work(*shared);
+
+                std::lock_guard lock(shared->mutex);
+                --shared->active;
+                shared->cond.notify_all();
+            });
+        }
+
+        // This thread works as well, and only waits for helpers that already started
+        work(*shared);
+
+        std::unique_lock lock(shared->mutex);
+        shared->closed = true;
+        shared->cond.wait(lock, [&shared] { return shared->active == 0; });
+    }
+}
@@ -0,0 +1,91 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+/**
+ * \file NaoPathFilter.h
+ *
+ * \brief Contains the NaoPathFilter class.
+ */
+
+#include "libnao.h"
+
+#include "Containers/NaoString.h"
+
+/**
+ * \ingroup libnao
+ *
+ * \brief Include and exclude patterns for paths inside archives.
+ *
+ * Patterns are compiled once when they're added. A path passes if it matches
+ * any include pattern (or there are none) and no exclude pattern, so excludes
+ * take precedence over includes.
+ */
+class LIBNAO_API NaoPathFilter {
+    public:
+
+    NaoPathFilter();
+    NaoPathFilter(const NaoPathFilter& other);
+    NaoPathFilter& operator=(const NaoPathFilter& other);
+    ~NaoPathFilter();
+
+    /**
+     * \name Glob patterns
+     * \brief Add a pattern as described by NaoGlob.
+     * \{
+     */
+    void include(const NaoString& glob);
+    void exclude(const NaoString& glob);
+    /**
+     * \}
+     */
+
+    /**
+     * \name Regex patterns
+     * \brief Add an ECMAScript regex, matched case-insensitively against the whole path with `/` as separator.
+     * \return Whether the regex is valid.
+     * \{
+     */
+    bool include_regex(const NaoString& regex);
+    bool exclude_regex(const NaoString& regex);
+    /**
+     * \}
+     */
+
+    /**
+     * \return Whether every path passes.
+     */
+    N_NODISCARD bool empty() const;
+
+    /**
+     * \brief Test a path against all patterns.
+     * \param[in] path The path to test, using either separator.
+     * \return Whether the path passes.
+     */
+    N_NODISCARD bool matches(const NaoString& path) const;
+
+    /**
+     * \overload
+     */
+    N_NODISCARD bool matches(const char* path, size_t size) const;
+
+    private:
+
+    struct NPFPrivate;
+    NPFPrivate* d_ptr;
+};
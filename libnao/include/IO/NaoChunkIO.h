@@ -22,6 +22,11 @@
 #include "IO/NaoIO.h"
 #include "Containers/NaoVector.h"
 
+/*
+ * Exposes (a list of) chunks of another IO as a single device.
+ * A chunk IO over another chunk IO resolves its chunks to the root IO,
+ * so reads never pass through more than one layer.
+ */
 class LIBNAO_API NaoChunkIO : public NaoIO {
     public:
 
@@ -36,7 +41,7 @@ class LIBNAO_API NaoChunkIO : public NaoIO {
     NaoChunkIO(NaoIO* io, const Chunk& chunk);
     NaoChunkIO(NaoIO* io, const NaoVector<Chunk>& chunks);
 
-    ~NaoChunkIO() = default;
+    ~NaoChunkIO() override;
 
     int64_t pos() const override;
 
@@ -44,6 +49,9 @@ class LIBNAO_API NaoChunkIO : public NaoIO {
 
     int64_t read(char* buf, int64_t size) override;
 
+    // Reads directly from the root IO, without changing the position
+    int64_t read_at(int64_t pos, char* buf, int64_t size) override;
+
     int64_t write(const char* buf, int64_t size) override;
 
     bool flush() override;
@@ -52,9 +60,16 @@ class LIBNAO_API NaoChunkIO : public NaoIO {
 
     void close() override;
 
+    // The IO that is actually read from
+    N_NODISCARD NaoIO* root() const;
+
+    // Chunks as positioned on the root IO
+    N_NODISCARD const NaoVector<Chunk>& chunks() const;
+
     private:
 
-    void _set_chunk(Chunk* chunk);
+    void _add_chunks(NaoIO* io, const NaoVector<Chunk>& chunks);
+    N_NODISCARD int64_t _chunk_index(int64_t pos) const;
 
     NaoIO* _m_io;
 
@@ -62,8 +77,4 @@ class LIBNAO_API NaoChunkIO : public NaoIO {
     NCIChunksWrapper* _m_nci;
 
     int64_t _m_pos;
-
-    Chunk* _m_current_chunk;
-    uint64_t _m_current_index;
-    int64_t _m_bytes_left;
 };
@@ -0,0 +1,146 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "libnao.h"
+
+#include "Containers/NaoBytes.h"
+#include "Containers/NaoString.h"
+#include "Functionality/NaoPathFilter.h"
+
+#include <functional>
+
+class NaoIO;
+
+/*
+ * Extracts entries to files in three overlapping stages: readers load entries
+ * with positional reads, transformers decompress or convert them and writers
+ * store them. Stages are connected by bounded lock-free queues, a full queue
+ * makes the stage before it wait, and the total size of buffered entries is
+ * limited by a byte budget.
+ *
+ * Entries without a transform skip the transform stage, entries larger than
+ * max_block without a transform are streamed to disk by a reader in blocks.
+ *
+ * Optionally, entries that are archives (see NaoArchiveFormat) are expanded by
+ * the reader that picks them up: their files are queued as new entries in a
+ * directory named after the archive, read in place from the outer archive's
+ * byte range. Only compressed archives are decompressed into memory first,
+ * that memory counts against the byte budget. Files in an expanded archive are
+ * read before anything else, and the archive is freed once they are done.
+ */
+class LIBNAO_API NaoExtractionPipeline {
+    public:
+    // Changes an entry's data in place, returns false if the entry should fail
+    using Transform = std::function<bool(NaoBytes&)>;
+
+    // Receives the number of source bytes extracted so far, called on the thread that calls run()
+    using ProgressCallback = std::function<void(int64_t)>;
+
+    // A single entry to extract
+    struct Entry {
+        // Data to extract, reads go to its root IO positionally
+        NaoIO* source;
+
+        // Output file, missing parent directories are created
+        NaoString target;
+
+        // Optional, runs on a transform thread
+        Transform transform;
+
+        // Range of source to extract, a negative size extracts everything after offset.
+        // Lets entries be read straight from an archive, without an IO per entry.
+        int64_t offset = 0;
+        int64_t size = -1;
+
+        // Tested against Config::filter, entries without a path are always extracted.
+        // Files in an expanded archive get paths below the archive's path.
+        NaoString path;
+    };
+
+    // Thread counts per stage and memory limits, 0 picks a default
+    struct Config {
+        size_t readers = 0;
+        size_t transformers = 0;
+        size_t writers = 0;
+
+        // Maximum size of all entries and decompressed archives held in memory at once, counted as read
+        int64_t byte_budget = 256 * 1024 * 1024;
+
+        // Capacity of each queue between stages
+        size_t queue_capacity = 256;
+
+        // Extract the contents of archives instead of the archives themselves
+        bool expand_archives = false;
+
+        // Archives nested deeper than this are extracted as-is, for archives that (claim to) contain themselves
+        size_t max_depth = 16;
+
+        // Only entries with a matching path are extracted, archives are expanded regardless
+        NaoPathFilter filter;
+    };
+
+    NaoExtractionPipeline();
+    explicit NaoExtractionPipeline(const Config& config);
+
+    ~NaoExtractionPipeline();
+
+    NaoExtractionPipeline(const NaoExtractionPipeline&) = delete;
+    NaoExtractionPipeline& operator=(const NaoExtractionPipeline&) = delete;
+
+    // Queue an entry, may be called from any thread, also while running
+    void submit(const Entry& entry);
+
+    // Convenience overloads
+    void submit(NaoIO* source, const NaoString& target, const Transform& transform = nullptr);
+    void submit(NaoIO* source, int64_t offset, int64_t size,
+        const NaoString& target, const Transform& transform = nullptr);
+
+    // Extract entries until all submitted entries are done, returns whether every entry succeeded
+    bool run(const ProgressCallback& progress = nullptr);
+
+    // Stop as soon as possible, may be called from any thread, run() returns false
+    void cancel();
+
+    N_NODISCARD bool cancelled() const;
+
+    // Number of entries submitted
+    N_NODISCARD size_t count() const;
+
+    // Total size of all submitted sources, before transforming
+    N_NODISCARD int64_t total_size() const;
+
+    // Number of entries that failed in the last run
+    N_NODISCARD size_t failed() const;
+
+    // Number of archives expanded in the last run
+    N_NODISCARD size_t expanded() const;
+
+    // Number of entries not extracted because of the filter in the last run
+    N_NODISCARD size_t skipped() const;
+
+    // Number of bytes written in the last run, after transforming
+    N_NODISCARD int64_t bytes_written() const;
+
+    // Largest single read when streaming, and largest entry read in one go without a transform
+    static constexpr int64_t max_block = 4 * 1024 * 1024;
+
+    private:
+    struct NEPPrivate;
+    NEPPrivate* d_ptr;
+};
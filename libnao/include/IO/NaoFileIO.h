@@ -28,6 +28,10 @@ class LIBNAO_API NaoFileIO : public NaoIO {
     public:
     NaoFileIO(const NaoString& path);
 
+    // For when the size is already known, doesn't touch the file.
+    // write_time is the last write time reported together with the size, 0 if unknown
+    NaoFileIO(const NaoString& path, int64_t size, int64_t write_time = 0);
+
     ~NaoFileIO() override;
 
     int64_t pos() const override;
@@ -38,6 +42,9 @@ class LIBNAO_API NaoFileIO : public NaoIO {
     using NaoIO::read;
     // Read size bytes into buf
     int64_t read(char* buf, int64_t size) override;
+
+    // Positional read that leaves the stream position untouched
+    int64_t read_at(int64_t pos, char* buf, int64_t size) override;
     
     using NaoIO::write;
     // Write size bytes from buf
@@ -50,8 +57,15 @@ class LIBNAO_API NaoFileIO : public NaoIO {
 
     const NaoString& path() const;
 
+    // Last write time passed to the constructor, 0 if unknown
+    int64_t write_time() const;
+
     private:
 
     NaoString _m_path;
     FILE* _m_file_ptr;
+    int64_t _m_write_time;
+
+    // Native handle used by read_at while opened ReadOnly
+    void* volatile _m_read_handle;
 };
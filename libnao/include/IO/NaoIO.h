@@ -99,6 +99,18 @@ class LIBNAO_API NaoIO {
      */
     N_NODISCARD NaoBytes read(size_t size);
 
+    /**
+     * \brief Read data from an absolute position.
+     * \param[in] pos The position to read from.
+     * \param[out] buf The buffer to read the bytes into.
+     * \param[in] size The number of bytes to read.
+     * \return The number of bytes read, or -1 on error.
+     *
+     * The default implementation seeks and reads, subclasses
+     * that can read without moving the stream position override this.
+     */
+    virtual int64_t read_at(int64_t pos, char* buf, int64_t size);
+
     /**
      * \brief Performs a single read.
      * \param[in] size The number of bytes to read.
@@ -35,6 +35,9 @@ class LIBNAO_API NaoMemoryIO : public NaoIO {
     using NaoIO::read;
     int64_t read(char* buf, int64_t size) override;
 
+    // Copies without changing the position, safe to call from multiple threads
+    int64_t read_at(int64_t pos, char* buf, int64_t size) override;
+
     using NaoIO::write;
     int64_t write(const char* buf, int64_t size) override;
 
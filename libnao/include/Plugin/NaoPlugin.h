@@ -20,13 +20,18 @@
 #include "libnao.h"
 
 #include "Containers/NaoString.h"
+#include "Containers/NaoBytes.h"
+#include "Containers/NaoVector.h"
+
+#include <functional>
 
 //class NaoObject;
 //class NaoIO;
 
 class LIBNAO_API NaoPlugin;
 class LIBNAO_API NTreeNode;
-//class LIBNAO_API NaoAction;
+class LIBNAO_API NaoAction;
+class LIBNAO_API NaoIO;
 
 using PluginFunc = NaoPlugin*(*)();
 
@@ -75,6 +80,57 @@ class LIBNAO_API NaoPlugin {
      */
     N_NODISCARD virtual NaoString author_description() const = 0;
 
+    /**
+     * \brief What a matched signature means for a node.
+     */
+    enum Capability : uint32_t {
+        /**
+         * \brief The plugin can populate the node.
+         */
+        Populate    = 0x1,
+
+        /**
+         * \brief The plugin has a description for the node.
+         */
+        Description = 0x2
+    };
+
+    /**
+     * \brief A magic signature identifying a file format.
+     *
+     * A file matches if, for every byte, `(file[offset + i] & mask[i]) == (bytes[i] & mask[i])`.
+     */
+    struct Signature {
+        /**
+         * \brief Offset of the signature from the start of the file.
+         */
+        int64_t offset;
+
+        /**
+         * \brief The bytes to match.
+         */
+        NaoBytes bytes;
+
+        /**
+         * \brief Mask applied before comparing, empty to compare all bits.
+         */
+        NaoBytes mask;
+
+        /**
+         * \brief Bitwise OR of Capability values this signature provides.
+         */
+        uint32_t capabilities;
+    };
+
+    /**
+     * \return All signatures this plugin recognises.
+     *
+     * Signatures are collected once when the plugin is loaded. For file nodes, a plugin
+     * that registered a signature for a capability is only selected through a signature match,
+     * its can_populate() or has_description() is only called for directory nodes.
+     */
+    N_NODISCARD virtual NaoVector<Signature> signatures() const;
+
     /**
      * \param[in] node The node to check.
      * \return Whether this plugin can populate the node.
@@ -86,10 +142,84 @@ class LIBNAO_API NaoPlugin {
      * \param[in] node The node to populate.
      * \return Whether the operation succeeded.
      *
-     * Populating a node means to fill in it's children and any possible sub-children.
+     * Populating a node means to fill in its children and any possible sub-children.
      */
     virtual bool populate(NTreeNode* node) = 0;
 
+    /**
+     * \brief Receives a batch of new children while a node is being populated.
+     */
+    using PopulateCallback = std::function<void(const NaoVector<NTreeNode*>&)>;
+
+    /**
+     * \brief Populates a node, passing its children on in batches as they're added.
+     * \param[in] node The node to populate.
+     * \param[in] callback Receives every batch, called on the populating thread.
+     * \return Whether the operation succeeded.
+     *
+     * Children are fully constructed when they're passed on, directories may still
+     * receive children of their own afterwards. The default implementation calls
+     * populate() and passes all children on as a single batch.
+     */
+    virtual bool populate_batched(NTreeNode* node, const PopulateCallback& callback);
+
+    /**
+     * \brief Collects children in populate_batched() and passes them on in batches.
+     *
+     * The first batch is small so the first children arrive quickly, every following
+     * batch is twice as large up to a limit, which keeps the per-batch overhead low.
+     * Does nothing without a callback.
+     */
+    class BatchEmitter {
+        public:
+        /**
+         * \brief Construct from the callback passed to populate_batched().
+         * \param[in] callback The callback that receives the batches.
+         */
+        explicit BatchEmitter(const PopulateCallback& callback)
+            : _m_callback(callback)
+            , _m_limit(first_batch) { }
+
+        BatchEmitter(const BatchEmitter&) = delete;
+        BatchEmitter& operator=(const BatchEmitter&) = delete;
+
+        /**
+         * \brief Add a child, passing on the current batch if it's full.
+         * \param[in] child The child that was just added.
+         */
+        void add(NTreeNode* child) {
+            if (!_m_callback) {
+                return;
+            }
+
+            _m_batch.push_back(child);
+
+            if (std::size(_m_batch) >= _m_limit) {
+                flush();
+
+                _m_limit = std::min<size_t>(_m_limit * 2, max_batch);
+            }
+        }
+
+        /**
+         * \brief Pass on any remaining children, call this once populating is done.
+         */
+        void flush() {
+            if (_m_callback && !_m_batch.empty()) {
+                _m_callback(_m_batch);
+                _m_batch.clear();
+            }
+        }
+
+        private:
+        static constexpr size_t first_batch = 64;
+        static constexpr size_t max_batch = 4096;
+
+        const PopulateCallback& _m_callback;
+        NaoVector<NTreeNode*> _m_batch;
+        size_t _m_limit;
+    };
+
     /**
      * \param[in] node The node to check.
      * \return Whether this plugin has a description for `node`.
@@ -102,6 +232,58 @@ class LIBNAO_API NaoPlugin {
      */
     virtual NaoString description(NTreeNode* node);
 
+    /**
+     * \brief The children of a node that changed during a refresh.
+     */
+    struct Changes {
+        /**
+         * \brief New children.
+         */
+        NaoVector<NTreeNode*> added;
+
+        /**
+         * \brief Children that were removed from the node, but not deleted.
+         */
+        NaoVector<NTreeNode*> removed;
+
+        /**
+         * \brief Children whose contents changed.
+         */
+        NaoVector<NTreeNode*> modified;
+
+        /**
+         * \brief IO's that modified children used before, but not deleted.
+         */
+        NaoVector<NaoIO*> replaced;
+    };
+
+    /**
+     * \brief Runs a change to the tree while readers are locked out.
+     */
+    using CommitCallback = std::function<void(const std::function<void()>&)>;
+
+    /**
+     * \brief Updates a populated node with the changes since it was populated or last refreshed.
+     * \param[in] node The node to refresh.
+     * \param[out] changes Receives the children that changed.
+     * \param[in] commit Runs the part of the refresh that changes the node.
+     * \return Whether the node was refreshed, if not it needs to be populated again.
+     *
+     * Only the changed children are touched, the rest keep their IO and cached data.
+     * The node may be read outside of `commit`, but only changed inside it, so slow
+     * work like listing a directory doesn't block readers.
+     * Removed children and replaced IO's are owned by the caller, readers may still use them.
+     */
+    virtual bool refresh(NTreeNode* node, Changes& changes, const CommitCallback& commit);
+
+    /**
+     * \param[in] node The node to retrieve actions for.
+     * \return The actions this plugin offers for `node`, owned by the caller.
+     *
+     * Called for nodes this plugin populates, actions may run on a worker thread.
+     */
+    N_NODISCARD virtual NaoVector<NaoAction*> actions(NTreeNode* node);
+
 #if 0
     enum Event : uint64_t {
         None = 0x0,
@@ -159,18 +341,44 @@ class LIBNAO_API NaoPlugin {
 #endif
 };
 
-#if 0
+/**
+ * \ingroup plugin_interface
+ *
+ * \brief An operation a plugin offers on a node, shown in the context menu.
+ */
 class LIBNAO_API NaoAction {
     public:
-    NaoAction(NaoPlugin* parent);
+    /**
+     * \brief Construct for a plugin.
+     * \param[in] parent The plugin that offers this action.
+     */
+    explicit NaoAction(NaoPlugin* parent);
+
+    /**
+     * \brief Virtual destructor.
+     */
     virtual ~NaoAction() = default;
 
-    N_NODISCARD virtual NaoString ActionName() = 0;
-    virtual bool Execute(NaoObject* object) = 0;
+    /**
+     * \return The name to display for this action.
+     */
+    N_NODISCARD virtual NaoString name() const = 0;
 
+    /**
+     * \brief Performs the action.
+     * \param[in] node The node the action was requested for.
+     * \return Whether the action succeeded.
+     *
+     * The caller locks `node` with NaoFileSystemManager::lock() until this returns,
+     * so it and all of its parents stay valid.
+     */
+    virtual bool execute(NTreeNode* node) = 0;
+
+    /**
+     * \return The plugin that offers this action.
+     */
     N_NODISCARD NaoPlugin* parent() const;
 
     private:
     NaoPlugin* _m_parent;
 };
-#endif
@@ -36,6 +36,9 @@ class LIBNAO_API NTreeNode;
  * (with the LIBNAO_CALL calling convention):
  *
  * - `NaoPlugin NaoPlugin()`;
+ *
+ * A plugin with a manifest (`<name>.naoplugin`, next to the library) is
+ * only loaded once a node matches one of the signatures it lists.
  */
 class NaoPluginManager {
     public:
@@ -60,6 +63,8 @@ class NaoPluginManager {
      * \brief Find the plugin which can populate the given node.
      * \param[in] node The node to check.
      * \return The selected plugin.
+     *
+     * The result is cached on the node, safe to call while holding NaoFileSystemManager::read_lock().
      */
     N_NODISCARD LIBNAO_API NaoPlugin* populate_plugin(NTreeNode* node) const;
 
@@ -70,6 +75,11 @@ class NaoPluginManager {
      */
     N_NODISCARD LIBNAO_API NaoPlugin* description_plugin(NTreeNode* node) const;
 
+    /**
+     * \return The number of header bytes needed to check every registered signature.
+     */
+    N_NODISCARD LIBNAO_API int64_t header_size() const;
+
 #if 0
 	N_NODISCARD LIBNAO_API NaoPlugin* enter_plugin(NaoObject* object) const;
 	N_NODISCARD LIBNAO_API NaoPlugin* leave_plugin(NaoObject* object) const;
@@ -22,6 +22,10 @@
 #include "Containers/NaoVector.h"
 
 #include "Plugin/NaoPlugin.h"
+#include "Plugin/NaoSignatureTable.h"
+
+#include <atomic>
+#include <mutex>
 
 /**
  * \ingroup internal
@@ -57,6 +61,8 @@ class NPMPrivate {
      * \brief Find the plugin which can populate the given node.
      * \param[in] node The node to check for.
      * \return Plugin which can populate the node, else `nullptr`.
+     *
+     * The result is cached on the node, so plugins are only asked once per node.
      */
     N_NODISCARD NaoPlugin* populate_plugin(NTreeNode* node) const;
 
@@ -67,30 +73,136 @@ class NPMPrivate {
      */
     N_NODISCARD NaoPlugin* description_plugin(NTreeNode* node) const;
 
-    private:
     /**
-     * \brief Loads a single plugin.
-     * \param[in] name Name of the plugin to load.
-     * \return Whether the load succeeded.
+     * \return The number of header bytes needed to check every signature.
      */
-    bool _load(const NaoString& name);
+    N_NODISCARD int64_t header_size() const;
 
-#ifdef N_WINDOWS
+    private:
     /**
      * \ingroup internal
      * \relates NPMPrivate
-     * \brief Data struct to hold a plugin and it's Windows HANDLE.
+     * \brief A plugin library, which is only loaded once it's needed if it has a manifest.
      */
     struct Plugin {
-        void* handle;
-        NaoPlugin* plugin;
+        // Path to the shared library
+        NaoString library;
+
+        // Name from the manifest, or the library's file name
+        NaoString name;
+
+        // Native library handle
+        void* handle = nullptr;
 
-        NaoPlugin* operator->() const;
+        // The plugin instance, `nullptr` until loaded
+        std::atomic<NaoPlugin*> plugin { nullptr };
+
+        // Whether loading failed, so it isn't retried on every node
+        bool failed = false;
+
+        // Capabilities to ask the plugin about for nodes no signature matched, even before it's loaded
+        uint32_t generic_capabilities = 0;
+
+        // Whether the plugin was registered from a manifest
+        bool has_manifest = false;
+
+        // Signatures listed in the manifest, compared with the plugin's own once it's loaded
+        NaoVector<NaoPlugin::Signature> manifest_signatures;
     };
-#endif
 
-    // Vector to hold all loaded plugins
-    NaoVector<Plugin> _m_plugins;
+    /**
+     * \brief Registers a plugin library, loading it immediately if it has no manifest.
+     * \param[in] library Path to the shared library.
+     * \return Whether the plugin was registered.
+     */
+    bool _add(const NaoString& library);
+
+    /**
+     * \brief Reads a plugin manifest.
+     * \param[in] path Path to the manifest.
+     * \param[in] plugin The plugin to fill in.
+     * \param[out] signatures The signatures listed in the manifest.
+     * \return Whether the manifest was valid.
+     *
+     * A manifest consists of `key = value` lines, `#` starts a comment:
+     *
+     * - `name = <display name>`
+     * - `signature = <offset> <hex bytes>[/<hex mask>] [populate] [description]`
+     * - `generic = [populate] [description]`, capabilities the plugin must
+     *   be asked about directly for directories and unmatched files.
+     *
+     * The signatures must be the same as NaoPlugin::signatures(), which is
+     * checked when the plugin is loaded.
+     *
+     * Once loaded, a plugin is asked about every directory, since it may have created them.
+     */
+    bool _read_manifest(const NaoString& path, Plugin* plugin,
+        NaoVector<NaoPlugin::Signature>& signatures) const;
+
+    /**
+     * \brief Whether a plugin should be asked directly about a node.
+     * \param[in] plugin The plugin to check.
+     * \param[in] node The node that no signature matched.
+     * \param[in] capability The capability that's needed.
+     * \return Whether to ask the plugin.
+     */
+    N_NODISCARD static bool _is_candidate(const Plugin* plugin, NTreeNode* node, uint32_t capability);
+
+    /**
+     * \brief Loads a plugin's library and creates the plugin instance, if not done yet.
+     * \param[in] plugin The plugin to load.
+     * \return The plugin instance, or `nullptr` if loading failed.
+     */
+    NaoPlugin* _activate(Plugin* plugin) const;
+
+    /**
+     * \brief Warns about signatures that differ between a plugin's manifest and the loaded plugin.
+     * \param[in] plugin The plugin, registered from a manifest.
+     * \param[in] instance The loaded plugin instance.
+     *
+     * Only the manifest is used for dispatch, so a signature missing from it
+     * never loads the plugin, and a stale one loads it for the wrong files.
+     */
+    void _check_manifest(const Plugin* plugin, NaoPlugin* instance) const;
+
+    /**
+     * \brief Adds a plugin's signatures to the dispatch tables.
+     * \param[in] plugin The plugin to register.
+     * \param[in] signatures The signatures to register.
+     * \return The capabilities covered by the valid signatures.
+     */
+    uint32_t _register_signatures(Plugin* plugin, const NaoVector<NaoPlugin::Signature>& signatures);
+
+    /**
+     * \brief Reads the start of a file node, enough to check every signature.
+     * \param[in] node The node to read from.
+     * \return The header, or an empty NaoBytes if there is nothing to read.
+     */
+    N_NODISCARD NaoBytes _header(NTreeNode* node) const;
+
+    /**
+     * \brief Ask every plugin whether it can populate a node.
+     * \param[in] node The node to check for.
+     * \return Plugin which can populate the node, else `nullptr`.
+     */
+    N_NODISCARD NaoPlugin* _find_populate_plugin(NTreeNode* node) const;
+
+    /**
+     * \brief Find the first plugin with a signature matching a header, loading it if needed.
+     * \param[in] header The file header to match against.
+     * \param[in] capability The capability the signature must provide.
+     * \return The plugin, or `nullptr` if no signature matches.
+     */
+    N_NODISCARD NaoPlugin* _match(const NaoBytes& header, uint32_t capability) const;
+
+    // All registered plugins, owned
+    NaoVector<Plugin*> _m_plugins;
+
+    // Serialises loading plugin libraries
+    mutable std::mutex _m_load_mutex;
+
+    // All registered signatures, with the plugin that registered them
+    NaoSignatureTable<Plugin*> _m_signatures;
 
     // Which plugins are subscribed to which events
     //std::map<NaoPlugin::Event, NaoVector<NaoPlugin*>> _m_event_subscribers;
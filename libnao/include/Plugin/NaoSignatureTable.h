@@ -0,0 +1,160 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+/**
+ * \file NaoSignatureTable.h
+ *
+ * \brief Contains the NaoSignatureTable template class.
+ */
+
+#include "libnao.h"
+
+#include "Containers/NaoVector.h"
+
+#include "Plugin/NaoPlugin.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+/**
+ * \ingroup libnao
+ *
+ * \brief Finds the signatures that match a file header.
+ * \tparam T The value stored with every signature.
+ *
+ * Signatures that are an unmasked magic of at least 4 bytes at offset 0 are
+ * looked up by their first 4 bytes, any others are compared one by one with
+ * their mask applied. Used by NaoPluginManager to pick plugins and by
+ * NaoArchiveFormat to detect archives.
+ */
+template <typename T>
+class NaoSignatureTable {
+    public:
+    /**
+     * \brief Adds a signature.
+     * \param[in] signature The signature to add.
+     * \param[in] value The value that's passed to find() when the signature matches.
+     * \return Whether the signature was valid, invalid signatures aren't added.
+     */
+    bool add(const NaoPlugin::Signature& signature, const T& value) {
+        if (std::size(signature.bytes) == 0 || signature.offset < 0
+            || (std::size(signature.mask) != 0 && std::size(signature.mask) != std::size(signature.bytes))) {
+            return false;
+        }
+
+        _m_header_size = std::max<size_t>(_m_header_size,
+            size_t(signature.offset) + std::size(signature.bytes));
+
+        // Only fully unmasked signatures at the start can be keyed
+        bool keyed = signature.offset == 0 && std::size(signature.bytes) >= 4;
+        for (size_t i = 0; keyed && i < 4 && std::size(signature.mask) != 0; ++i) {
+            keyed = uint8_t(signature.mask.const_data()[i]) == 0xFF;
+        }
+
+        if (keyed) {
+            _m_keyed[_key(signature.bytes.const_data())].push_back({ signature, value });
+        } else {
+            _m_slow.push_back({ signature, value });
+        }
+
+        return true;
+    }
+
+    /**
+     * \return The number of header bytes needed to check every signature.
+     */
+    N_NODISCARD size_t header_size() const {
+        return _m_header_size;
+    }
+
+    /**
+     * \brief Calls func for every signature that matches a header, in the order they were added.
+     * \param[in] header The start of the file.
+     * \param[in] size The size of header.
+     * \param[in] func Called with the signature and its value, returns true to stop.
+     * \return Whether func returned true.
+     *
+     * Keyed signatures are tried before all others.
+     */
+    template <typename Func>
+    bool find(const char* header, size_t size, Func&& func) const {
+        if (size >= 4) {
+            auto it = _m_keyed.find(_key(header));
+
+            if (it != std::end(_m_keyed)) {
+                for (const Entry& entry : it->second) {
+                    if (_matches(entry.signature, header, size) && func(entry.signature, entry.value)) {
+                        return true;
+                    }
+                }
+            }
+        }
+
+        for (const Entry& entry : _m_slow) {
+            if (_matches(entry.signature, header, size) && func(entry.signature, entry.value)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    private:
+    // A signature and its value
+    struct Entry {
+        NaoPlugin::Signature signature;
+        T value;
+    };
+
+    static uint32_t _key(const char* data) {
+        uint32_t key;
+        std::copy_n(data, 4, reinterpret_cast<char*>(&key));
+
+        return key;
+    }
+
+    static bool _matches(const NaoPlugin::Signature& signature, const char* header, size_t size) {
+        const size_t length = std::size(signature.bytes);
+
+        if (size < size_t(signature.offset) + length) {
+            return false;
+        }
+
+        const char* data = header + signature.offset;
+
+        for (size_t i = 0; i < length; ++i) {
+            const char mask = std::size(signature.mask) == 0 ? char(0xFF) : signature.mask.const_data()[i];
+
+            if ((data[i] & mask) != (signature.bytes.const_data()[i] & mask)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Signatures at offset 0 with 4 or more unmasked bytes, keyed by their first 4 bytes
+    std::unordered_map<uint32_t, NaoVector<Entry>> _m_keyed;
+
+    // All other signatures, checked one by one
+    NaoVector<Entry> _m_slow;
+
+    // Number of header bytes needed to check all signatures
+    size_t _m_header_size = 0;
+};
@@ -0,0 +1,59 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "libnao.h"
+
+#include "Containers/NaoString.h"
+#include "Containers/NaoVector.h"
+#include "Decoding/Archives/NaoArchiveIndexCache.h"
+
+#include <functional>
+
+class NaoIO;
+class NTreeNode;
+
+/*
+ * Extraction shared by the archive plugins. A plugin only picks the entries
+ * of its archive's index to extract and where they go, these functions ask
+ * for the target, read the archive and run the entries through
+ * NaoExtractionPipeline with a progress dialog.
+ */
+namespace ArchiveUtils {
+    // An entry from an archive's index and the file it's extracted to
+    struct File {
+        NaoArchiveIndexCache::Entry entry;
+        NaoString target;
+    };
+
+    // Opens the plugin's reader on io and adds the files to extract, offsets are relative to io.
+    // Returns false to extract nothing, may throw NaoDecodingException.
+    using Select = std::function<bool(NaoIO* io, NaoVector<File>& files)>;
+
+    // Closest directory containing node that exists on disk, to start file dialogs in
+    LIBNAO_API NaoString existing_dir(NTreeNode* node);
+
+    // Asks for a folder next to node and returns the directory called name in it,
+    // or an empty string if the user cancelled or doesn't want to overwrite it
+    LIBNAO_API NaoString ask_target_dir(NTreeNode* node, const NaoString& name);
+
+    // Extracts the files select picks from archive, which is read through its own file if it's on disk and
+    // through the tree otherwise. Entries with different stored and real sizes are decompressed. When
+    // recursive, files that are archives themselves are replaced by a directory holding their contents.
+    LIBNAO_API bool extract(NTreeNode* archive, const Select& select, bool recursive = false);
+}
@@ -46,16 +46,26 @@
 
 #include <cstdint>
 
-#ifndef _WIN64
-#   error "Windows x64 only for now, sorry!"
-#else
+#if defined(_WIN64)
 /**
  * \brief Indicates we're running on a Windows platform
  */
 #   define N_WINDOWS
+#elif defined(__unix__) || defined(__APPLE__)
+/**
+ * \brief Indicates we're running on a POSIX platform
+ */
+#   define N_POSIX
+#else
+#   error "Windows x64 or POSIX only for now, sorry!"
 #endif
 
-#ifdef LIBNAO_EXPORTS
+#ifndef N_WINDOWS
+/**
+ * \brief Makes a symbol visible outside of the shared library.
+ */
+#   define LIBNAO_API __attribute__((visibility("default")))
+#elif defined(LIBNAO_EXPORTS)
 /**
  * \brief Marks code as `dllexport`
  */
@@ -101,20 +111,39 @@
  */
 #define LIBNAO_VERSION_MINOR 1
 
+#ifdef N_WINDOWS
+/**
+ * \brief Defines the standard calling convention.
+ */
+#   define LIBNAO_CALL __cdecl
+#else
 /**
  * \brief Defines the standard calling convention.
  */
-#define LIBNAO_CALL __cdecl
+#   define LIBNAO_CALL
+#endif
 
 /**
  * \brief Used for the GetNaoPlugin() function in plugins so libnao can find it.
  */
 #define LIBNAO_PLUGIN_CALL extern "C"
 
+#ifdef N_WINDOWS
+/**
+ * \brief A plugin's calling convention.
+ */
+#   define LIBNAO_PLUGIN_DECL __declspec(dllexport)
+#else
 /**
  * \brief A plugin's calling convention.
  */
-#define LIBNAO_PLUGIN_DECL __declspec(dllexport)
+#   define LIBNAO_PLUGIN_DECL __attribute__((visibility("default")))
+#endif
+
+/**
+ * \brief Extension of the manifest which lets a plugin be loaded lazily.
+ */
+#define LIBNAO_PLUGIN_MANIFEST_EXTENSION ".naoplugin"
 
 /**
  * \brief Marks a local as possibly unused.
@@ -329,6 +329,21 @@ void NaoString::reserve(size_t size) {
     _reallocate_to(size);
 }
 
+void NaoString::resize(size_t size, char fill) {
+    // Leave space for the null terminator
+    _reallocate_to(size + 1);
+
+    if (size > _m_size) {
+        std::fill(_m_end, _m_data + size, fill);
+    } else {
+        std::fill(_m_data + size, _m_end, '\0');
+    }
+
+    _m_end = _m_data + size;
+    *_m_end = '\0';
+    _m_size = size;
+}
+
 size_t NaoString::capacity() const {
     return _m_allocated;
 }
@@ -568,12 +583,9 @@ size_t NaoString::replace(char target, char replace) {
     return count;
 }
 
-NaoVector<NaoString> NaoString::split(char delim) const {
-    // Fixed size
-    NaoVector<NaoString> parts(count(delim) + 1);
-
-    char const* str = _m_data;
-
+// Shared by split() and split_small(), parts must hold 1 more element than there are delimiters
+template <typename Container>
+static void split_into(const char* str, char delim, Container& parts) {
     size_t i = 0;
 
     while (*str) {
@@ -589,6 +601,21 @@ NaoVector<NaoString> NaoString::split(char delim) const {
         // Move forward one character
         ++str;
     }
+}
+
+NaoVector<NaoString> NaoString::split(char delim) const {
+    // Fixed size
+    NaoVector<NaoString> parts(count(delim) + 1);
+
+    split_into(_m_data, delim, parts);
+
+    return parts;
+}
+
+NaoSmallVector<NaoString, 8> NaoString::split_small(char delim) const {
+    NaoSmallVector<NaoString, 8> parts(count(delim) + 1);
+
+    split_into(_m_data, delim, parts);
 
     return parts;
 }
@@ -0,0 +1,177 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Decoding/Archives/NaoArchiveFormat.h"
+
+#define N_LOG_ID "NaoArchiveFormat"
+#include "Logging/NaoLogging.h"
+#include "IO/NaoChunkIO.h"
+#include "IO/NaoMemoryIO.h"
+#include "Decoding/NaoDecodingException.h"
+#include "Decoding/Archives/NaoCPKReader.h"
+#include "Decoding/Archives/NaoDATReader.h"
+#include "Decoding/Compression/NaoCRILAYLA.h"
+#include "Plugin/NaoSignatureTable.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Every format that can be detected
+static constexpr NaoArchiveFormat::Format formats[] { NaoArchiveFormat::CPK, NaoArchiveFormat::DAT };
+
+// Built on first use from signatures()
+static const NaoSignatureTable<NaoArchiveFormat::Format>& archive_signatures() {
+    static const NaoSignatureTable<NaoArchiveFormat::Format> table = [] {
+        NaoSignatureTable<NaoArchiveFormat::Format> result;
+
+        for (NaoArchiveFormat::Format format : formats) {
+            for (const NaoPlugin::Signature& signature : NaoArchiveFormat::signatures(format)) {
+                result.add(signature, format);
+            }
+        }
+
+        return result;
+    }();
+
+    return table;
+}
+
+NaoVector<NaoPlugin::Signature> NaoArchiveFormat::signatures(Format format) {
+    switch (format) {
+        case CPK:
+            return { { 0, NaoBytes("CPK ", 4), NaoBytes(), 0 } };
+
+        case DAT:
+            return { { 0, NaoBytes("DAT\0", 4), NaoBytes(), 0 } };
+
+        default:
+            break;
+    }
+
+    return { };
+}
+
+size_t NaoArchiveFormat::header_size() {
+    return archive_signatures().header_size();
+}
+
+NaoArchiveFormat::Format NaoArchiveFormat::detect(const char* header, size_t size) {
+    Format result = Unknown;
+
+    archive_signatures().find(header, size, [&result](const NaoPlugin::Signature&, Format format) {
+        result = format;
+        return true;
+    });
+
+    return result;
+}
+
+NaoArchiveFormat::Format NaoArchiveFormat::detect(NaoIO* io, int64_t offset, int64_t size) {
+    if (size < 0) {
+        size = std::max<int64_t>(io->size() - offset, 0);
+    }
+
+    // Room for a CRILAYLA preamble as well
+    const int64_t wanted = std::min<int64_t>(std::max<int64_t>(int64_t(header_size()), 16), size);
+
+    NaoBytes header('\0', size_t(wanted));
+
+    const int64_t read = io->read_at(offset, header.data(), wanted);
+    if (read <= 0) {
+        return Unknown;
+    }
+
+    if (read >= 16 && NaoCRILAYLA::is_compressed(header.const_data(), size_t(read))) {
+        // The start of the decompressed data is stored as-is after the compressed data
+        uint32_t header_offset;
+        std::memcpy(&header_offset, header.const_data() + 12, 4);
+
+        const int64_t stored = 16 + int64_t(header_offset);
+        const int64_t stored_size = std::min<int64_t>(int64_t(header_size()), size - stored);
+
+        if (stored_size <= 0) {
+            return Unknown;
+        }
+
+        const int64_t stored_read = io->read_at(offset + stored, header.data(), stored_size);
+
+        return (stored_read > 0) ? detect(header.const_data(), size_t(stored_read)) : Unknown;
+    }
+
+    return detect(header.const_data(), size_t(read));
+}
+
+NaoVector<NaoArchiveIndexCache::Entry> NaoArchiveFormat::index(NaoIO* io, Format format) {
+    switch (format) {
+        case CPK:
+            return NaoCPKReader(io).entries();
+
+        case DAT:
+            return NaoDATReader(io).entries();
+
+        default:
+            break;
+    }
+
+    nerr << "Unsupported archive";
+    throw NaoDecodingException("Unsupported archive");
+}
+
+NaoIO* NaoArchiveFormat::open(NaoIO* io, int64_t offset, int64_t size) {
+    if (size < 0) {
+        size = std::max<int64_t>(io->size() - offset, 0);
+    }
+
+    if (detect(io, offset, size) == Unknown) {
+        return nullptr;
+    }
+
+    char header[16];
+    const bool compressed = io->read_at(offset, header, 16) == 16 && NaoCRILAYLA::is_compressed(header, 16);
+
+    NaoIO* archive = nullptr;
+
+    if (!compressed) {
+        // Chunks are translated to io's root, so reads go there directly
+        archive = new NaoChunkIO(io, { offset, size, 0 });
+    } else {
+        NaoBytes data('\0', size_t(size));
+
+        if (io->read_at(offset, data.data(), size) != size) {
+            nerr << "Failed reading compressed archive";
+            throw NaoDecodingException("Failed reading compressed archive");
+        }
+
+        archive = new NaoMemoryIO(NaoCRILAYLA::decompress(data));
+    }
+
+    if (!archive->open(NaoIO::ReadOnly)) {
+        delete archive;
+
+        nerr << "Failed opening archive";
+        throw NaoDecodingException("Failed opening archive");
+    }
+
+    return archive;
+}
+
+NaoString NaoArchiveFormat::expanded_path(const NaoString& path) {
+    fs::path dir = fs::path(path);
+    dir.replace_filename(NaoString(dir.filename()).clean_dir_name());
+
+    return dir;
+}
@@ -0,0 +1,400 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Decoding/Archives/NaoArchiveIndexCache.h"
+
+#define N_LOG_ID "NaoArchiveIndexCache"
+#include "Logging/NaoLogging.h"
+#include "Filesystem/Filesystem.h"
+#include "Functionality/NaoHash.h"
+#include "IO/NaoFileIO.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#ifdef N_WINDOWS
+#   include <process.h>
+#else
+#   include <unistd.h>
+#endif
+
+// Bump whenever the layout below changes
+static constexpr uint32_t index_version = 1;
+
+// Number of bytes at the start of the archive that are hashed
+static constexpr int64_t header_hash_size = 4096;
+
+// Least recently used indices are removed once all of them together grow larger than this
+static constexpr uintmax_t max_cache_size = 64 * 1024 * 1024;
+
+// Indices that weren't used for this long are removed regardless of size
+static constexpr std::chrono::hours max_index_age = std::chrono::hours(24 * 30);
+
+// Temporary files older than this were left behind by a writer that didn't finish
+static constexpr std::chrono::hours max_temp_age = std::chrono::hours(1);
+
+struct NaoArchiveIndexCache::Key {
+    char magic[4];
+    uint32_t version;
+    uint32_t fourcc;
+    uint32_t header_crc;
+    int64_t size;
+    int64_t mtime;
+    uint32_t path_size;
+    uint32_t entry_count;
+    uint32_t names_size;
+    uint32_t reserved;
+};
+
+// Fixed-size part of every entry, names are stored after all records
+struct IndexRecord {
+    int64_t offset;
+    int64_t binary_size;
+    int64_t real_size;
+    uint32_t name_offset;
+    uint32_t name_size;
+    uint32_t is_dir;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(IndexRecord) == 40, "IndexRecord must be tightly packed");
+
+bool NaoArchiveIndexCache::load(NaoIO* io, uint32_t fourcc, NaoVector<Entry>& entries) {
+    Key key;
+    if (!_make_key(io, fourcc, key)) {
+        return false;
+    }
+
+    const NaoString& archive = static_cast<NaoFileIO*>(io)->path();
+    const NaoString cache_path = _cache_path(archive);
+
+    std::error_code ec;
+    if (!fs::exists(cache_path.c_str(), ec)) {
+        return false;
+    }
+
+    NaoFileIO cache(cache_path);
+    if (!cache.open()) {
+        nwarn << "Failed to open index" << cache_path;
+        return false;
+    }
+
+    // Everything is parsed from this single read
+    const NaoBytes data = cache.read_all();
+    cache.close();
+
+    if (std::size(data) < sizeof(Key)) {
+        return false;
+    }
+
+    const char* ptr = data.const_data();
+    const char* const end = ptr + std::size(data);
+
+    Key stored;
+    std::copy_n(ptr, sizeof(Key), reinterpret_cast<char*>(&stored));
+    ptr += sizeof(Key);
+
+    if (!std::equal(std::begin(stored.magic), std::end(stored.magic), std::begin(key.magic))
+        || stored.version != key.version
+        || stored.fourcc != key.fourcc
+        || stored.header_crc != key.header_crc
+        || stored.size != key.size
+        || stored.mtime != key.mtime
+        || stored.path_size != key.path_size) {
+        ndebug << "Stale index for" << archive;
+        return false;
+    }
+
+    // Marks the index as recently used, so it's the last to be pruned
+    fs::last_write_time(cache_path.c_str(), fs::file_time_type::clock::now(), ec);
+
+    const size_t records_size = size_t(stored.entry_count) * sizeof(IndexRecord);
+
+    if (size_t(end - ptr) != stored.path_size + records_size + stored.names_size) {
+        nwarn << "Index for" << archive << "has invalid size";
+        return false;
+    }
+
+    // Different paths can hash to the same cache file
+    if (!std::equal(ptr, ptr + stored.path_size, archive.c_str())) {
+        return false;
+    }
+
+    ptr += stored.path_size;
+
+    const char* names = ptr + records_size;
+
+    entries.clear();
+    entries.reserve(stored.entry_count);
+
+    for (uint32_t i = 0; i < stored.entry_count; ++i) {
+        IndexRecord record;
+        std::copy_n(ptr, sizeof(IndexRecord), reinterpret_cast<char*>(&record));
+        ptr += sizeof(IndexRecord);
+
+        if (size_t(record.name_offset) + record.name_size > stored.names_size) {
+            nwarn << "Index for" << archive << "has invalid name offset";
+            entries.clear();
+            return false;
+        }
+
+        entries.push_back({
+            std::string(names + record.name_offset, record.name_size),
+            record.offset,
+            record.binary_size,
+            record.real_size,
+            record.is_dir != 0
+            });
+    }
+
+    return true;
+}
+
+bool NaoArchiveIndexCache::store(NaoIO* io, uint32_t fourcc, const NaoVector<Entry>& entries) {
+    Key key;
+    if (!_make_key(io, fourcc, key)) {
+        return false;
+    }
+
+    const NaoString& archive = static_cast<NaoFileIO*>(io)->path();
+
+    std::error_code ec;
+    fs::create_directories(cache_dir().c_str(), ec);
+    if (ec) {
+        nwarn << "Failed to create index directory" << cache_dir();
+        return false;
+    }
+
+    key.entry_count = uint32_t(std::size(entries));
+    key.names_size = 0;
+
+    for (const Entry& entry : entries) {
+        key.names_size += uint32_t(std::size(entry.name));
+    }
+
+    // Assemble the whole file in memory so it's written at once
+    NaoVector<char> data(sizeof(Key) + key.path_size
+        + std::size(entries) * sizeof(IndexRecord) + key.names_size);
+
+    char* ptr = data.data();
+    ptr = std::copy_n(reinterpret_cast<const char*>(&key), sizeof(Key), ptr);
+    ptr = std::copy_n(archive.c_str(), key.path_size, ptr);
+
+    char* names = ptr + std::size(entries) * sizeof(IndexRecord);
+
+    uint32_t name_offset = 0;
+    for (const Entry& entry : entries) {
+        const IndexRecord record {
+            entry.offset,
+            entry.binary_size,
+            entry.real_size,
+            name_offset,
+            uint32_t(std::size(entry.name)),
+            entry.is_dir ? 1u : 0u,
+            0
+        };
+
+        ptr = std::copy_n(reinterpret_cast<const char*>(&record), sizeof(IndexRecord), ptr);
+        std::copy_n(entry.name.c_str(), std::size(entry.name), names + name_offset);
+
+        name_offset += record.name_size;
+    }
+
+    // Write to a temporary file first so a crash never leaves a half-written index.
+    // Every writer gets its own, concurrent writers of the same index each replace it in turn.
+    const NaoString cache_path = _cache_path(archive);
+    const NaoString temp_path = cache_path + _temp_suffix();
+
+    {
+        NaoFileIO cache(temp_path);
+        if (!cache.open(NaoIO::WriteOnly)) {
+            nwarn << "Failed to open" << temp_path << "for writing";
+            return false;
+        }
+
+        if (cache.write(data.data(), std::size(data)) != int64_t(std::size(data))) {
+            nwarn << "Failed to write index" << temp_path;
+            cache.close();
+            fs::remove(temp_path.c_str(), ec);
+            return false;
+        }
+
+        cache.close();
+    }
+
+    fs::rename(temp_path.c_str(), cache_path.c_str(), ec);
+    if (ec) {
+        nwarn << "Failed to replace index" << cache_path;
+        fs::remove(temp_path.c_str(), ec);
+        return false;
+    }
+
+    _prune();
+
+    return true;
+}
+
+NaoString NaoArchiveIndexCache::cache_dir() {
+    std::error_code ec;
+    fs::path dir = fs::temp_directory_path(ec);
+
+    return NaoString(dir / "libnao" / "index");
+}
+
+bool NaoArchiveIndexCache::_make_key(NaoIO* io, uint32_t fourcc, Key& key) {
+    // Nested archives have no path or modification time of their own
+    NaoFileIO* file = dynamic_cast<NaoFileIO*>(io);
+    if (!file) {
+        return false;
+    }
+
+    std::error_code ec;
+    const auto mtime = fs::last_write_time(file->path().c_str(), ec);
+    if (ec) {
+        return false;
+    }
+
+    const int64_t pos = io->pos();
+    if (!io->seek(0)) {
+        return false;
+    }
+
+    const NaoBytes header = io->read(size_t(std::min<int64_t>(io->size(), header_hash_size)));
+    io->seek(pos);
+
+    key = {
+        { 'N', 'I', 'D', 'X' },
+        index_version,
+        fourcc,
+        NaoHash::crc32(header.const_data(), std::size(header)),
+        io->size(),
+        int64_t(mtime.time_since_epoch().count()),
+        uint32_t(std::size(file->path())),
+        0,
+        0,
+        0
+    };
+
+    return true;
+}
+
+NaoString NaoArchiveIndexCache::_cache_path(const NaoString& archive) {
+    // Paths are case-insensitive on Windows
+    NaoString lower = archive;
+    for (char& c : lower) {
+        c = NaoHash::to_lower(c);
+    }
+
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(
+        NaoHash::fnv1a(lower.c_str(), std::size(lower))));
+
+    return cache_dir() + N_PATHSEP + name + ".nidx";
+}
+
+NaoString NaoArchiveIndexCache::_temp_suffix() {
+#ifdef N_WINDOWS
+    const unsigned long long pid = _getpid();
+#else
+    const unsigned long long pid = getpid();
+#endif
+
+    const unsigned long long thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+    char suffix[48];
+    snprintf(suffix, sizeof(suffix), ".%llx-%llx.tmp", pid, thread);
+
+    return suffix;
+}
+
+void NaoArchiveIndexCache::_prune() {
+    struct CacheFile {
+        fs::path path;
+        uintmax_t size;
+        fs::file_time_type time;
+    };
+
+    const auto now = fs::file_time_type::clock::now();
+
+    std::vector<CacheFile> files;
+    uintmax_t total = 0;
+
+    std::error_code ec;
+    for (fs::directory_iterator it(cache_dir().c_str(), ec), end; !ec && it != end; it.increment(ec)) {
+        const fs::path& path = it->path();
+        const fs::file_time_type time = it->last_write_time(ec);
+
+        if (ec) {
+            ec.clear();
+            continue;
+        }
+
+        if (path.extension() == ".tmp") {
+            if (now - time > max_temp_age) {
+                fs::remove(path, ec);
+                ec.clear();
+            }
+
+            continue;
+        }
+
+        if (path.extension() != ".nidx") {
+            continue;
+        }
+
+        const uintmax_t size = it->file_size(ec);
+
+        if (ec) {
+            ec.clear();
+            continue;
+        }
+
+        if (now - time > max_index_age) {
+            fs::remove(path, ec);
+            ec.clear();
+            continue;
+        }
+
+        files.push_back({ path, size, time });
+        total += size;
+    }
+
+    if (total <= max_cache_size) {
+        return;
+    }
+
+    // Oldest first, loading an index updates its time
+    std::sort(std::begin(files), std::end(files), [](const CacheFile& lhs, const CacheFile& rhs) {
+        return lhs.time < rhs.time;
+    });
+
+    for (const CacheFile& file : files) {
+        if (total <= max_cache_size) {
+            break;
+        }
+
+        if (fs::remove(file.path, ec)) {
+            total -= file.size;
+        }
+
+        ec.clear();
+    }
+
+    ndebug << "Pruned index cache to" << NaoString::bytes(uint64_t(total));
+}
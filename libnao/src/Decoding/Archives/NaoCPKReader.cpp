@@ -24,8 +24,17 @@
 #include "Containers/NaoBytes.h"
 #include "IO/NaoChunkIO.h"
 
+// "CPK " as read in little-endian
+static constexpr uint32_t cpk_fourcc = 0x204B5043;
+
+struct NaoCPKReader::NCREntriesWrapper {
+    NaoVector<NaoArchiveIndexCache::Entry> m_entries;
+};
+
 NaoCPKReader::NaoCPKReader(NaoIO* io)
-    : _m_io(io) {
+    : _m_io(io)
+    , _m_entries(new NCREntriesWrapper())
+    , _m_files_created(false) {
     if (!io->is_open() && !io->open() && !io->is_open()) {
         nerr << "IO not open";
         throw NaoDecodingException("IO not open");
@@ -42,17 +51,79 @@ NaoCPKReader::~NaoCPKReader() {
     for (NaoObject* object : _m_files) {
         delete object;
     }
+
+    delete _m_entries;
+}
+
+const NaoVector<NaoArchiveIndexCache::Entry>& NaoCPKReader::entries() const {
+    return _m_entries->m_entries;
+}
+
+NaoIO* NaoCPKReader::io() const {
+    return _m_io;
+}
+
+NaoIO* NaoCPKReader::open_entry(size_t index) const {
+    const NaoArchiveIndexCache::Entry& entry = _m_entries->m_entries.at(index);
+
+    if (entry.is_dir) {
+        nerr << "Can't open directory" << entry.name;
+        return nullptr;
+    }
+
+    return new NaoChunkIO(_m_io, { entry.offset, entry.binary_size, 0 });
 }
 
 const NaoVector<NaoObject*>& NaoCPKReader::files() const {
+    _create_files();
+
     return _m_files;
 }
 
 NaoVector<NaoObject*> NaoCPKReader::take_files() {
+    _create_files();
+
     return std::move(_m_files);
 }
 
 void NaoCPKReader::_read_archive() {
+    NaoVector<NaoArchiveIndexCache::Entry>& entries = _m_entries->m_entries;
+
+    if (!NaoArchiveIndexCache::load(_m_io, cpk_fourcc, entries)) {
+        _parse_archive(entries);
+
+        NaoArchiveIndexCache::store(_m_io, cpk_fourcc, entries);
+    }
+}
+
+void NaoCPKReader::_create_files() const {
+    if (_m_files_created) {
+        return;
+    }
+
+    _m_files_created = true;
+
+    const NaoVector<NaoArchiveIndexCache::Entry>& entries = _m_entries->m_entries;
+
+    _m_files.reserve(std::size(entries));
+    for (const NaoArchiveIndexCache::Entry& entry : entries) {
+        if (entry.is_dir) {
+            _m_files.push_back(new NaoObject(NaoObject::Dir{ entry.name }));
+        } else {
+            _m_files.push_back(new NaoObject(NaoObject::File{
+                new NaoChunkIO(_m_io, { entry.offset, entry.binary_size, 0 }),
+                entry.binary_size,
+                entry.real_size,
+                entry.binary_size != entry.real_size,
+                entry.name
+                }));
+        }
+    }
+
+    _resolve_structure();
+}
+
+void NaoCPKReader::_parse_archive(NaoVector<NaoArchiveIndexCache::Entry>& entries) {
     _m_io->seek(16);
 
     NaoUTFReader cpk(_m_io);
@@ -73,41 +144,32 @@ void NaoCPKReader::_read_archive() {
 
         NaoVector<NaoString> dirs;
 
-        _m_files.reserve(files.row_count());
+        entries.reserve(files.row_count());
         for (uint32_t i = 0; i < files.row_count(); ++i) {
-            NaoObject::File file{
-                nullptr,
+            NaoArchiveIndexCache::Entry file{
+                NaoString(),
+                files.get_data(i, "FileOffset").as_int64() + extra_offset,
                 files.get_data(i, "FileSize").as_int64(),
                 files.get_data(i, "ExtractSize").as_int64(),
-                false,
-                NaoString()
+                false
             };
 
-            file.io = new NaoChunkIO(_m_io, {
-                    files.get_data(i, "FileOffset").as_int64() + extra_offset,
-                    file.binary_size,
-                    0
-                });
-            file.compressed = file.binary_size != file.real_size;
-
             NaoString dir = files.get_data(i, "DirName").as_string();
             file.name = (std::empty(dir) ? NaoString() : dir + '/') + files.get_data(i, "FileName").as_string();
             file.name.replace('/', N_PATHSEP);
 
-            _m_files.push_back(new NaoObject(file));
+            entries.push_back(file);
 
             if (!std::empty(dir) && !dirs.contains(dir)) {
                 dirs.push_back(dir);
                 dir.replace('/', N_PATHSEP);
-                _m_files.push_back(new NaoObject(NaoObject::Dir{ dir }));
+                entries.push_back({ dir, 0, 0, 0, true });
             }
         }
     }
-
-    _resolve_structure();
 }
 
-void NaoCPKReader::_resolve_structure() {
+void NaoCPKReader::_resolve_structure() const {
 #if 0
     NaoVector<NaoObject*> dirs;
     std::copy_if(std::begin(_m_files), std::end(_m_files),
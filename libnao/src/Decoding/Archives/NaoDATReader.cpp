@@ -20,11 +20,46 @@
 #define N_LOG_ID "NaoDATReader"
 #include "Logging/NaoLogging.h"
 #include "Decoding/NaoDecodingException.h"
+#include "Functionality/NaoHash.h"
 #include "IO/NaoChunkIO.h"
 #include "NaoObject.h"
 
+// "DAT\0" as read in little-endian
+static constexpr uint32_t dat_fourcc = 0x00544144;
+
+struct NaoDATReader::NDRIndex {
+    // Bucket of a hash is hash >> shift
+    uint32_t shift = 31;
+
+    // Index into hashes of the first entry in each bucket, or -1 if empty
+    NaoVector<int32_t> buckets;
+
+    // Name hashes, grouped by bucket
+    NaoVector<uint32_t> hashes;
+
+    // File index belonging to each hash
+    NaoVector<uint32_t> indices;
+
+    // Names and extensions by file index
+    NaoVector<NaoString> names;
+    NaoVector<NaoString> extensions;
+
+    // Every distinct extension and the files that have it
+    struct ExtensionGroup {
+        NaoString extension;
+        NaoVector<uint32_t> indices;
+    };
+
+    NaoVector<ExtensionGroup> by_extension;
+
+    // The complete index
+    NaoVector<NaoArchiveIndexCache::Entry> entries;
+};
+
 NaoDATReader::NaoDATReader(NaoIO* io)
-    : _m_io(io) {
+    : _m_io(io)
+    , _m_files_created(false)
+    , _m_index(new NDRIndex()) {
     if (!io->is_open() && !io->open() && !io->is_open()) {
         nerr << "IO not open";
         throw NaoDecodingException("IO not open");
@@ -41,24 +76,180 @@ NaoDATReader::~NaoDATReader() {
     for (NaoObject* object : _m_files) {
         delete object;
     }
+
+    delete _m_index;
+}
+
+const NaoVector<NaoArchiveIndexCache::Entry>& NaoDATReader::entries() const {
+    return _m_index->entries;
+}
+
+NaoIO* NaoDATReader::io() const {
+    return _m_io;
+}
+
+NaoIO* NaoDATReader::open_entry(size_t index) const {
+    const NaoArchiveIndexCache::Entry& entry = _m_index->entries.at(index);
+
+    return new NaoChunkIO(_m_io, { entry.offset, entry.binary_size, 0 });
 }
 
 const NaoVector<NaoObject*>& NaoDATReader::files() const {
+    _create_files();
+
     return _m_files;
 }
 
 NaoVector<NaoObject*> NaoDATReader::take_files() {
+    _create_files();
+
     return std::move(_m_files);
 }
 
+size_t NaoDATReader::file_count() const {
+    return std::size(_m_index->names);
+}
+
+int64_t NaoDATReader::index_of(const NaoString& name) const {
+    if (std::empty(_m_index->hashes)) {
+        return -1;
+    }
+
+    const uint32_t hash = NaoHash::crc32_lower(name.data(), std::size(name)) & 0x7FFFFFFF;
+    const uint32_t bucket = hash >> _m_index->shift;
+
+    if (bucket >= std::size(_m_index->buckets) || _m_index->buckets[bucket] < 0) {
+        return -1;
+    }
+
+    // Walk this bucket only
+    for (size_t i = _m_index->buckets[bucket];
+        i < std::size(_m_index->hashes) && (_m_index->hashes[i] >> _m_index->shift) == bucket; ++i) {
+        if (_m_index->hashes[i] != hash) {
+            continue;
+        }
+
+        const uint32_t index = _m_index->indices[i];
+        const NaoString& candidate = _m_index->names[index];
+
+        // Hash is case-insensitive, so is the comparison
+        if (std::size(candidate) == std::size(name)
+            && std::equal(std::begin(candidate), std::end(candidate), std::begin(name),
+                [](char a, char b) { return NaoHash::to_lower(a) == NaoHash::to_lower(b); })) {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+NaoObject* NaoDATReader::find(const NaoString& name) const {
+    const int64_t index = index_of(name);
+
+    _create_files();
+
+    if (index < 0 || size_t(index) >= std::size(_m_files)) {
+        return nullptr;
+    }
+
+    return _m_files[index];
+}
+
+const NaoString& NaoDATReader::extension(size_t index) const {
+    return _m_index->extensions.at(index);
+}
+
+NaoVector<NaoString> NaoDATReader::extensions() const {
+    NaoVector<NaoString> result;
+    result.reserve(std::size(_m_index->by_extension));
+
+    for (const NDRIndex::ExtensionGroup& group : _m_index->by_extension) {
+        result.push_back(group.extension);
+    }
+
+    return result;
+}
+
+NaoVector<uint32_t> NaoDATReader::indices_with_extension(const NaoString& ext) const {
+    NaoString target = ext.starts_with('.') ? ext.substr(1) : ext;
+
+    for (char& c : target) {
+        c = NaoHash::to_lower(c);
+    }
+
+    for (const NDRIndex::ExtensionGroup& group : _m_index->by_extension) {
+        if (group.extension == target) {
+            return group.indices;
+        }
+    }
+
+    return { };
+}
+
+NaoVector<NaoObject*> NaoDATReader::files_with_extension(const NaoString& ext) const {
+    NaoVector<NaoObject*> result;
+
+    _create_files();
+
+    // Files were taken
+    if (std::empty(_m_files)) {
+        return result;
+    }
+
+    const NaoVector<uint32_t> indices = indices_with_extension(ext);
+    result.reserve(std::size(indices));
+
+    for (uint32_t index : indices) {
+        result.push_back(_m_files[index]);
+    }
+
+    return result;
+}
+
 void NaoDATReader::_read_archive() {
-    
-    struct FileEntry {
-        NaoString name;
-        uint32_t size;
-        uint32_t offset;
-    };
-    
+    NaoVector<NaoArchiveIndexCache::Entry>& entries = _m_index->entries;
+
+    if (NaoArchiveIndexCache::load(_m_io, dat_fourcc, entries)) {
+        // Extensions and the hash table are derived from the names
+        _m_index->names.reserve(std::size(entries));
+
+        for (const NaoArchiveIndexCache::Entry& entry : entries) {
+            _m_index->names.push_back(entry.name);
+        }
+
+        _derive_extensions();
+        _build_hash_table();
+    } else {
+        _parse_archive(entries);
+
+        NaoArchiveIndexCache::store(_m_io, dat_fourcc, entries);
+    }
+
+    _build_extension_index();
+}
+
+void NaoDATReader::_create_files() const {
+    if (_m_files_created) {
+        return;
+    }
+
+    _m_files_created = true;
+
+    _m_files.reserve(std::size(_m_index->entries));
+
+    for (const NaoArchiveIndexCache::Entry& entry : _m_index->entries) {
+        _m_files.push_back(new NaoObject({
+            new NaoChunkIO(_m_io,
+            { entry.offset, entry.binary_size, 0 }),
+            entry.binary_size,
+            entry.real_size,
+            false,
+            entry.name
+            }));
+    }
+}
+
+void NaoDATReader::_parse_archive(NaoVector<NaoArchiveIndexCache::Entry>& entries) {
     if (!_m_io->seek(4)) {
         nerr << "Failed to skip fourcc";
         throw NaoDecodingException("Failed to skip fourcc");
@@ -66,26 +257,28 @@ void NaoDATReader::_read_archive() {
 
     uint32_t file_count = _m_io->read_uint();
 
-    NaoVector<FileEntry> files(file_count);
-
     uint32_t file_table_offset = _m_io->read_uint();
-
-    if (!_m_io->seekc(4)) {
-        nerr << "Failed to skip extension table offset";
-        throw NaoDecodingException("Failed to skip extension table offset");
-    }
-
+    uint32_t extension_table_offset = _m_io->read_uint();
     uint32_t name_table_offset = _m_io->read_uint();
     uint32_t size_table_offset = _m_io->read_uint();
+    uint32_t hash_table_offset = _m_io->read_uint();
 
-    if (!_m_io->seek(file_table_offset)) {
-        nerr << "Failed seeking to file table at offset" << file_table_offset;
-        throw NaoDecodingException("Failed seeking to file table");
-    }
+    // Read a whole table of 32-bit little-endian values at once
+    auto read_uint_table = [this, file_count](uint32_t offset, const char* name) {
+        if (!_m_io->seek(offset)) {
+            nerr << "Failed seeking to" << name << "table at offset" << offset;
+            throw NaoDecodingException("Failed seeking to table");
+        }
 
-    for (uint32_t i = 0; i < file_count; ++i) {
-        files[i].offset = _m_io->read_uint();
-    }
+        NaoBytes table = _m_io->read(size_t(file_count) * 4);
+
+        NaoVector<uint32_t> values(file_count);
+        std::copy_n(table.const_data(), std::size(table), reinterpret_cast<char*>(values.data()));
+
+        return values;
+    };
+
+    NaoVector<uint32_t> offsets = read_uint_table(file_table_offset, "file");
 
     if (!_m_io->seek(name_table_offset)) {
         nerr << "Failed seeking to name table at offset" << name_table_offset;
@@ -94,29 +287,179 @@ void NaoDATReader::_read_archive() {
 
     uint32_t alignment = _m_io->read_uint();
 
+    NaoBytes name_table = _m_io->read(size_t(file_count) * alignment);
+
+    NaoVector<uint32_t> sizes = read_uint_table(size_table_offset, "size");
+
+    // Null terminator for names that fill their whole slot
+    NaoVector<char> name_buf(alignment + 1);
+
+    entries.clear();
+    entries.reserve(file_count);
+
+    _m_index->names.reserve(file_count);
+    _m_index->extensions.reserve(file_count);
+
     for (uint32_t i = 0; i < file_count; ++i) {
-        files[i].name = _m_io->read(alignment);
+        std::copy_n(name_table.const_data() + (size_t(i) * alignment), alignment, name_buf.data());
+
+        entries.push_back({ name_buf.data(), offsets[i], sizes[i], sizes[i], false });
+        _m_index->names.push_back(entries.back().name);
     }
 
-    if (!_m_io->seek(size_table_offset)) {
-        nerr << "Failed seeking to size table at offset" << size_table_offset;
-        throw NaoDecodingException("Failed seeking to size table");
+    // Extensions are 4 bytes each, including the null terminator
+    if (extension_table_offset != 0 && _m_io->seek(extension_table_offset)) {
+        NaoBytes extension_table = _m_io->read(size_t(file_count) * 4);
+
+        char ext[5] { };
+        for (uint32_t i = 0; i < file_count; ++i) {
+            std::copy_n(extension_table.const_data() + (size_t(i) * 4), 4, ext);
+            _m_index->extensions.push_back(ext);
+        }
+    } else {
+        _derive_extensions();
     }
 
-    for (uint32_t i = 0; i < file_count; ++i) {
-        files[i].size = _m_io->read_uint();
+    if (hash_table_offset == 0 || !_read_hash_table(hash_table_offset, file_count)) {
+        _build_hash_table();
     }
+}
 
-    _m_files.reserve(file_count);
+bool NaoDATReader::_read_hash_table(uint32_t offset, uint32_t file_count) {
+    if (int64_t(offset) + 16 > _m_io->size() || !_m_io->seek(offset)) {
+        nwarn << "Hash table offset out of range";
+        return false;
+    }
 
-    for (const FileEntry& file : files) {
-        _m_files.push_back(new NaoObject({
-            new NaoChunkIO(_m_io,
-            { file.offset, file.size, 0 }),
-            file.size,
-            file.size,
-            false,
-            file.name
-            }));
+    const uint32_t shift = _m_io->read_uint();
+    const uint32_t buckets_offset = _m_io->read_uint();
+    const uint32_t hashes_offset = _m_io->read_uint();
+    const uint32_t indices_offset = _m_io->read_uint();
+
+    if (shift > 31) {
+        nwarn << "Invalid hash shift" << shift;
+        return false;
+    }
+
+    const size_t bucket_count = size_t(1) << (31 - shift);
+
+    // All tables are relative to the start of the hash table
+    if (int64_t(offset) + buckets_offset + int64_t(bucket_count) * 2 > _m_io->size()
+        || int64_t(offset) + hashes_offset + int64_t(file_count) * 4 > _m_io->size()
+        || int64_t(offset) + indices_offset + int64_t(file_count) * 2 > _m_io->size()) {
+        nwarn << "Hash table exceeds archive size";
+        return false;
+    }
+
+    NDRIndex& index = *_m_index;
+    index.shift = shift;
+
+    _m_io->seek(int64_t(offset) + buckets_offset);
+    NaoBytes buckets = _m_io->read(bucket_count * 2);
+
+    _m_io->seek(int64_t(offset) + hashes_offset);
+    NaoBytes hashes = _m_io->read(size_t(file_count) * 4);
+
+    _m_io->seek(int64_t(offset) + indices_offset);
+    NaoBytes indices = _m_io->read(size_t(file_count) * 2);
+
+    index.buckets = NaoVector<int32_t>(bucket_count);
+    index.hashes = NaoVector<uint32_t>(file_count);
+    index.indices = NaoVector<uint32_t>(file_count);
+
+    for (size_t i = 0; i < bucket_count; ++i) {
+        int16_t start;
+        std::copy_n(buckets.const_data() + (i * 2), 2, reinterpret_cast<char*>(&start));
+        index.buckets[i] = start;
+    }
+
+    std::copy_n(hashes.const_data(), size_t(file_count) * 4, reinterpret_cast<char*>(index.hashes.data()));
+
+    for (size_t i = 0; i < file_count; ++i) {
+        uint16_t file_index;
+        std::copy_n(indices.const_data() + (i * 2), 2, reinterpret_cast<char*>(&file_index));
+
+        if (file_index >= file_count) {
+            nwarn << "Hash table references file" << file_index << "out of" << file_count;
+            return false;
+        }
+
+        index.indices[i] = file_index;
+    }
+
+    return true;
+}
+
+void NaoDATReader::_build_hash_table() {
+    NDRIndex& index = *_m_index;
+
+    const size_t file_count = std::size(index.names);
+
+    // Enough buckets for every file, same layout as the on-disk table
+    uint32_t bits = 0;
+    while (bits < 31 && (size_t(1) << bits) < file_count) {
+        ++bits;
+    }
+
+    index.shift = 31 - bits;
+    index.buckets = NaoVector<int32_t>(size_t(1) << bits);
+    index.hashes = NaoVector<uint32_t>(file_count);
+    index.indices = NaoVector<uint32_t>(file_count);
+
+    std::fill(std::begin(index.buckets), std::end(index.buckets), -1);
+
+    NaoVector<uint32_t> name_hashes(file_count);
+    for (size_t i = 0; i < file_count; ++i) {
+        name_hashes[i] = NaoHash::crc32_lower(index.names[i].data(), std::size(index.names[i])) & 0x7FFFFFFF;
+        index.indices[i] = uint32_t(i);
+    }
+
+    // Group by bucket
+    std::stable_sort(std::begin(index.indices), std::end(index.indices),
+        [&name_hashes, &index](uint32_t a, uint32_t b) {
+        return (name_hashes[a] >> index.shift) < (name_hashes[b] >> index.shift);
+    });
+
+    for (size_t i = 0; i < file_count; ++i) {
+        index.hashes[i] = name_hashes[index.indices[i]];
+
+        const uint32_t bucket = index.hashes[i] >> index.shift;
+        if (index.buckets[bucket] < 0) {
+            index.buckets[bucket] = int32_t(i);
+        }
+    }
+}
+
+void NaoDATReader::_derive_extensions() {
+    _m_index->extensions.reserve(std::size(_m_index->names));
+
+    for (const NaoString& name : _m_index->names) {
+        const size_t dot = name.last_index_of('.');
+        _m_index->extensions.push_back(
+            (dot == size_t(-1)) ? NaoString() : name.substr(dot + 1));
+    }
+}
+
+void NaoDATReader::_build_extension_index() {
+    NDRIndex& index = *_m_index;
+
+    for (NaoString& ext : index.extensions) {
+        for (char& c : ext) {
+            c = NaoHash::to_lower(c);
+        }
+    }
+
+    for (size_t i = 0; i < std::size(index.extensions); ++i) {
+        const NaoString& ext = index.extensions[i];
+
+        auto group = std::find_if(std::begin(index.by_extension), std::end(index.by_extension),
+            [&ext](const NDRIndex::ExtensionGroup& g) { return g.extension == ext; });
+
+        if (group == std::end(index.by_extension)) {
+            index.by_extension.push_back({ ext, { } });
+            group = std::end(index.by_extension) - 1;
+        }
+
+        group->indices.push_back(uint32_t(i));
     }
 }
@@ -0,0 +1,207 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Decoding/Compression/NaoCRILAYLA.h"
+
+#define N_LOG_ID "NaoCRILAYLA"
+#include "Logging/NaoLogging.h"
+#include "Decoding/NaoDecodingException.h"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr char crilayla_magic[] = "CRILAYLA";
+static constexpr size_t magic_size = 8;
+
+// Magic, decompressed size and offset of the stored header
+static constexpr size_t preamble_size = 16;
+
+static uint32_t read_u32(const char* data) {
+    return uint32_t(uint8_t(data[0]))
+        | (uint32_t(uint8_t(data[1])) << 8)
+        | (uint32_t(uint8_t(data[2])) << 16)
+        | (uint32_t(uint8_t(data[3])) << 24);
+}
+
+// Reads the bitstream from the end towards the start, most significant bit first
+class CRILAYLABitReader {
+    public:
+    CRILAYLABitReader(const char* begin, const char* end)
+        : _m_begin(begin)
+        , _m_pos(end)
+        , _m_pool(0)
+        , _m_bits_left(0) { }
+
+    // Returns false if the stream ran out
+    bool read(uint32_t count, uint32_t& result) {
+        result = 0;
+
+        while (count > 0) {
+            if (_m_bits_left == 0) {
+                if (_m_pos == _m_begin) {
+                    return false;
+                }
+
+                _m_pool = uint8_t(*--_m_pos);
+                _m_bits_left = 8;
+            }
+
+            const uint32_t bits = std::min<uint32_t>(_m_bits_left, count);
+
+            result = (result << bits) | ((_m_pool >> (_m_bits_left - bits)) & ((1u << bits) - 1));
+
+            _m_bits_left -= bits;
+            count -= bits;
+        }
+
+        return true;
+    }
+
+    private:
+    const char* const _m_begin;
+    const char* _m_pos;
+
+    uint32_t _m_pool;
+    uint32_t _m_bits_left;
+};
+
+bool NaoCRILAYLA::is_compressed(const char* data, size_t size) {
+    return size >= magic_size && std::memcmp(data, crilayla_magic, magic_size) == 0;
+}
+
+int64_t NaoCRILAYLA::decompressed_size(const char* data, size_t size) {
+    if (size < preamble_size + header_size || !is_compressed(data, size)) {
+        return -1;
+    }
+
+    const uint64_t header_offset = read_u32(data + 12);
+
+    if (preamble_size + header_offset + header_size > size) {
+        return -1;
+    }
+
+    return int64_t(read_u32(data + 8)) + int64_t(header_size);
+}
+
+bool NaoCRILAYLA::decompress(const char* data, size_t size, char* out) {
+    const int64_t total = decompressed_size(data, size);
+
+    if (total < 0) {
+        return false;
+    }
+
+    const uint32_t header_offset = read_u32(data + 12);
+
+    std::memcpy(out, data + preamble_size + header_offset, header_size);
+
+    // Output is produced from the last byte backwards
+    char* const begin = out + header_size;
+    char* dest = out + total;
+
+    CRILAYLABitReader reader(data + preamble_size, data + preamble_size + header_offset);
+
+    // Bits for each successive length extension, all ones means another one follows
+    static constexpr uint32_t length_bits[] = { 2, 3, 5, 8 };
+
+    uint32_t flag;
+    while (dest > begin) {
+        if (!reader.read(1, flag)) {
+            return false;
+        }
+
+        if (!flag) {
+            uint32_t byte;
+            if (!reader.read(8, byte)) {
+                return false;
+            }
+
+            *--dest = char(byte);
+            continue;
+        }
+
+        uint32_t offset;
+        if (!reader.read(13, offset)) {
+            return false;
+        }
+
+        size_t length = 3;
+
+        uint32_t part = 0;
+        bool more = true;
+        for (uint32_t bits : length_bits) {
+            if (!reader.read(bits, part)) {
+                return false;
+            }
+
+            length += part;
+
+            if (part != (1u << bits) - 1) {
+                more = false;
+                break;
+            }
+        }
+
+        while (more) {
+            if (!reader.read(8, part)) {
+                return false;
+            }
+
+            length += part;
+            more = (part == 0xFF);
+        }
+
+        // Copies from already decompressed data after the current position
+        const char* source = dest + offset + 2;
+
+        if (source >= out + total || length > size_t(dest - begin)) {
+            return false;
+        }
+
+        // Byte by byte, source and destination may overlap
+        for (size_t i = 0; i < length; ++i) {
+            *--dest = *source--;
+        }
+    }
+
+    return true;
+}
+
+NaoBytes NaoCRILAYLA::decompress(const NaoBytes& data) {
+    const int64_t total = decompressed_size(data.const_data(), std::size(data));
+
+    if (total < 0) {
+        nerr << "Invalid CRILAYLA header";
+        throw NaoDecodingException("Invalid CRILAYLA header");
+    }
+
+    NaoBytes result('\0', size_t(total));
+
+    if (!decompress(data.const_data(), std::size(data), result.data())) {
+        nerr << "Malformed CRILAYLA data";
+        throw NaoDecodingException("Malformed CRILAYLA data");
+    }
+
+    return result;
+}
+
+bool NaoCRILAYLA::decompress_in_place(NaoBytes& data) {
+    if (is_compressed(data.const_data(), std::size(data))) {
+        data = decompress(data);
+    }
+
+    return true;
+}
@@ -18,16 +18,312 @@
 #include "Filesystem/NTreeNode.h"
 
 #include "IO/NaoIO.h"
+#include "Functionality/NaoHash.h"
+#include "Containers/NaoSmallVector.h"
+
+#include <mutex>
+#include <atomic>
+#include <cstring>
+#include <thread>
 
 #define N_LOG_ID "NTreeNode"
 #include "Logging/NaoLogging.h"
 
+// Nodes with at most this many children are searched linearly
+static constexpr size_t index_threshold = 8;
+
+static uint64_t name_hash(const NaoString& name) {
+    return NaoHash::fnv1a(name.c_str(), std::size(name));
+}
+
+// Compare a name to a (not null-terminated) string
+static bool name_equals(const NaoString& name, const char* str, size_t size) {
+    return std::size(name) == size && std::memcmp(name.c_str(), str, size) == 0;
+}
+
+// Hands out node generations, every rename or reparent gets a newer one than all before it
+static std::atomic<uint64_t> generation_clock = 0;
+
+/*
+ * Open addressing with linear probing, kept at most half full.
+ */
+struct NTreeNode::NTNIndex {
+    struct Slot {
+        uint64_t hash;
+        NTreeNode* node;
+    };
+
+    NaoVector<Slot> slots;
+    size_t count = 0;
+
+    explicit NTNIndex(size_t capacity) {
+        size_t size = 16;
+        while (size < capacity * 2) {
+            size *= 2;
+        }
+
+        slots = NaoVector<Slot>(size);
+    }
+
+    N_NODISCARD size_t mask() const {
+        return std::size(slots) - 1;
+    }
+
+    N_NODISCARD NTreeNode* find(const char* name, size_t size, uint64_t hash) const {
+        for (size_t i = hash & mask(); slots[i].node; i = (i + 1) & mask()) {
+            if (slots[i].hash == hash && name_equals(slots[i].node->name(), name, size)) {
+                return slots[i].node;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void insert(NTreeNode* node, uint64_t hash) {
+        if ((count + 1) * 2 > std::size(slots)) {
+            _grow();
+        }
+
+        size_t i = hash & mask();
+        while (slots[i].node) {
+            i = (i + 1) & mask();
+        }
+
+        slots[i] = { hash, node };
+        ++count;
+    }
+
+    void erase(NTreeNode* node, uint64_t hash) {
+        size_t i = hash & mask();
+        while (slots[i].node && slots[i].node != node) {
+            i = (i + 1) & mask();
+        }
+
+        if (!slots[i].node) {
+            return;
+        }
+
+        // Shift following entries back so no probe sequence is broken
+        size_t j = i;
+        for (;;) {
+            j = (j + 1) & mask();
+
+            if (!slots[j].node) {
+                break;
+            }
+
+            const size_t home = slots[j].hash & mask();
+
+            // Entry at j can only move to i if i lies cyclically in [home, j)
+            if (((j - home) & mask()) >= ((j - i) & mask())) {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+
+        slots[i] = { 0, nullptr };
+        --count;
+    }
+
+    private:
+    void _grow() {
+        NaoVector<Slot> old = std::move(slots);
+        slots = NaoVector<Slot>(std::size(old) * 2);
+
+        for (const Slot& slot : old) {
+            if (slot.node) {
+                size_t i = slot.hash & mask();
+                while (slots[i].node) {
+                    i = (i + 1) & mask();
+                }
+
+                slots[i] = slot;
+            }
+        }
+    }
+};
+
+/*
+ * Nodes are created and destroyed in large numbers at once, so allocate them
+ * from slabs instead of one by one. A slab is freed once all of its nodes are,
+ * so releasing a large subtree gives its memory back.
+ */
+struct NTNPool {
+    // Nodes per slab
+    static constexpr size_t slab_size = 512;
+
+    struct Slab;
+
+    struct Block {
+        union {
+            Block* next;
+            alignas(NTreeNode) char storage[sizeof(NTreeNode)];
+        };
+
+        // Slab this block belongs to
+        Slab* slab;
+    };
+
+    struct Slab {
+        Block blocks[slab_size];
+
+        // Free blocks in this slab
+        Block* free_list = nullptr;
+        size_t used = 0;
+
+        // Neighbours in the list of slabs with free blocks
+        Slab* prev = nullptr;
+        Slab* next = nullptr;
+    };
+
+    std::mutex mutex;
+
+    // Slabs with free blocks
+    Slab* available = nullptr;
+
+    // One empty slab is kept, so a node that's repeatedly created and deleted doesn't allocate a slab every time
+    Slab* spare = nullptr;
+
+    void* allocate() {
+        std::lock_guard lock(mutex);
+
+        Slab* slab = available;
+
+        if (!slab) {
+            slab = spare ? spare : _create();
+            spare = nullptr;
+
+            _link(slab);
+        }
+
+        Block* block = slab->free_list;
+        slab->free_list = block->next;
+        ++slab->used;
+
+        // Full slabs aren't looked at until a block is freed
+        if (!slab->free_list) {
+            _unlink(slab);
+        }
+
+        return block;
+    }
+
+    void deallocate(void* ptr) {
+        std::lock_guard lock(mutex);
+
+        // Storage is the first member
+        Block* block = static_cast<Block*>(ptr);
+        Slab* slab = block->slab;
+
+        if (!slab->free_list) {
+            _link(slab);
+        }
+
+        block->next = slab->free_list;
+        slab->free_list = block;
+
+        if (--slab->used > 0) {
+            return;
+        }
+
+        _unlink(slab);
+
+        if (spare) {
+            delete slab;
+        } else {
+            spare = slab;
+        }
+    }
+
+    static Slab* _create() {
+        Slab* slab = new Slab();
+
+        for (size_t i = 0; i < slab_size; ++i) {
+            slab->blocks[i].slab = slab;
+            slab->blocks[i].next = (i < slab_size - 1) ? &slab->blocks[i + 1] : nullptr;
+        }
+
+        slab->free_list = slab->blocks;
+
+        return slab;
+    }
+
+    void _link(Slab* slab) {
+        slab->prev = nullptr;
+        slab->next = available;
+
+        if (available) {
+            available->prev = slab;
+        }
+
+        available = slab;
+    }
+
+    void _unlink(Slab* slab) {
+        if (slab->prev) {
+            slab->prev->next = slab->next;
+        } else {
+            available = slab->next;
+        }
+
+        if (slab->next) {
+            slab->next->prev = slab->prev;
+        }
+
+        slab->prev = nullptr;
+        slab->next = nullptr;
+    }
+};
+
+static NTNPool& node_pool() {
+    static NTNPool pool;
+    return pool;
+}
+
+void* NTreeNode::operator new(size_t size) {
+    // Derived classes don't fit
+    if (size != sizeof(NTreeNode)) {
+        return ::operator new(size);
+    }
+
+    return node_pool().allocate();
+}
+
+void NTreeNode::operator delete(void* ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+
+    if (size != sizeof(NTreeNode)) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    node_pool().deallocate(ptr);
+}
+
 NTreeNode::~NTreeNode() {
     //ndebug << "Deleted" << name();
     delete _m_io;
+    delete _m_display_name;
+    delete _m_description.load();
+    delete _m_index;
+    delete _m_path;
 
-    for (NTreeNode* child : _m_children) {
-        delete child;
+    // Delete all descendants breadth-first instead of recursing
+    NaoVector<NTreeNode*> pending = std::move(_m_children);
+
+    for (size_t i = 0; i < std::size(pending); ++i) {
+        NTreeNode* node = pending[i];
+
+        // Take the children so deleting this node doesn't recurse
+        const NaoVector<NTreeNode*> children = std::move(node->_m_children);
+
+        for (NTreeNode* child : children) {
+            pending.push_back(child);
+        }
+
+        delete node;
     }
 }
 
@@ -37,7 +333,16 @@ NTreeNode::NTreeNode(const NaoString& name)
     , _m_locked(false)
     , _m_populated(false)
     , _m_io(nullptr)
-    , _m_display_name(name) { }
+    , _m_display_name(nullptr)
+    , _m_has_header(false)
+    , _m_populate_plugin(nullptr)
+    , _m_has_populate_plugin(false)
+    , _m_description(nullptr)
+    , _m_index(nullptr)
+    , _m_path(nullptr)
+    , _m_generation(0)
+    , _m_path_stamp(0)
+    , _m_path_locked(false) { }
 
 NTreeNode::NTreeNode(const NaoString& name, NTreeNode* parent)
     : NTreeNode(name) {
@@ -51,7 +356,7 @@ NTreeNode::NTreeNode(const NaoString& name, NTreeNode* parent)
 
 NTreeNode::NTreeNode(const NaoString& name, NTreeNode* parent, const NaoString& display_name)
     : NTreeNode(name, parent) {
-    _m_display_name = display_name;
+    set_display_name(display_name);
 }
 
 bool NTreeNode::lock() {
@@ -84,7 +389,31 @@ bool NTreeNode::set_name(const NaoString& name) {
         return false;
     }
 
+    // Keep the parent's index up to date
+    NTNIndex* index = _m_parent ? _m_parent->_m_index : nullptr;
+
+    if (index) {
+        index->erase(this, name_hash(_m_name));
+    }
+
+    // Display name stays the same
+    if (!_m_display_name && name != _m_name) {
+        _m_display_name = new NaoString(_m_name);
+    }
+
+    if (name != _m_name) {
+        _touch();
+
+        // Plugins and descriptions may depend on the name
+        _clear_resolved();
+    }
+
     _m_name = name;
+
+    if (index) {
+        index->insert(this, name_hash(_m_name));
+    }
+
     return true;
 }
 
@@ -97,23 +426,61 @@ bool NTreeNode::set_parent(NTreeNode* parent) {
         return false;
     }
 
+    if (parent != _m_parent) {
+        _touch();
+    }
+
     _m_parent = parent;
     return true;
 }
 
+void NTreeNode::set_detached_parent(NTreeNode* parent) {
+    if (parent != _m_parent) {
+        _touch();
+    }
+
+    _m_parent = parent;
+}
+
 NTreeNode* NTreeNode::parent() const {
     return _m_parent;
 }
 
 bool NTreeNode::add_child(NTreeNode* child) {
-    if (std::find_if(_m_children.begin(), _m_children.end(),
-        [&child](NTreeNode* c) {
-            return c->name() == child->name();
-        }) != _m_children.end()) {
+    if (!child || _find_child(child->name())) {
         return false;
     }
 
     _m_children.push_back(child);
+
+    if (child->_m_parent != this) {
+        child->_touch();
+    }
+
+    child->_m_parent = this;
+
+    if (_m_index) {
+        _m_index->insert(child, name_hash(child->name()));
+    } else if (std::size(_m_children) > index_threshold) {
+        _build_index();
+    }
+
+    return true;
+}
+
+bool NTreeNode::remove_child(NTreeNode* child) {
+    if (!has_child(child)) {
+        return false;
+    }
+
+    if (_m_index) {
+        _m_index->erase(child, name_hash(child->name()));
+    }
+
+    _m_children.erase(_m_children.begin() + _m_children.index_of(child));
+    child->_m_parent = nullptr;
+    child->_touch();
+
     return true;
 }
 
@@ -122,31 +489,26 @@ const NaoVector<NTreeNode*>& NTreeNode::children() const {
 }
 
 bool NTreeNode::has_child(const NaoString& name) const {
-    for (NTreeNode* const& child : _m_children) {
-        if (child->name() == name) {
-            return true;
-        }
-    }
-
-    return false;
+    return _find_child(name) != nullptr;
 }
 
 bool NTreeNode::has_child(NTreeNode* node) const {
-    return _m_children.contains(node);
+    return node && node->_m_parent == this && _find_child(node->name()) == node;
 }
 
 NTreeNode* NTreeNode::get_child(const NaoString& name) const {
-    for (NTreeNode* const& child : _m_children) {
-        if (child->name() == name) {
-            return child;
-        }
-    }
+    return _find_child(name);
+}
 
-    return nullptr;
+NTreeNode* NTreeNode::get_child(const char* name, size_t size) const {
+    return _find_child(name, size);
 }
 
 void NTreeNode::clear_children() {
     _m_children.clear();
+
+    delete _m_index;
+    _m_index = nullptr;
 }
 
 void NTreeNode::set_populated(bool state) {
@@ -158,47 +520,252 @@ bool NTreeNode::populated() const {
 }
 
 NaoString NTreeNode::path() const {
-    NaoString path;
+    // Only the parent's path is memoized, this node just appends its name
+    static const NaoString empty;
+    const NaoString& base = _m_parent ? _m_parent->_raw_path() : empty;
 
-    NTreeNode const* walker = this;
-    while (walker) {
-        path = walker->name() + N_PATHSEP + path;
+    const char* base_data = base.c_str();
+    size_t base_size = std::size(base);
 
-        walker = walker->parent();
-    }
+    const char* name_data = _m_name.c_str();
+    size_t name_size = std::size(_m_name);
 
-    // Trailing slash if we are a directory, else remove it
-    if (!is_dir()) {
-        path = path.substr(0, path.size() - 1);
-    }
+    // Trailing slash if we are a directory
+    const bool trailing = is_dir();
+
+    bool leading = false;
 
 #ifdef N_WINDOWS
     // On Windows, remove leading separator
-    if (path.starts_with(N_PATHSEP) && path.size() > 1) {
-        return path.substr(1).uc_first();
+    if (base_size + name_size + (trailing ? 1 : 0) > 1) {
+        if (base_size > 0 && *base_data == N_PATHSEP) {
+            ++base_data;
+            --base_size;
+            leading = true;
+        } else if (base_size == 0 && name_size > 0 && *name_data == N_PATHSEP) {
+            ++name_data;
+            --name_size;
+            leading = true;
+        }
     }
 #endif
 
+    NaoString path;
+    path.resize(base_size + name_size + (trailing ? 1 : 0));
+
+    char* out = std::copy_n(base_data, base_size, path.data());
+    out = std::copy_n(name_data, name_size, out);
+
+    if (trailing) {
+        *out = N_PATHSEP;
+    }
+
+    if (leading) {
+        path.uc_first();
+    }
+
     return path;
 }
 
+const NaoString& NTreeNode::_raw_path() const {
+    // Every node up to the root, with the newest generation from there up to the root
+    struct Link {
+        NTreeNode const* node;
+        uint64_t newest;
+    };
+
+    NaoSmallVector<Link, 32> chain;
+
+    for (NTreeNode const* walker = this; walker; walker = walker->_m_parent) {
+        chain.push_back({ walker, 0 });
+    }
+
+    uint64_t newest = 0;
+    for (size_t i = std::size(chain); i-- > 0;) {
+        newest = std::max<uint64_t>(newest, chain[i].node->_m_generation);
+        chain[i].newest = newest;
+    }
+
+    // A memo is stale once anything above it was renamed or moved after it was built
+    auto valid = [](const Link& link) {
+        return link.node->_m_path_stamp.load(std::memory_order_acquire) > link.newest;
+    };
+
+    if (valid(chain[0])) {
+        return *_m_path;
+    }
+
+    // Concurrent readers rebuild different nodes independently, only the same node waits
+    while (_m_path_locked.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+
+    if (!valid(chain[0])) {
+        // Start from the nearest ancestor with a valid path
+        size_t base = std::size(chain);
+        size_t size = 0;
+
+        for (size_t i = 0; i < std::size(chain); ++i) {
+            if (i > 0 && valid(chain[i])) {
+                base = i;
+                size += std::size(*chain[i].node->_m_path);
+                break;
+            }
+
+            size += std::size(chain[i].node->_m_name) + 1;
+        }
+
+        if (!_m_path) {
+            _m_path = new NaoString();
+        }
+
+        _m_path->resize(size);
+
+        // Fill from the back, every node contributes its name and a separator
+        char* out = _m_path->data() + size;
+
+        for (size_t i = 0; i < base; ++i) {
+            const NaoString& name = chain[i].node->_m_name;
+
+            *--out = N_PATHSEP;
+
+            out -= std::size(name);
+            std::copy_n(name.c_str(), std::size(name), out);
+        }
+
+        if (base < std::size(chain)) {
+            const NaoString& base_path = *chain[base].node->_m_path;
+            std::copy_n(base_path.c_str(), std::size(base_path), _m_path->data());
+        }
+
+        // Published last, so readers that see the stamp also see the complete path
+        _m_path_stamp.store(chain[0].newest + 1, std::memory_order_release);
+    }
+
+    _m_path_locked.store(false, std::memory_order_release);
+
+    return *_m_path;
+}
+
+void NTreeNode::_touch() {
+    _m_generation = ++generation_clock;
+}
+
 void NTreeNode::set_io(NaoIO* io) {
     _m_io = io;
+
+    // Header belonged to the previous IO
+    _m_header = NaoBytes();
+    _m_has_header = false;
+
+    // So did anything resolved from it
+    _clear_resolved();
 }
 
 NaoIO* NTreeNode::io() const {
     return _m_io;
 }
 
+void NTreeNode::set_header(const NaoBytes& header) {
+    _m_header = header;
+    _m_has_header = true;
+}
+
+const NaoBytes& NTreeNode::header() const {
+    return _m_header;
+}
+
+bool NTreeNode::has_header() const {
+    return _m_has_header;
+}
+
 bool NTreeNode::is_dir() const {
     return _m_io == nullptr;
 }
 
+void NTreeNode::set_populate_plugin(NaoPlugin* plugin) {
+    // Concurrent readers find the same plugin, so it doesn't matter who stores it
+    _m_populate_plugin.store(plugin);
+    _m_has_populate_plugin.store(true);
+}
+
+NaoPlugin* NTreeNode::populate_plugin() const {
+    return _m_populate_plugin.load();
+}
+
+bool NTreeNode::has_populate_plugin() const {
+    return _m_has_populate_plugin.load();
+}
+
+void NTreeNode::set_description(const NaoString& description) {
+    NaoString* expected = nullptr;
+    NaoString* cached = new NaoString(description);
+
+    // Other readers may be using an existing description, so never replace it
+    if (!_m_description.compare_exchange_strong(expected, cached)) {
+        delete cached;
+    }
+}
+
+NaoString NTreeNode::description() const {
+    const NaoString* cached = _m_description.load();
+
+    return cached ? *cached : NaoString();
+}
+
+bool NTreeNode::has_description() const {
+    return _m_description.load() != nullptr;
+}
+
 void NTreeNode::set_display_name(const NaoString& name) {
-    _m_display_name = name;
+    // Only store it if it's different
+    if (name == _m_name) {
+        delete _m_display_name;
+        _m_display_name = nullptr;
+    } else if (_m_display_name) {
+        *_m_display_name = name;
+    } else {
+        _m_display_name = new NaoString(name);
+    }
 }
 
 const NaoString& NTreeNode::display_name() const {
-    return _m_display_name;
+    return _m_display_name ? *_m_display_name : _m_name;
+}
+
+//// Private
+
+NTreeNode* NTreeNode::_find_child(const NaoString& name) const {
+    return _find_child(name.c_str(), std::size(name));
 }
 
+NTreeNode* NTreeNode::_find_child(const char* name, size_t size) const {
+    if (_m_index) {
+        return _m_index->find(name, size, NaoHash::fnv1a(name, size));
+    }
+
+    for (NTreeNode* child : _m_children) {
+        if (name_equals(child->name(), name, size)) {
+            return child;
+        }
+    }
+
+    return nullptr;
+}
+
+void NTreeNode::_clear_resolved() {
+    _m_has_populate_plugin.store(false);
+    _m_populate_plugin.store(nullptr);
+
+    // Only called by the writer, which locks out readers first
+    delete _m_description.exchange(nullptr);
+}
+
+void NTreeNode::_build_index() {
+    delete _m_index;
+    _m_index = new NTNIndex(std::size(_m_children));
+
+    for (NTreeNode* child : _m_children) {
+        _m_index->insert(child, name_hash(child->name()));
+    }
+}
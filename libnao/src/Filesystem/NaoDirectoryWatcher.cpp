@@ -0,0 +1,224 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Filesystem/NaoDirectoryWatcher.h"
+
+#include "Filesystem/Filesystem.h"
+
+#define N_LOG_ID "NaoDirectoryWatcher"
+#include "Logging/NaoLogging.h"
+
+#include <unordered_map>
+
+#ifdef N_WINDOWS
+#   include <Windows.h>
+#endif
+
+// Size of the notification buffer, changes are lost if it overflows between polls
+static constexpr uint32_t notify_buffer_size = 64 * 1024;
+
+struct NaoDirectoryWatcher::NDWState {
+#ifdef N_WINDOWS
+    HANDLE directory = INVALID_HANDLE_VALUE;
+    OVERLAPPED overlapped { };
+    bool listening = false;
+
+    // Must be DWORD-aligned
+    DWORD* buffer = nullptr;
+#endif
+
+    // Polling fallback
+    struct Entry {
+        bool dir;
+        uintmax_t size;
+        fs::file_time_type time;
+    };
+
+    std::unordered_map<std::string, Entry> listing;
+
+    static std::unordered_map<std::string, Entry> list(const NaoString& path) {
+        std::unordered_map<std::string, Entry> result;
+        std::error_code ec;
+
+        for (const fs::directory_entry& entry : fs::directory_iterator(path.c_str(), ec)) {
+            const bool dir = entry.is_directory(ec);
+
+            result[entry.path().filename().string()] = {
+                dir,
+                dir ? 0 : entry.file_size(ec),
+                entry.last_write_time(ec)
+            };
+        }
+
+        return result;
+    }
+};
+
+NaoDirectoryWatcher::NaoDirectoryWatcher(const NaoString& path)
+    : _m_path(path)
+    , _m_state(new NDWState()) {
+
+#ifdef N_WINDOWS
+    _m_state->directory = CreateFileA(_m_path, FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+
+    if (_m_state->directory != INVALID_HANDLE_VALUE) {
+        _m_state->overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+        _m_state->buffer = new DWORD[notify_buffer_size / sizeof(DWORD)];
+
+        if (_m_state->overlapped.hEvent && _listen()) {
+            return;
+        }
+
+        nwarn << "Change notifications unavailable for" << _m_path << "polling instead";
+    }
+#endif
+
+    _m_state->listing = NDWState::list(_m_path);
+}
+
+NaoDirectoryWatcher::~NaoDirectoryWatcher() {
+#ifdef N_WINDOWS
+    if (_m_state->directory != INVALID_HANDLE_VALUE) {
+        // Wait for the cancellation so the buffer isn't written to after it's freed
+        if (_m_state->listening) {
+            DWORD bytes = 0;
+            CancelIo(_m_state->directory);
+            GetOverlappedResult(_m_state->directory, &_m_state->overlapped, &bytes, TRUE);
+        }
+
+        CloseHandle(_m_state->directory);
+    }
+
+    if (_m_state->overlapped.hEvent) {
+        CloseHandle(_m_state->overlapped.hEvent);
+    }
+
+    delete[] _m_state->buffer;
+#endif
+
+    delete _m_state;
+}
+
+const NaoString& NaoDirectoryWatcher::path() const {
+    return _m_path;
+}
+
+bool NaoDirectoryWatcher::native() const {
+#ifdef N_WINDOWS
+    return _m_state->listening;
+#else
+    return false;
+#endif
+}
+
+bool NaoDirectoryWatcher::poll(NaoVector<NaoString>& names) {
+#ifdef N_WINDOWS
+    if (!_m_state->listening) {
+        return _poll_listing(names);
+    }
+
+    // Drain every completed notification
+    for (;;) {
+        DWORD bytes = 0;
+
+        if (!GetOverlappedResult(_m_state->directory, &_m_state->overlapped, &bytes, FALSE)) {
+            if (GetLastError() == ERROR_IO_INCOMPLETE) {
+                // Nothing new
+                return true;
+            }
+
+            nwarn << "Failed retrieving changes for" << _m_path;
+
+            _m_state->listening = false;
+            _listen();
+            return false;
+        }
+
+        _m_state->listening = false;
+
+        // Buffer overflowed, the changes are lost
+        if (bytes == 0) {
+            _listen();
+            return false;
+        }
+
+        const char* data = reinterpret_cast<const char*>(_m_state->buffer);
+
+        for (;;) {
+            const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(data);
+
+            names.push_back(fs::path(std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR))).string());
+
+            if (info->NextEntryOffset == 0) {
+                break;
+            }
+
+            data += info->NextEntryOffset;
+        }
+
+        if (!_listen()) {
+            return false;
+        }
+    }
+#else
+    return _poll_listing(names);
+#endif
+}
+
+bool NaoDirectoryWatcher::_listen() {
+#ifdef N_WINDOWS
+    ResetEvent(_m_state->overlapped.hEvent);
+
+    _m_state->listening = ReadDirectoryChangesW(_m_state->directory,
+        _m_state->buffer, notify_buffer_size, FALSE,
+        FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME
+        | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE,
+        nullptr, &_m_state->overlapped, nullptr) != FALSE;
+
+    return _m_state->listening;
+#else
+    return false;
+#endif
+}
+
+bool NaoDirectoryWatcher::_poll_listing(NaoVector<NaoString>& names) {
+    std::unordered_map<std::string, NDWState::Entry> listing = NDWState::list(_m_path);
+
+    for (const auto& [name, entry] : listing) {
+        auto it = _m_state->listing.find(name);
+
+        if (it == _m_state->listing.end()
+            || it->second.dir != entry.dir
+            || it->second.size != entry.size
+            || it->second.time != entry.time) {
+            names.push_back(name);
+        }
+    }
+
+    for (const auto& [name, entry] : _m_state->listing) {
+        if (listing.count(name) == 0) {
+            names.push_back(name);
+        }
+    }
+
+    _m_state->listing = std::move(listing);
+
+    return true;
+}
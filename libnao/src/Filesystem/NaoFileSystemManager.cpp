@@ -17,7 +17,7 @@
 
 /**
  * \file NaoFileSystemManager.cpp
- * \brief Contains implementations for NaoFileSystemManager and it's related classes.
+ * \brief Contains implementations for NaoFileSystemManager and its related classes.
  */
 
 #include "Filesystem/NaoFileSystemManager.h"
@@ -73,61 +73,44 @@ bool NaoFileSystemManager::init(const NaoString& start_dir) const {
 }
 
 NTreeNode* NaoFileSystemManager::retrieve_node(const NaoString& path) const {
-    NaoVector<NaoString> parts = path.normalize_path().split(N_PATHSEP);
+    std::lock_guard writing(d_ptr->write_mutex());
 
-    // Remove any empty entries caused by duplicate separators
-    parts.erase(std::remove(parts.begin(), parts.end(), ""), parts.end());
-
-    NTreeNode* current = d_ptr->root();
-
-#ifdef N_WINDOWS
-    // Check root drive
-    if (!parts.empty()) {
-        if (parts.front().size() != 2 || parts.front().back() != ':') {
-            nerr << "Invalid drive at beginning of path";
-            return nullptr;
-        }
-
-        if (GetDriveTypeA(parts.front() + '/') <= DRIVE_NO_ROOT_DIR) {
-            nerr << "Drive is not present";
-            return nullptr;
-        }
-
-        // Add drive with specific display name
-        if (!current->has_child(parts.front())) {
-            current = new NTreeNode(parts.front(), current, parts.front().substr(0, 1));
-            parts.erase(parts.begin());
-        }
-    }
-#endif
-
-    for (const NaoString& part : parts) {
-        if (!current->has_child(part)) {
-            // Child does not exist, create it
-            current = new NTreeNode(part, current);
-        } else {
-            current = current->get_child(part);
-        }
-    }
-
-    return current;
+    return d_ptr->retrieve_node(path);
 }
 
 bool NaoFileSystemManager::move(const NaoString& path) const {
+    return move(path, nullptr);
+}
+
+bool NaoFileSystemManager::move(const NaoString& path, const NaoPlugin::PopulateCallback& callback) const {
     try {
         nlog << "Moving to path" << path;
 
+        // One change at a time, readers are only blocked while it's committed
+        std::lock_guard writing(d_ptr->write_mutex());
+
+        // Foreground work first
+        d_ptr->cancel_prefetch();
+
         // Retrieve (possibly new) target node
-        NTreeNode* node = retrieve_node(path);
+        NTreeNode* node = d_ptr->retrieve_node(path);
 
         if (!node) {
             return false;
         }
 
-        // Already populated
+        // Already populated, catch up with any changes made since
         if (node->populated()) {
+            NaoPlugin::Changes changes;
+            d_ptr->refresh(node, changes);
+        }
+
+        // Already populated, or populated in the background
+        if (node->populated() || d_ptr->adopt_prefetched(node)) {
             d_ptr->set_current(node);
             d_ptr->gc();
+            d_ptr->probe(node->children(), NPM.header_size(), true);
+            d_ptr->prefetch(node);
             return true;
         }
 
@@ -140,16 +123,43 @@ bool NaoFileSystemManager::move(const NaoString& path) const {
             return false;
         }
 
-        // Populate the new node
-        if (!plugin->populate(node) || !node->populated()) {
+        // Populate the new node, headers are read before its children become visible
+        if (!d_ptr->populate(node, plugin, callback)) {
             nerr << "Failed to populate using plugin" << plugin->name();
             return false;
         }
 
-
         d_ptr->set_current(node);
         d_ptr->gc();
 
+        // Start on what's likely to be opened next
+        d_ptr->prefetch(node);
+
+        return true;
+    } catch (const std::exception& e) {
+        nerr << e.what();
+        return false;
+    }
+}
+
+bool NaoFileSystemManager::refresh(NaoPlugin::Changes& changes) const {
+    try {
+        std::lock_guard writing(d_ptr->write_mutex());
+
+        // Foreground work first
+        d_ptr->cancel_prefetch();
+
+        NTreeNode* node = d_ptr->current();
+
+        if (!node || !d_ptr->refresh(node, changes)) {
+            return false;
+        }
+
+        // New and modified files need their headers
+        d_ptr->probe(node->children(), NPM.header_size(), true);
+
+        d_ptr->prefetch(node);
+
         return true;
     } catch (const std::exception& e) {
         nerr << e.what();
@@ -165,31 +175,75 @@ NaoString NaoFileSystemManager::description(NTreeNode* node) const {
     // Shut up ReSharper
     (void) this;
 
-    // Find a plugin to supply the description
-    NaoPlugin* plugin = NPM.description_plugin(node);
-
-    // If found return the description
-    if (plugin) {
-        return plugin->description(node);
+    // Resolved before, nothing changed since
+    if (node->has_description()) {
+        return node->description();
     }
 
+    NaoString description;
+
+    // Find a plugin to supply the description
+    if (NaoPlugin* plugin = NPM.description_plugin(node)) {
+        description = plugin->description(node);
+    } else {
 #ifdef N_WINDOWS
 
-    // Windows-only WinAPI fallback
-    SHFILEINFOA finfo{ };
-    SHGetFileInfoA(node->path(),
-        node->is_dir() ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL,
-        &finfo,
-        sizeof(finfo),
-        SHGFI_USEFILEATTRIBUTES | SHGFI_TYPENAME);
+        // Windows-only WinAPI fallback
+        SHFILEINFOA finfo{ };
+        SHGetFileInfoA(node->path(),
+            node->is_dir() ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL,
+            &finfo,
+            sizeof(finfo),
+            SHGFI_USEFILEATTRIBUTES | SHGFI_TYPENAME);
 
-    return finfo.szTypeName;
+        description = finfo.szTypeName;
 
-#else
-    return NaoString();
 #endif
+    }
+
+    node->set_description(description);
+
+    return description;
+}
+
+
+void NaoFileSystemManager::probe(NTreeNode* node, int64_t size) const {
+    if (size < 0) {
+        size = NPM.header_size();
+    }
+
+    std::lock_guard writing(d_ptr->write_mutex());
+
+    d_ptr->probe(node->children(), size, true);
+}
+
+std::shared_lock<std::shared_mutex> NaoFileSystemManager::read_lock() const {
+    return d_ptr->read_lock();
+}
+
+void NaoFileSystemManager::lock(NTreeNode* node) const {
+    d_ptr->lock(node);
+}
+
+void NaoFileSystemManager::unlock(NTreeNode* node) const {
+    d_ptr->unlock(node);
+}
+
+void NaoFileSystemManager::set_retention_budget(int64_t bytes) const {
+    d_ptr->set_retention_budget(bytes);
+}
+
+int64_t NaoFileSystemManager::retention_budget() const {
+    return d_ptr->retention_budget();
+}
+
+void NaoFileSystemManager::set_prefetch_enabled(bool enabled) const {
+    d_ptr->set_prefetch_enabled(enabled);
 }
 
+bool NaoFileSystemManager::prefetch_enabled() const {
+    return d_ptr->prefetch_enabled();
+}
 
 #if 0
 
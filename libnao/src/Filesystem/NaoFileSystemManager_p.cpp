@@ -20,14 +20,73 @@
 
 #include "Filesystem/NaoFileSystemManager_p.h"
 #include "Filesystem/NTreeNode.h"
+#include "IO/NaoFileIO.h"
+#include "Functionality/NaoParallel.h"
+#include "Functionality/NaoHash.h"
+
+#include "Plugin/NaoPluginManager.h"
+#include "Plugin/NaoPlugin.h"
+
+#include <unordered_set>
+#include <algorithm>
+#include <vector>
+
+#ifdef N_WINDOWS
+#   include <Windows.h>
+#endif
+
+// Keep 64 MiB of recently visited nodes by default
+static constexpr int64_t default_retention_budget = 64i64 << 20;
+
+// Rough size of an IO object and its bookkeeping
+static constexpr int64_t io_cost = 128;
+
+// Number of visited paths to remember for prefetching
+static constexpr size_t history_size = 64;
+
+// Maximum number of children to prefetch per node
+static constexpr size_t prefetch_limit = 4;
+
+// Number of resolved paths to cache
+static constexpr size_t path_cache_size = 256;
 
 NFSMPrivate::NFSMPrivate()
     : _m_root(nullptr)
-    , _m_current(nullptr) {
-
+    , _m_current(nullptr)
+    , _m_retention_budget(default_retention_budget)
+    , _m_prefetch_enabled(false)
+    , _m_prefetch_parent(nullptr)
+    , _m_prefetch_pinned(nullptr)
+    , _m_prefetch_stop(false)
+    , _m_release_stop(false) {
+    _m_release_thread = std::thread(&NFSMPrivate::_release_worker, this);
 }
 
 NFSMPrivate::~NFSMPrivate() {
+    {
+        std::lock_guard lock(_m_prefetch_mutex);
+        _m_prefetch_stop = true;
+    }
+
+    _m_prefetch_cond.notify_one();
+
+    if (_m_prefetch_thread.joinable()) {
+        _m_prefetch_thread.join();
+    }
+
+    for (const Prefetched& result : _m_prefetched) {
+        delete result.node;
+    }
+
+    {
+        std::lock_guard lock(_m_release_mutex);
+        _m_release_stop = true;
+    }
+
+    _m_release_cond.notify_one();
+    _m_release_thread.join();
+
+    // Worker deletes everything that's left before returning
     delete _m_root;
 }
 
@@ -41,6 +100,250 @@ NTreeNode* NFSMPrivate::root() const {
     return _m_root;
 }
 
+std::shared_lock<std::shared_mutex> NFSMPrivate::read_lock() const {
+    return std::shared_lock(_m_tree_mutex);
+}
+
+void NFSMPrivate::lock(NTreeNode* node) {
+    // Keeps gc() out, which only reads the locked nodes while holding the tree exclusively
+    const auto reading = read_lock();
+    std::lock_guard lock(_m_locked_mutex);
+
+    if (!_m_locked.contains(node)) {
+        node->lock();
+    }
+
+    _m_locked.push_back(node);
+}
+
+void NFSMPrivate::unlock(NTreeNode* node) {
+    const auto reading = read_lock();
+    std::lock_guard lock(_m_locked_mutex);
+
+    const size_t index = _m_locked.index_of(node);
+
+    if (index == size_t(-1)) {
+        nwarn << "Unlocking" << node->name() << "which wasn't locked";
+        return;
+    }
+
+    _m_locked.erase(_m_locked.begin() + index);
+
+    if (!_m_locked.contains(node)) {
+        node->unlock();
+    }
+}
+
+std::mutex& NFSMPrivate::write_mutex() {
+    return _m_write_mutex;
+}
+
+NTreeNode* NFSMPrivate::retrieve_node(const NaoString& path) {
+    const char* data = path.c_str();
+    const size_t size = std::size(path);
+    const uint64_t hash = NaoHash::fnv1a(data, size);
+
+    // Most paths were resolved recently
+    if (auto it = _m_path_cache.find(hash); it != _m_path_cache.end() && it->second.path == path) {
+        return it->second.node;
+    }
+
+    // New nodes become visible to readers
+    std::unique_lock committing(_m_tree_mutex);
+
+    NTreeNode* current = _m_root;
+
+    // Walk the components in place, only new nodes need their name copied
+    for (size_t begin = 0; begin < size;) {
+        size_t end = begin;
+
+        while (end < size && data[end] != '/' && data[end] != '\\') {
+            ++end;
+        }
+
+        const char* part = data + begin;
+        const size_t length = end - begin;
+
+        begin = end + 1;
+
+        // Duplicate separators and "." don't go anywhere
+        if (length == 0 || (length == 1 && part[0] == '.')) {
+            continue;
+        }
+
+        if (length == 2 && part[0] == '.' && part[1] == '.') {
+#ifdef N_WINDOWS
+            // Never go above the drive
+            if (current != _m_root && current->parent() != _m_root) {
+#else
+            if (current != _m_root) {
+#endif
+                current = current->parent();
+            }
+
+            continue;
+        }
+
+        NTreeNode* child = current->get_child(part, length);
+
+        if (!child) {
+            const NaoString name = std::string(part, length);
+
+#ifdef N_WINDOWS
+            // Check root drive
+            if (current == _m_root) {
+                if (length != 2 || part[1] != ':') {
+                    nerr << "Invalid drive at beginning of path";
+                    return nullptr;
+                }
+
+                if (GetDriveTypeA(name + '/') <= DRIVE_NO_ROOT_DIR) {
+                    nerr << "Drive is not present";
+                    return nullptr;
+                }
+
+                // Add drive with specific display name
+                child = new NTreeNode(name, current, name.substr(0, 1));
+            } else {
+                // Child does not exist, create it
+                child = new NTreeNode(name, current);
+            }
+#else
+            // Child does not exist, create it
+            child = new NTreeNode(name, current);
+#endif
+        }
+
+        current = child;
+    }
+
+    // Make room by dropping an arbitrary entry
+    if (std::size(_m_path_cache) >= path_cache_size) {
+        _m_path_cache.erase(_m_path_cache.begin());
+    }
+
+    _m_path_cache[hash] = { path, current };
+
+    return current;
+}
+
+bool NFSMPrivate::populate(NTreeNode* node, NaoPlugin* plugin, const NaoPlugin::PopulateCallback& callback) {
+    const int64_t header_size = NPM.header_size();
+
+    // Populate a node that's not in the tree, so readers never see it half-populated
+    NTreeNode* shadow = new NTreeNode(node->name());
+
+    if (node->parent()) {
+        shadow->set_detached_parent(node->parent());
+    }
+
+    // Borrowed, the node keeps owning its IO
+    shadow->set_io(node->io());
+
+    // Plugins must only fill in the shadow, changing the node itself would bypass the tree lock
+    const size_t live_children = std::size(node->children());
+
+    bool success = false;
+
+    try {
+        if (callback) {
+            success = plugin->populate_batched(shadow, [&](const NaoVector<NTreeNode*>& batch) {
+                // Batches are described right away, so their headers are needed first
+                probe(batch, header_size, false);
+                callback(batch);
+            });
+        } else {
+            success = plugin->populate(shadow);
+        }
+
+        success = success && shadow->populated();
+
+        if (std::size(node->children()) != live_children) {
+            nerr << "Plugin" << plugin->name() << "changed" << node->path() << "instead of populating a copy";
+            success = false;
+        }
+
+        if (success) {
+            // Read all headers at once instead of one at a time when they're described
+            probe(shadow->children(), header_size, false);
+        }
+    } catch (const std::exception& e) {
+        nerr << "Populating" << node->path() << "failed:" << e.what();
+        success = false;
+    }
+
+    if (success) {
+        std::unique_lock committing(_m_tree_mutex);
+
+        for (NTreeNode* child : shadow->children()) {
+            node->add_child(child);
+        }
+
+        shadow->clear_children();
+        node->set_populated(true);
+    }
+
+    shadow->set_io(nullptr);
+
+    // Anything left over is from a failed populate
+    NaoVector<NTreeNode*> released { shadow };
+    _release(released);
+
+    return success;
+}
+
+void NFSMPrivate::probe(const NaoVector<NTreeNode*>& nodes, int64_t size, bool in_tree) {
+    // Files on disk each have their own handle, other IO's may share one device
+    NaoVector<NTreeNode*> disk_files;
+    NaoVector<NTreeNode*> other_files;
+
+    for (NTreeNode* child : nodes) {
+        if (child->is_dir() || child->has_header()) {
+            continue;
+        }
+
+        if (dynamic_cast<NaoFileIO*>(child->io())) {
+            disk_files.push_back(child);
+        } else {
+            other_files.push_back(child);
+        }
+    }
+
+    auto read_header = [size](NTreeNode* child) {
+        NaoIO* io = child->io();
+
+        return (io->size() > 0)
+            ? io->read_singleshot(size_t(std::min<int64_t>(io->size(), size)))
+            : NaoBytes();
+    };
+
+    // Read without holding the tree lock, we're the only writer
+    std::vector<NaoBytes> disk_headers(std::size(disk_files));
+    std::vector<NaoBytes> other_headers(std::size(other_files));
+
+    NaoParallel::for_each_index(std::size(disk_files), [&](size_t i) {
+        disk_headers[i] = read_header(disk_files[i]);
+    });
+
+    for (size_t i = 0; i < std::size(other_files); ++i) {
+        other_headers[i] = read_header(other_files[i]);
+    }
+
+    std::unique_lock committing(_m_tree_mutex, std::defer_lock);
+
+    if (in_tree) {
+        committing.lock();
+    }
+
+    for (size_t i = 0; i < std::size(disk_files); ++i) {
+        disk_files[i]->set_header(disk_headers[i]);
+    }
+
+    for (size_t i = 0; i < std::size(other_files); ++i) {
+        other_files[i]->set_header(other_headers[i]);
+    }
+}
+
 void NFSMPrivate::set_current(NTreeNode* node) {
     _m_current = node;
 }
@@ -50,46 +353,561 @@ NTreeNode* NFSMPrivate::current() const {
 }
 
 void NFSMPrivate::gc() {
-    // Find all nodes up to the current node
-    NaoVector<NTreeNode*> path { _m_current };
-    NTreeNode* current = _m_current;
+    std::unique_lock committing(_m_tree_mutex);
 
-    do {
-        current = current->parent();
-        path.push_back(current);
-    } while (current && current != _m_root);
+    _release_detached();
 
-    // Work from root to current
-    NTreeNode* node = _m_root;
+    _touch();
 
-    while (node && node != _m_current) {
-        // If the node is locked, don't touch any of it's descendants
-        if (node->locked()) {
+    // Children may have been added or released since these were visited
+    for (Retained& entry : _m_retained) {
+        entry.cost = _retained_cost(entry.node);
+    }
+
+    const int64_t budget = _m_retention_budget;
+
+    // Keep the most recently visited nodes that fit in the budget, the current node always fits
+    int64_t used = 0;
+    size_t first_kept = std::size(_m_retained);
+
+    while (first_kept > 0) {
+        const Retained& entry = _m_retained[first_kept - 1];
+
+        if (entry.node != _m_current && used + entry.cost > budget) {
             break;
         }
 
-        NTreeNode* next = nullptr;
+        used += entry.cost;
+        --first_kept;
+    }
+
+    if (first_kept > 0) {
+        ndebug << "Evicting" << first_kept << "nodes, retaining" << NaoString::bytes(used);
+
+        _m_retained.erase(_m_retained.begin(), _m_retained.begin() + first_kept);
+    }
+
+    // Retained nodes and every node on the way to them
+    std::unordered_set<NTreeNode*> kept;
+    std::unordered_set<NTreeNode*> needed;
+
+    for (const Retained& entry : _m_retained) {
+        kept.insert(entry.node);
+
+        for (NTreeNode* node = entry.node; node && needed.insert(node).second; node = node->parent()) { }
+    }
+
+    // Locked nodes are kept like retained ones
+    for (NTreeNode* locked : _m_locked) {
+        kept.insert(locked);
+
+        for (NTreeNode* node = locked; node && needed.insert(node).second; node = node->parent()) { }
+    }
+
+    // Prefetched nodes refer to their parent
+    {
+        std::lock_guard lock(_m_prefetch_mutex);
+
+        for (NTreeNode* node = _m_prefetch_pinned; node && needed.insert(node).second; node = node->parent()) { }
+    }
+
+    // Work from root to the retained nodes
+    NaoVector<NTreeNode*> pending { _m_root };
+
+    for (size_t i = 0; i < std::size(pending); ++i) {
+        NTreeNode* node = pending[i];
+
+        // If the node is locked, don't touch any of its descendants
+        if (node->locked()) {
+            continue;
+        }
+
+        // Retained nodes keep all their children, but not what was populated below them
+        if (kept.count(node) > 0) {
+            for (NTreeNode* child : node->children()) {
+                pending.push_back(child);
+            }
+
+            continue;
+        }
+
+        // Most nodes have few children, only large directories allocate
+        NaoSmallVector<NTreeNode*, 16> keep;
+        NaoSmallVector<NTreeNode*, 16> removed;
 
         // Check all children
         for (NTreeNode* child : node->children()) {
-            // Delete them if they're not in the path
-            if (!path.contains(child)) {
-                delete child;
+            // Delete them if they're not needed
+            if (needed.count(child) > 0) {
+                keep.push_back(child);
             } else {
-                next = child;
+                removed.push_back(child);
+            }
+        }
+
+        if (std::size(removed) > 0) {
+            _release(std::begin(removed), std::end(removed));
+
+            // Cached paths may lead into the removed subtrees
+            _m_path_cache.clear();
+
+            // Remove all children
+            node->clear_children();
+
+            // Add only needed children
+            for (NTreeNode* child : keep) {
+                node->add_child(child);
+            }
+
+            // Mark this node for population
+            node->set_populated(false);
+        }
+
+        for (NTreeNode* child : keep) {
+            pending.push_back(child);
+        }
+    }
+}
+
+void NFSMPrivate::set_retention_budget(int64_t bytes) {
+    _m_retention_budget = std::max<int64_t>(bytes, 0);
+}
+
+int64_t NFSMPrivate::retention_budget() const {
+    return _m_retention_budget;
+}
+
+void NFSMPrivate::set_prefetch_enabled(bool enabled) {
+    _m_prefetch_enabled = enabled;
+
+    if (!enabled) {
+        cancel_prefetch();
+    }
+}
+
+bool NFSMPrivate::prefetch_enabled() const {
+    return _m_prefetch_enabled;
+}
+
+void NFSMPrivate::prefetch(NTreeNode* node) {
+    if (!_m_prefetch_enabled) {
+        return;
+    }
+
+    struct Candidate {
+        PrefetchTarget target;
+        bool visited;
+        int64_t size;
+    };
+
+    NaoVector<Candidate> candidates;
+
+    for (NTreeNode* child : node->children()) {
+        if (child->populated() || child->locked()) {
+            continue;
+        }
+
+        const NaoString path = child->path();
+        const bool visited = _m_history.contains(path);
+
+        if (child->is_dir()) {
+            // Only directories on disk have a plugin that doesn't depend on the parent's IO
+            if (fs::is_directory(path)) {
+                candidates.push_back({ { child->name(), path, true }, visited, -1 });
+            }
+        } else if (dynamic_cast<NaoFileIO*>(child->io())) {
+            // Shadow nodes get their own IO, so only files on disk can be prefetched
+            if (NPM.populate_plugin(child)) {
+                candidates.push_back({ { child->name(), path, false }, visited, child->io()->size() });
+            }
+        }
+    }
+
+    // Visited first, then largest first, directories last
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        if (a.visited != b.visited) {
+            return a.visited;
+        }
+
+        return a.size > b.size;
+    });
+
+    std::unique_lock lock(_m_prefetch_mutex);
+
+    // Discard results that won't be used from here
+    NaoVector<Prefetched> kept;
+
+    for (const Prefetched& result : _m_prefetched) {
+        bool wanted = false;
+
+        for (const Candidate& candidate : candidates) {
+            if (candidate.target.path == result.path) {
+                wanted = true;
+                break;
+            }
+        }
+
+        if (wanted) {
+            kept.push_back(result);
+        } else {
+            delete result.node;
+        }
+    }
+
+    _m_prefetched = std::move(kept);
+
+    _m_prefetch_parent = node;
+    _m_prefetch_queue = NaoVector<PrefetchTarget>();
+
+    for (const Candidate& candidate : candidates) {
+        if (std::size(_m_prefetch_queue) >= prefetch_limit) {
+            break;
+        }
+
+        bool done = false;
+
+        for (const Prefetched& result : _m_prefetched) {
+            if (result.path == candidate.target.path) {
+                done = true;
+                break;
+            }
+        }
+
+        if (!done) {
+            _m_prefetch_queue.push_back(candidate.target);
+        }
+    }
+
+    // Only started once there's something to prefetch
+    if (!_m_prefetch_thread.joinable() && std::size(_m_prefetch_queue) > 0) {
+        _m_prefetch_thread = std::thread(&NFSMPrivate::_prefetch_worker, this);
+    }
+
+    lock.unlock();
+
+    _m_prefetch_cond.notify_one();
+}
+
+void NFSMPrivate::cancel_prefetch() {
+    std::lock_guard lock(_m_prefetch_mutex);
+
+    _m_prefetch_parent = nullptr;
+    _m_prefetch_queue = NaoVector<PrefetchTarget>();
+}
+
+bool NFSMPrivate::adopt_prefetched(NTreeNode* node) {
+    // Children that were added in the meantime would conflict
+    if (std::size(node->children()) > 0) {
+        return false;
+    }
+
+    const NaoString path = node->path();
+    NTreeNode* shadow = nullptr;
+
+    {
+        std::lock_guard lock(_m_prefetch_mutex);
+
+        for (size_t i = 0; i < std::size(_m_prefetched); ++i) {
+            if (_m_prefetched[i].path == path) {
+                shadow = _m_prefetched[i].node;
+                _m_prefetched.erase(_m_prefetched.begin() + i);
+                break;
             }
         }
+    }
 
-        // Remove all children
-        node->clear_children();
+    if (!shadow) {
+        return false;
+    }
+
+    ndebug << "Using prefetched" << path;
+
+    std::unique_lock committing(_m_tree_mutex);
 
-        // Add only needed child
-        node->add_child(next);
+    // The children's IO's may depend on the shadow's IO, so take that as well
+    if (shadow->io()) {
+        NaoIO* old_io = node->io();
 
-        // Mark this node for population
-        node->set_populated(false);
+        const bool has_header = node->has_header();
+        const NaoBytes header = node->header();
 
-        node = next;
+        node->set_io(shadow->io());
+        shadow->set_io(nullptr);
+
+        if (has_header) {
+            node->set_header(header);
+        }
+
+        // Someone may still be reading from the old IO, delete it with the shadow
+        shadow->set_io(old_io);
+    }
+
+    for (NTreeNode* child : shadow->children()) {
+        node->add_child(child);
     }
+
+    shadow->clear_children();
+    node->set_populated(true);
+
+    committing.unlock();
+
+    NaoVector<NTreeNode*> released { shadow };
+    _release(released);
+
+    return true;
 }
 
+bool NFSMPrivate::refresh(NTreeNode* node, NaoPlugin::Changes& changes) {
+    // Nothing can refer to these anymore, unless they're locked
+    _release_detached();
+
+    NaoPlugin* plugin = NPM.populate_plugin(node);
+
+    if (!plugin) {
+        return false;
+    }
+
+    // The plugin looks for changes on its own, readers are only locked out while they're applied
+    const bool refreshed = plugin->refresh(node, changes, [this](const std::function<void()>& change) {
+        std::unique_lock committing(_m_tree_mutex);
+        change();
+    });
+
+    // Someone may still be reading from the old IO's, delete them on the next gc() or refresh
+    for (NaoIO* io : changes.replaced) {
+        NTreeNode* holder = new NTreeNode(NaoString());
+        holder->set_io(io);
+
+        _m_detached.push_back(holder);
+    }
+
+    changes.replaced = NaoVector<NaoIO*>();
+
+    if (!refreshed) {
+        return false;
+    }
+
+    if (std::size(changes.removed) == 0 && std::size(changes.modified) == 0) {
+        return true;
+    }
+
+    std::unordered_set<NTreeNode*> removed(changes.removed.begin(), changes.removed.end());
+
+    if (!removed.empty()) {
+        _m_path_cache.clear();
+    }
+
+    // Forget retained nodes that are no longer in the tree
+    for (size_t i = std::size(_m_retained); i > 0; --i) {
+        for (NTreeNode* walker = _m_retained[i - 1].node; walker; walker = walker->parent()) {
+            if (removed.count(walker) > 0) {
+                _m_retained.erase(_m_retained.begin() + (i - 1));
+                break;
+            }
+        }
+    }
+
+    // Prefetched results for changed nodes are outdated
+    NaoVector<NaoString> paths;
+
+    for (NTreeNode* child : changes.removed) {
+        paths.push_back(node->path() + child->name());
+    }
+
+    for (NTreeNode* child : changes.modified) {
+        paths.push_back(child->path());
+    }
+
+    {
+        std::lock_guard lock(_m_prefetch_mutex);
+
+        for (size_t i = std::size(_m_prefetched); i > 0; --i) {
+            if (paths.contains(_m_prefetched[i - 1].path)) {
+                delete _m_prefetched[i - 1].node;
+                _m_prefetched.erase(_m_prefetched.begin() + (i - 1));
+            }
+        }
+    }
+
+    for (NTreeNode* child : changes.removed) {
+        _m_detached.push_back(child);
+    }
+
+    return true;
+}
+
+void NFSMPrivate::_prefetch_worker() {
+#ifdef N_WINDOWS
+    // Foreground work always goes first
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#endif
+
+    std::unique_lock lock(_m_prefetch_mutex);
+
+    for (;;) {
+        _m_prefetch_cond.wait(lock, [this] {
+            return _m_prefetch_stop || std::size(_m_prefetch_queue) > 0;
+        });
+
+        if (_m_prefetch_stop) {
+            return;
+        }
+
+        const PrefetchTarget target = _m_prefetch_queue.front();
+        _m_prefetch_queue.erase(_m_prefetch_queue.begin());
+
+        NTreeNode* parent = _m_prefetch_parent;
+
+        // Keep the parent alive while we use it
+        _m_prefetch_pinned = parent;
+
+        lock.unlock();
+
+        // Populate a node that's not in the tree, so nobody else sees it until it's adopted
+        NTreeNode* shadow = new NTreeNode(target.name);
+        shadow->set_detached_parent(parent);
+
+        if (!target.dir) {
+            shadow->set_io(new NaoFileIO(target.path));
+        }
+
+        bool success = false;
+
+        try {
+            NaoPlugin* plugin = NPM.populate_plugin(shadow);
+
+            success = plugin && plugin->populate(shadow) && shadow->populated();
+        } catch (const std::exception& e) {
+            nwarn << "Prefetching" << target.path << "failed:" << e.what();
+        }
+
+        lock.lock();
+
+        _m_prefetch_pinned = nullptr;
+
+        // Finished results are kept after cancelling, they may still be adopted
+        if (success && !_m_prefetch_stop) {
+            ndebug << "Prefetched" << target.path;
+
+            _m_prefetched.push_back({ target.path, shadow });
+        } else {
+            delete shadow;
+        }
+    }
+}
+
+void NFSMPrivate::_touch() {
+    NTreeNode* current = _m_current;
+
+    for (size_t i = 0; i < std::size(_m_retained); ++i) {
+        if (_m_retained[i].node == current) {
+            _m_retained.erase(_m_retained.begin() + i);
+            break;
+        }
+    }
+
+    // Costs are estimated by gc()
+    _m_retained.push_back({ current, 0 });
+
+    const NaoString path = current->path();
+    const size_t index = _m_history.index_of(path);
+
+    if (index != size_t(-1)) {
+        _m_history.erase(_m_history.begin() + index);
+    } else if (std::size(_m_history) >= history_size) {
+        _m_history.erase(_m_history.begin());
+    }
+
+    _m_history.push_back(path);
+}
+
+int64_t NFSMPrivate::_retained_cost(NTreeNode* node) {
+    auto node_cost = [](NTreeNode* current) {
+        return int64_t(sizeof(NTreeNode)
+            + std::size(current->name())
+            + std::size(current->header())
+            + (current->io() ? io_cost : 0));
+    };
+
+    // Anything below the children is either retained on its own or released by gc()
+    int64_t cost = node_cost(node) + std::size(node->children()) * sizeof(NTreeNode*);
+
+    for (NTreeNode* child : node->children()) {
+        cost += node_cost(child);
+    }
+
+    return cost;
+}
+
+void NFSMPrivate::_release_detached() {
+    // Nodes that are locked and everything they're in
+    std::unordered_set<NTreeNode*> in_use;
+
+    {
+        std::lock_guard lock(_m_locked_mutex);
+
+        for (NTreeNode* locked : _m_locked) {
+            for (NTreeNode* node = locked; node && in_use.insert(node).second; node = node->parent()) { }
+        }
+    }
+
+    NaoVector<NTreeNode*> kept;
+    NaoVector<NTreeNode*> released;
+
+    for (NTreeNode* node : _m_detached) {
+        if (in_use.count(node) > 0) {
+            kept.push_back(node);
+        } else {
+            released.push_back(node);
+        }
+    }
+
+    _release(released);
+    _m_detached = std::move(kept);
+}
+
+void NFSMPrivate::_release(const NaoVector<NTreeNode*>& nodes) {
+    _release(std::begin(nodes), std::end(nodes));
+}
+
+void NFSMPrivate::_release(NTreeNode* const* first, NTreeNode* const* last) {
+    if (first == last) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(_m_release_mutex);
+
+        for (; first != last; ++first) {
+            _m_release_queue.push_back(*first);
+        }
+    }
+
+    _m_release_cond.notify_one();
+}
+
+void NFSMPrivate::_release_worker() {
+    std::unique_lock lock(_m_release_mutex);
+
+    for (;;) {
+        _m_release_cond.wait(lock, [this] {
+            return _m_release_stop || std::size(_m_release_queue) > 0;
+        });
+
+        if (std::size(_m_release_queue) > 0) {
+            NaoVector<NTreeNode*> nodes = std::move(_m_release_queue);
+            _m_release_queue = NaoVector<NTreeNode*>();
+
+            // Don't block gc() while deleting
+            lock.unlock();
+
+            for (NTreeNode* node : nodes) {
+                delete node;
+            }
+
+            lock.lock();
+        } else if (_m_release_stop) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,161 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Functionality/NaoGlob.h"
+
+#include "Functionality/NaoHash.h"
+
+#include <algorithm>
+
+// Lowercase with a single separator, so patterns and paths compare directly
+static char normalise(char c) {
+    return (c == '\\') ? '/' : NaoHash::to_lower(c);
+}
+
+// Matches a set starting after the '[', advances p past the closing ']'
+static bool match_set(const char*& p, const char* pe, char c) {
+    const bool negate = (*p == '!' || *p == '^');
+    if (negate) {
+        ++p;
+    }
+
+    bool matched = false;
+
+    // A ']' directly after the '[' is a regular member
+    for (bool first = true; p != pe && (first || *p != ']'); first = false) {
+        const char low = *p++;
+
+        if (p + 1 < pe && *p == '-' && p[1] != ']') {
+            const char high = p[1];
+            p += 2;
+
+            matched |= (c >= low && c <= high);
+        } else {
+            matched |= (c == low);
+        }
+    }
+
+    // Skip the ']'
+    if (p != pe) {
+        ++p;
+    }
+
+    return matched != negate;
+}
+
+static bool glob_match(const char* p, const char* pe, const char* s, const char* se) {
+    while (p != pe) {
+        if (*p == '*') {
+            if (p + 1 != pe && p[1] == '*') {
+                const char* rest = p + 2;
+
+                // "**/" may also match no directories at all
+                if (rest != pe && *rest == '/' && glob_match(rest + 1, pe, s, se)) {
+                    return true;
+                }
+
+                for (const char* t = s; ; ++t) {
+                    if (glob_match(rest, pe, t, se)) {
+                        return true;
+                    }
+
+                    if (t == se) {
+                        return false;
+                    }
+                }
+            }
+
+            ++p;
+
+            // A single star stops at separators
+            for (const char* t = s; ; ++t) {
+                if (glob_match(p, pe, t, se)) {
+                    return true;
+                }
+
+                if (t == se || normalise(*t) == '/') {
+                    return false;
+                }
+            }
+        }
+
+        if (s == se) {
+            return false;
+        }
+
+        const char c = normalise(*s);
+
+        if (*p == '?') {
+            if (c == '/') {
+                return false;
+            }
+
+            ++p;
+        } else if (*p == '[' && std::find(p + 1, pe, ']') != pe) {
+            ++p;
+
+            if (c == '/' || !match_set(p, pe, c)) {
+                return false;
+            }
+        } else {
+            if (*p != c) {
+                return false;
+            }
+
+            ++p;
+        }
+
+        ++s;
+    }
+
+    return s == se;
+}
+
+NaoGlob::NaoGlob(const NaoString& pattern)
+    : _m_pattern(pattern) {
+
+    for (char& c : _m_pattern) {
+        c = normalise(c);
+    }
+
+    _m_basename = !_m_pattern.contains('/');
+}
+
+bool NaoGlob::matches(const NaoString& path) const {
+    return matches(path.c_str(), std::size(path));
+}
+
+bool NaoGlob::matches(const char* path, size_t size) const {
+    const char* end = path + size;
+
+    if (_m_basename) {
+        for (const char* c = end; c != path; --c) {
+            if (c[-1] == '/' || c[-1] == '\\') {
+                path = c;
+                break;
+            }
+        }
+    }
+
+    const char* pattern = _m_pattern.c_str();
+
+    return glob_match(pattern, pattern + std::size(_m_pattern), path, end);
+}
+
+const NaoString& NaoGlob::pattern() const {
+    return _m_pattern;
+}
@@ -0,0 +1,96 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Functionality/NaoParallel.h"
+
+#include <chrono>
+#include <deque>
+
+// Threads that were idle for this long exit
+static constexpr std::chrono::seconds idle_timeout = std::chrono::seconds(30);
+
+class NaoThreadPool {
+    public:
+    void submit(std::function<void()> task) {
+        std::unique_lock lock(_m_mutex);
+
+        _m_tasks.push_back(std::move(task));
+
+        if (_m_idle >= std::size(_m_tasks)) {
+            lock.unlock();
+            _m_cond.notify_one();
+            return;
+        }
+
+        ++_m_threads;
+
+        // Detached, the pool is never destroyed
+        std::thread(&NaoThreadPool::_worker, this).detach();
+    }
+
+    size_t size() {
+        std::lock_guard lock(_m_mutex);
+        return _m_threads;
+    }
+
+    private:
+    void _worker() {
+        std::unique_lock lock(_m_mutex);
+
+        for (;;) {
+            if (_m_tasks.empty()) {
+                ++_m_idle;
+                const bool woken = _m_cond.wait_for(lock, idle_timeout, [this] { return !_m_tasks.empty(); });
+                --_m_idle;
+
+                if (!woken) {
+                    --_m_threads;
+                    return;
+                }
+            }
+
+            std::function<void()> task = std::move(_m_tasks.front());
+            _m_tasks.pop_front();
+
+            lock.unlock();
+            task();
+            task = nullptr;
+            lock.lock();
+        }
+    }
+
+    std::mutex _m_mutex;
+    std::condition_variable _m_cond;
+    std::deque<std::function<void()>> _m_tasks;
+
+    size_t _m_threads = 0;
+    size_t _m_idle = 0;
+};
+
+// Never destroyed, so idle threads can't outlive it while the process exits
+static NaoThreadPool& pool() {
+    static NaoThreadPool* pool = new NaoThreadPool();
+    return *pool;
+}
+
+void NaoParallel::submit(std::function<void()> task) {
+    pool().submit(std::move(task));
+}
+
+size_t NaoParallel::pool_size() {
+    return pool().size();
+}
@@ -0,0 +1,126 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Functionality/NaoPathFilter.h"
+
+#define N_LOG_ID "NaoPathFilter"
+#include "Logging/NaoLogging.h"
+#include "Functionality/NaoGlob.h"
+
+#include <algorithm>
+#include <regex>
+#include <string>
+#include <vector>
+
+struct NaoPathFilter::NPFPrivate {
+    std::vector<NaoGlob> include_globs;
+    std::vector<NaoGlob> exclude_globs;
+
+    std::vector<std::regex> include_regexes;
+    std::vector<std::regex> exclude_regexes;
+
+    bool has_regexes() const {
+        return !include_regexes.empty() || !exclude_regexes.empty();
+    }
+
+    static bool compile(const NaoString& pattern, std::vector<std::regex>& target) {
+        try {
+            target.emplace_back(pattern.c_str(), std::size(pattern),
+                std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+        } catch (const std::regex_error& e) {
+            nerr << "Invalid regex" << pattern << ':' << e.what();
+            return false;
+        }
+
+        return true;
+    }
+};
+
+NaoPathFilter::NaoPathFilter()
+    : d_ptr(new NPFPrivate()) {
+
+}
+
+NaoPathFilter::NaoPathFilter(const NaoPathFilter& other)
+    : d_ptr(new NPFPrivate(*other.d_ptr)) {
+
+}
+
+NaoPathFilter& NaoPathFilter::operator=(const NaoPathFilter& other) {
+    if (this != &other) {
+        *d_ptr = *other.d_ptr;
+    }
+
+    return *this;
+}
+
+NaoPathFilter::~NaoPathFilter() {
+    delete d_ptr;
+}
+
+void NaoPathFilter::include(const NaoString& glob) {
+    d_ptr->include_globs.emplace_back(glob);
+}
+
+void NaoPathFilter::exclude(const NaoString& glob) {
+    d_ptr->exclude_globs.emplace_back(glob);
+}
+
+bool NaoPathFilter::include_regex(const NaoString& regex) {
+    return NPFPrivate::compile(regex, d_ptr->include_regexes);
+}
+
+bool NaoPathFilter::exclude_regex(const NaoString& regex) {
+    return NPFPrivate::compile(regex, d_ptr->exclude_regexes);
+}
+
+bool NaoPathFilter::empty() const {
+    return d_ptr->include_globs.empty() && d_ptr->exclude_globs.empty() && !d_ptr->has_regexes();
+}
+
+bool NaoPathFilter::matches(const NaoString& path) const {
+    return matches(path.c_str(), std::size(path));
+}
+
+bool NaoPathFilter::matches(const char* path, size_t size) const {
+    auto glob_matches = [path, size](const NaoGlob& glob) {
+        return glob.matches(path, size);
+    };
+
+    // Regexes see '/' on every platform, the copy is reused by this thread
+    thread_local std::string normalised;
+
+    if (d_ptr->has_regexes()) {
+        normalised.assign(path, size);
+        std::replace(std::begin(normalised), std::end(normalised), '\\', '/');
+    }
+
+    auto regex_matches = [](const std::regex& regex) {
+        return std::regex_match(normalised, regex);
+    };
+
+    const bool no_includes = d_ptr->include_globs.empty() && d_ptr->include_regexes.empty();
+
+    if (!no_includes
+        && std::none_of(std::begin(d_ptr->include_globs), std::end(d_ptr->include_globs), glob_matches)
+        && std::none_of(std::begin(d_ptr->include_regexes), std::end(d_ptr->include_regexes), regex_matches)) {
+        return false;
+    }
+
+    return std::none_of(std::begin(d_ptr->exclude_globs), std::end(d_ptr->exclude_globs), glob_matches)
+        && std::none_of(std::begin(d_ptr->exclude_regexes), std::end(d_ptr->exclude_regexes), regex_matches);
+}
@@ -20,8 +20,14 @@
 #define N_LOG_ID "NaoChunkIO"
 #include "Logging/NaoLogging.h"
 
+#include <atomic>
+
 struct NaoChunkIO::NCIChunksWrapper {
     NaoVector<Chunk> m_chunks;
+
+    // Last chunk that was read from, most reads are sequential.
+    // Only a hint, but positional reads may come from several threads.
+    std::atomic<int64_t> m_current_index = 0;
 };
 
 //// Public
@@ -33,40 +39,30 @@ bool NaoChunkIO::Chunk::operator==(const Chunk& other) const {
 }
 
 NaoChunkIO::NaoChunkIO(NaoIO* io, const Chunk& chunk)
-    : NaoIO(chunk.size)
-    , _m_io(io)
-    , _m_nci(new NCIChunksWrapper())
-    , _m_pos(-1)
-    , _m_current_index(0)
-    {
-
-    _m_nci->m_chunks.push_back(chunk);
+    : NaoChunkIO(io, NaoVector<Chunk>({ chunk })) {
 
-    _m_current_chunk = std::begin(_m_nci->m_chunks);
-    _m_bytes_left = _m_nci->m_chunks.at(0).size;
-
-    set_size(_m_nci->m_chunks.at(0).size);
 }
 
 NaoChunkIO::NaoChunkIO(NaoIO* io, const NaoVector<Chunk>& chunks)
     : _m_io(io)
     , _m_nci(new NCIChunksWrapper())
-    , _m_pos(-1)
-    , _m_current_index(0)
+    , _m_pos(0)
     {
 
-    int64_t size = 0;
-
-    _m_nci->m_chunks.reserve(std::size(chunks));
+    _add_chunks(io, chunks);
 
-    for (const Chunk& chunk : chunks) {
+    int64_t size = 0;
+    for (const Chunk& chunk : _m_nci->m_chunks) {
         size += chunk.size;
-        _m_nci->m_chunks.push_back(chunk);
     }
 
-    _m_current_chunk = std::begin(_m_nci->m_chunks);
-    _m_bytes_left = _m_current_chunk->size;
+    set_size(size);
+}
+
+NaoChunkIO::~NaoChunkIO() {
+    delete _m_nci;
 }
+
 int64_t NaoChunkIO::pos() const {
     return _m_pos;
 }
@@ -93,64 +89,69 @@ bool NaoChunkIO::seek(int64_t pos, SeekDir dir) {
             break;
     }
 
-    if (target_pos == _m_pos) {
-        return true;
-    }
-
-    if (target_pos >= size()) {
+    if (target_pos < 0 || target_pos > size()) {
         nerr << "Position out of range";
         return false;
     }
 
-    if (std::size(_m_nci->m_chunks) > 1) {
-        _set_chunk(std::find_if(std::begin(_m_nci->m_chunks), std::end(_m_nci->m_chunks),
-            [target_pos](const Chunk& chunk) -> bool {
-            return chunk.pos + chunk.size > target_pos;
-        }));
-    }
-
-    _m_bytes_left = _m_current_chunk->size - (target_pos - _m_current_chunk->pos);
-
-    if (!_m_io->seek(_m_current_chunk->start + (target_pos - _m_current_chunk->pos))) {
-        nerr << "Internal io seek failed";
-        return false;
-    }
-
+    // Nothing to do on the root IO, reads are positional
     _m_pos = target_pos;
 
     return true;
-    
 }
 
 int64_t NaoChunkIO::read(char* buf, int64_t size) {
-
     if (!is_open()) {
-        return false;
+        return -1;
+    }
+
+    const int64_t read = read_at(_m_pos, buf, size);
+
+    if (read > 0) {
+        _m_pos += read;
     }
 
-    if (_m_pos == -1) {
-        nerr << "Perform a seek before reading";
+    return read;
+}
+
+int64_t NaoChunkIO::read_at(int64_t pos, char* buf, int64_t size) {
+    if (pos < 0 || pos > NaoIO::size()) {
+        nerr << "Position out of range";
         return -1;
     }
 
-    int64_t remaining = size;
+    const NaoVector<Chunk>& chunks = _m_nci->m_chunks;
+
+    int64_t remaining = std::min(size, NaoIO::size() - pos);
+    int64_t index = _chunk_index(pos);
     char* data = buf;
 
-    while (remaining > 0) {
-        int64_t read_this_time = (remaining > _m_bytes_left) ? _m_bytes_left : remaining;
+    while (remaining > 0 && index < int64_t(std::size(chunks))) {
+        const Chunk& chunk = chunks[index];
 
-        _m_io->read(data, read_this_time);
+        const int64_t offset = pos - chunk.pos;
+        const int64_t read_this_time = std::min(remaining, chunk.size - offset);
 
-        data += read_this_time;
-        _m_pos += read_this_time;
-        remaining -= read_this_time;
-        _m_bytes_left -= read_this_time;
+        const int64_t read = _m_io->read_at(chunk.start + offset, data, read_this_time);
 
-        if (_m_bytes_left == 0 && _m_pos != NaoIO::size()) {
-            _set_chunk(&_m_nci->m_chunks[_m_nci->m_chunks.index_of(*_m_current_chunk) + 1]);
+        if (read <= 0) {
+            break;
+        }
+
+        data += read;
+        pos += read;
+        remaining -= read;
+
+        if (read != read_this_time) {
+            nerr << "Short read from underlying IO";
+            break;
         }
+
+        ++index;
     }
 
+    _m_nci->m_current_index.store(std::max<int64_t>(index - 1, 0), std::memory_order_relaxed);
+
     return data - buf;
 }
 
@@ -183,13 +184,98 @@ void NaoChunkIO::close() {
     NaoIO::close();
 }
 
+NaoIO* NaoChunkIO::root() const {
+    return _m_io;
+}
+
+const NaoVector<NaoChunkIO::Chunk>& NaoChunkIO::chunks() const {
+    return _m_nci->m_chunks;
+}
+
 //// Private
 
-void NaoChunkIO::_set_chunk(Chunk* chunk) {
-    _m_current_chunk = chunk;
-    _m_current_index = _m_nci->m_chunks.index_of(*chunk);
-    _m_bytes_left = _m_current_chunk->size;
+void NaoChunkIO::_add_chunks(NaoIO* io, const NaoVector<Chunk>& chunks) {
+    NaoChunkIO* parent = dynamic_cast<NaoChunkIO*>(io);
+
+    if (!parent) {
+        _m_nci->m_chunks.reserve(std::size(chunks));
+
+        int64_t pos = 0;
+        for (const Chunk& chunk : chunks) {
+            _m_nci->m_chunks.push_back({ chunk.start, chunk.size, pos });
+            pos += chunk.size;
+        }
+
+        return;
+    }
+
+    // Translate every chunk to the parent's root, splitting where it crosses parent chunks
+    _m_io = parent->_m_io;
+
+    const NaoVector<Chunk>& parent_chunks = parent->_m_nci->m_chunks;
+
+    int64_t pos = 0;
+    for (const Chunk& chunk : chunks) {
+        int64_t start = chunk.start;
+        int64_t remaining = chunk.size;
+
+        if (start < 0 || start + remaining > parent->size()) {
+            nerr << "Chunk exceeds parent size";
+            remaining = std::max<int64_t>(std::min(remaining, parent->size() - start), 0);
+        }
+
+        int64_t index = parent->_chunk_index(start);
 
-    _m_io->seek(_m_current_chunk->start);
+        while (remaining > 0 && index < int64_t(std::size(parent_chunks))) {
+            const Chunk& parent_chunk = parent_chunks[index];
+
+            const int64_t offset = start - parent_chunk.pos;
+            const int64_t size = std::min(remaining, parent_chunk.size - offset);
+            const int64_t root_start = parent_chunk.start + offset;
+
+            // Merge with the previous chunk if they're contiguous on the root
+            if (!std::empty(_m_nci->m_chunks)
+                && _m_nci->m_chunks.back().start + _m_nci->m_chunks.back().size == root_start) {
+                _m_nci->m_chunks.back().size += size;
+            } else {
+                _m_nci->m_chunks.push_back({ root_start, size, pos });
+            }
+
+            pos += size;
+            start += size;
+            remaining -= size;
+            ++index;
+        }
+    }
 }
 
+int64_t NaoChunkIO::_chunk_index(int64_t pos) const {
+    const NaoVector<Chunk>& chunks = _m_nci->m_chunks;
+
+    if (std::empty(chunks)) {
+        return 0;
+    }
+
+    // Most reads continue where the previous one ended
+    const int64_t current_index = _m_nci->m_current_index.load(std::memory_order_relaxed);
+
+    if (current_index < int64_t(std::size(chunks))) {
+        const Chunk& current = chunks[current_index];
+
+        if (pos >= current.pos && pos < current.pos + current.size) {
+            return current_index;
+        }
+
+        if (current_index + 1 < int64_t(std::size(chunks))
+            && pos >= current.pos + current.size
+            && pos < chunks[current_index + 1].pos + chunks[current_index + 1].size) {
+            return current_index + 1;
+        }
+    }
+
+    // Chunks are sorted by pos
+    auto it = std::upper_bound(std::begin(chunks), std::end(chunks), pos,
+        [](int64_t value, const Chunk& chunk) { return value < chunk.pos; });
+
+    return std::max<int64_t>((it - std::begin(chunks)) - 1, 0);
+}
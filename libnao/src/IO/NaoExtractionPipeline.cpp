@@ -0,0 +1,809 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "IO/NaoExtractionPipeline.h"
+
+#define N_LOG_ID "NaoExtractionPipeline"
+#include "Logging/NaoLogging.h"
+#include "Containers/NaoBoundedQueue.h"
+#include "Containers/NaoVector.h"
+#include "Functionality/NaoParallel.h"
+#include "IO/NaoChunkIO.h"
+#include "IO/NaoFileIO.h"
+#include "Decoding/NaoDecodingException.h"
+#include "Decoding/Archives/NaoArchiveFormat.h"
+#include "Decoding/Compression/NaoCRILAYLA.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Limits the number of bytes held in buffers and expanded archives at once
+class NEPBudget {
+    public:
+    explicit NEPBudget(int64_t budget)
+        : _m_budget(budget)
+        , _m_in_flight(0)
+        , _m_reserved(0)
+        , _m_cancelled(false) { }
+
+    // A block is let through when no other blocks are buffered, so it can't block forever,
+    // not even when reserved memory alone exceeds the budget. Fails without acquiring anything once cancelled.
+    bool acquire(int64_t size) {
+        std::unique_lock lock(_m_mutex);
+
+        _m_cond.wait(lock, [this, size] { return _fits(size); });
+
+        if (_m_cancelled) {
+            return false;
+        }
+
+        _m_in_flight += size;
+        return true;
+    }
+
+    void release(int64_t size) {
+        {
+            std::lock_guard lock(_m_mutex);
+            _m_in_flight -= size;
+        }
+
+        _m_cond.notify_all();
+    }
+
+    // Like acquire(), for memory that is held until the entries read from it are done. Only waits for
+    // buffered blocks, which are freed without needing a reader, so readers never wait on each other.
+    bool reserve(int64_t size) {
+        std::unique_lock lock(_m_mutex);
+
+        _m_cond.wait(lock, [this, size] { return _fits(size); });
+
+        if (_m_cancelled) {
+            return false;
+        }
+
+        _m_reserved += size;
+        return true;
+    }
+
+    void unreserve(int64_t size) {
+        {
+            std::lock_guard lock(_m_mutex);
+            _m_reserved -= size;
+        }
+
+        _m_cond.notify_all();
+    }
+
+    // Wake every thread waiting in acquire(), which fails from now on
+    void cancel() {
+        {
+            std::lock_guard lock(_m_mutex);
+            _m_cancelled = true;
+        }
+
+        _m_cond.notify_all();
+    }
+
+    private:
+    bool _fits(int64_t size) const {
+        return _m_cancelled || _m_in_flight == 0 || _m_in_flight + _m_reserved + size <= _m_budget;
+    }
+
+    const int64_t _m_budget;
+    int64_t _m_in_flight;
+    int64_t _m_reserved;
+    bool _m_cancelled;
+
+    std::mutex _m_mutex;
+    std::condition_variable _m_cond;
+};
+
+/*
+ * Lets idle stages sleep until something they wait for may have changed. A waiter
+ * takes the epoch before checking for work and sleeps until it changes, so a
+ * notification that comes in between is never lost. Notifying without waiters
+ * doesn't lock.
+ */
+class NEPSignal {
+    public:
+    N_NODISCARD uint64_t epoch() const {
+        return _m_epoch;
+    }
+
+    void wait(uint64_t epoch) {
+        std::unique_lock lock(_m_mutex);
+
+        ++_m_waiting;
+        _m_cond.wait(lock, [this, epoch] { return _m_epoch != epoch; });
+        --_m_waiting;
+    }
+
+    void notify_one() {
+        ++_m_epoch;
+
+        if (_m_waiting > 0) {
+            std::lock_guard lock(_m_mutex);
+            _m_cond.notify_one();
+        }
+    }
+
+    void notify_all() {
+        ++_m_epoch;
+
+        if (_m_waiting > 0) {
+            std::lock_guard lock(_m_mutex);
+            _m_cond.notify_all();
+        }
+    }
+
+    private:
+    std::atomic<uint64_t> _m_epoch = 0;
+    std::atomic<size_t> _m_waiting = 0;
+
+    std::mutex _m_mutex;
+    std::condition_variable _m_cond;
+};
+
+struct NaoExtractionPipeline::NEPPrivate {
+    // An expanded archive, freed as soon as every entry read from it is finished
+    struct Nested {
+        NaoIO* io;
+
+        // Unfinished entries in the archive, including archives expanded from it
+        std::atomic<size_t> refs;
+
+        // Decompressed size reserved from the budget, archives read in place cost nothing
+        int64_t reserved;
+
+        // Archive this one was read from, if any
+        Nested* parent;
+    };
+
+    // An entry that was read and is waiting for the next stage
+    struct Item {
+        Entry entry;
+        NaoBytes data;
+
+        // Size of the source, as acquired from the budget
+        int64_t size;
+
+        // Archive the entry is read from
+        Nested* archive;
+    };
+
+    explicit NEPPrivate(const Config& config)
+        : config(config)
+        , budget(std::max<int64_t>(config.byte_budget, 1))
+        , transform_queue(config.queue_capacity)
+        , write_queue(config.queue_capacity) { }
+
+    // A submitted entry, with the number of archives it is nested in
+    struct Job {
+        Entry entry;
+        size_t depth;
+
+        // Expanded archive the entry is in, holds a reference to it
+        Nested* archive;
+    };
+
+    Config config;
+
+    // Entries that weren't picked up by a reader yet
+    std::mutex pending_mutex;
+    std::deque<Job> pending;
+    size_t count = 0;
+    std::atomic<int64_t> total_size = 0;
+
+    // Submitted entries that haven't finished yet, nothing is left to do when this reaches 0
+    std::atomic<size_t> outstanding = 0;
+
+    NEPBudget budget;
+    NaoBoundedQueue<Item*> transform_queue;
+    NaoBoundedQueue<Item*> write_queue;
+
+    // Signalled when there is new work for a stage, and when a queue has room again
+    NEPSignal pending_signal;
+    NEPSignal transform_signal;
+    NEPSignal write_signal;
+    NEPSignal transform_space;
+    NEPSignal write_space;
+
+    // Root IOs that were opened for reading by the pipeline
+    std::mutex roots_mutex;
+    NaoVector<NaoIO*> opened_roots;
+
+    // Expanded archives that are still in use, only left over after cancelling
+    std::mutex nested_mutex;
+    std::unordered_set<Nested*> nested;
+
+    std::atomic<bool> cancelled = false;
+    std::atomic<size_t> failed = 0;
+    std::atomic<size_t> expanded = 0;
+    std::atomic<size_t> skipped = 0;
+    std::atomic<int64_t> done_bytes = 0;
+    std::atomic<int64_t> written = 0;
+
+    ~NEPPrivate() {
+        for (Nested* archive : nested) {
+            delete archive->io;
+            delete archive;
+        }
+    }
+
+    void submit(const Entry& entry, size_t depth) {
+        const int64_t size = (entry.size < 0) ? std::max<int64_t>(entry.source->size() - entry.offset, 0) : entry.size;
+
+        // Counted first, so a reader finishing it right away can't end the run early
+        total_size += size;
+        ++outstanding;
+
+        {
+            std::lock_guard lock(pending_mutex);
+            pending.push_back({ entry, depth, nullptr });
+            pending.back().entry.size = size;
+            ++count;
+        }
+
+        pending_signal.notify_one();
+    }
+
+    // Queue the files of an expanded archive ahead of everything else, so it can be freed as soon as possible
+    void submit_nested(std::vector<Job>& jobs) {
+        for (const Job& job : jobs) {
+            total_size += job.entry.size;
+        }
+
+        outstanding += std::size(jobs);
+
+        {
+            std::lock_guard lock(pending_mutex);
+            pending.insert(pending.begin(), std::make_move_iterator(jobs.begin()), std::make_move_iterator(jobs.end()));
+            count += std::size(jobs);
+        }
+
+        pending_signal.notify_all();
+    }
+
+    bool take(Job& job) {
+        std::lock_guard lock(pending_mutex);
+
+        if (pending.empty()) {
+            return false;
+        }
+
+        job = std::move(pending.front());
+        pending.pop_front();
+
+        return true;
+    }
+
+    void finish(const Entry& entry, Nested* archive, bool success) {
+        if (!success) {
+            ++failed;
+        }
+
+        done_bytes += entry.size;
+        release(archive);
+        retire();
+    }
+
+    // Drop a reference to an expanded archive, freeing it and then its parents once they're unused
+    void release(Nested* archive) {
+        while (archive && --archive->refs == 0) {
+            Nested* parent = archive->parent;
+
+            {
+                std::lock_guard lock(nested_mutex);
+                nested.erase(archive);
+            }
+
+            delete archive->io;
+            budget.unreserve(archive->reserved);
+
+            delete archive;
+            archive = parent;
+        }
+    }
+
+    // An entry is out of the pipeline, every stage stops once none are left
+    void retire() {
+        if (--outstanding == 0) {
+            wake_all();
+        }
+    }
+
+    void wake_all() {
+        pending_signal.notify_all();
+        transform_signal.notify_all();
+        write_signal.notify_all();
+        transform_space.notify_all();
+        write_space.notify_all();
+    }
+
+    void cancel() {
+        cancelled = true;
+
+        budget.cancel();
+        wake_all();
+    }
+
+    // Reads go to the root IO, which only reads positionally while open
+    void open_root(NaoIO* source) {
+        NaoChunkIO* chunk = dynamic_cast<NaoChunkIO*>(source);
+        NaoIO* root = chunk ? chunk->root() : source;
+
+        std::lock_guard lock(roots_mutex);
+
+        if (!root->is_open()) {
+            if (root->open()) {
+                opened_roots.push_back(root);
+            } else {
+                nwarn << "Failed to open source";
+            }
+        }
+    }
+
+    // Queue the files in the archive in job, returns false if it isn't an archive or it couldn't be read.
+    // The job's reference to the archive it's in is handed to the expanded archive.
+    bool expand(const Job& job) {
+        const Entry& entry = job.entry;
+
+        NaoIO* io = nullptr;
+        NaoVector<NaoArchiveIndexCache::Entry> index;
+
+        try {
+            io = NaoArchiveFormat::open(entry.source, entry.offset, entry.size);
+
+            if (!io) {
+                return false;
+            }
+
+            index = NaoArchiveFormat::index(io, NaoArchiveFormat::detect(io));
+        } catch (const NaoDecodingException& e) {
+            nwarn << "Extracting unreadable nested archive" << entry.target << "as-is:" << e.what();
+            delete io;
+            return false;
+        }
+
+        // Decompressed archives stay in memory until all of their files are done
+        const int64_t reserved = dynamic_cast<NaoChunkIO*>(io) ? 0 : io->size();
+
+        if (reserved > 0 && !budget.reserve(reserved)) {
+            delete io;
+            return false;
+        }
+
+        // The archive becomes a directory with the same (cleaned) name
+        const NaoString dir = NaoArchiveFormat::expanded_path(entry.target);
+        const NaoString path = std::empty(entry.path) ? NaoString() : NaoArchiveFormat::expanded_path(entry.path);
+
+        Nested* archive = new Nested { io, 0, reserved, job.archive };
+        std::vector<Job> jobs;
+
+        for (const NaoArchiveIndexCache::Entry& item : index) {
+            // Directories are implied by the paths of their children
+            if (item.is_dir) {
+                continue;
+            }
+
+            jobs.push_back({ {
+                io,
+                dir + N_PATHSEP + item.name,
+                (item.binary_size != item.real_size) ? Transform(NaoCRILAYLA::decompress_in_place) : nullptr,
+                item.offset,
+                item.binary_size,
+                std::empty(path) ? NaoString() : (path + N_PATHSEP + item.name)
+            }, job.depth + 1, archive });
+        }
+
+        ++expanded;
+
+        // An empty archive is done right away
+        if (std::empty(jobs)) {
+            archive->refs = 1;
+            release(archive);
+            return true;
+        }
+
+        archive->refs = std::size(jobs);
+
+        {
+            std::lock_guard lock(nested_mutex);
+            nested.insert(archive);
+        }
+
+        submit_nested(jobs);
+        return true;
+    }
+
+    bool done() const {
+        return cancelled || outstanding == 0;
+    }
+
+    // Hand an item to the next stage, waiting for room in its queue
+    void push(NaoBoundedQueue<Item*>& queue, NEPSignal& items, NEPSignal& space, Item* item) {
+        for (;;) {
+            const uint64_t epoch = space.epoch();
+
+            if (cancelled) {
+                discard(item);
+                return;
+            }
+
+            if (queue.try_push(item)) {
+                items.notify_one();
+                return;
+            }
+
+            space.wait(epoch);
+        }
+    }
+
+    // Take an item for this stage, waiting until there is one, returns false once the stage should stop
+    bool pop(NaoBoundedQueue<Item*>& queue, NEPSignal& items, NEPSignal& space, Item*& item) {
+        for (;;) {
+            const uint64_t epoch = items.epoch();
+
+            if (done()) {
+                return false;
+            }
+
+            if (queue.try_pop(item)) {
+                space.notify_one();
+                return true;
+            }
+
+            items.wait(epoch);
+        }
+    }
+
+    // Drop an item that won't be finished, giving back its budget
+    void discard(Item* item) {
+        budget.release(item->size);
+        delete item;
+    }
+
+    // After cancelling, readers may still wait for the budget held by items nobody will take anymore
+    void discard_all(NaoBoundedQueue<Item*>& queue) {
+        Item* item;
+        while (queue.try_pop(item)) {
+            discard(item);
+        }
+    }
+
+    bool write(const NaoString& target, const char* data, int64_t size) {
+        std::error_code ec;
+        fs::create_directories(fs::path(target).parent_path(), ec);
+
+        NaoFileIO output(target, 0);
+
+        if (!output.open(NaoIO::WriteOnly)) {
+            nerr << "Failed opening output" << target;
+            return false;
+        }
+
+        if (output.write(data, size) != size) {
+            nerr << "Failed writing" << target;
+            return false;
+        }
+
+        written += size;
+        return true;
+    }
+
+    // Copy an entry in blocks, without holding all of it in memory
+    bool stream(const Entry& entry) {
+        std::error_code ec;
+        fs::create_directories(fs::path(entry.target).parent_path(), ec);
+
+        NaoFileIO output(entry.target, 0);
+
+        if (!output.open(NaoIO::WriteOnly)) {
+            nerr << "Failed opening output" << entry.target;
+            return false;
+        }
+
+        const int64_t size = entry.size;
+        std::vector<char> buffer(size_t(std::min<int64_t>(size, max_block)));
+
+        for (int64_t pos = 0; pos < size && !cancelled;) {
+            const int64_t block = std::min<int64_t>(size - pos, max_block);
+
+            if (!budget.acquire(block)) {
+                return false;
+            }
+
+            const int64_t read = entry.source->read_at(entry.offset + pos, std::data(buffer), block);
+            const int64_t write = (read == block) ? output.write(std::data(buffer), block) : -1;
+
+            budget.release(block);
+
+            if (read != block) {
+                nerr << "Failed reading source for" << entry.target;
+                return false;
+            }
+
+            if (write != block) {
+                nerr << "Failed writing" << entry.target;
+                return false;
+            }
+
+            pos += block;
+            written += block;
+        }
+
+        return !cancelled;
+    }
+
+    void reader() {
+        Job job;
+
+        for (;;) {
+            const uint64_t epoch = pending_signal.epoch();
+
+            if (done()) {
+                break;
+            }
+
+            if (!take(job)) {
+                pending_signal.wait(epoch);
+                continue;
+            }
+
+            Entry& entry = job.entry;
+
+            open_root(entry.source);
+
+            // Files in the archive are queued before the archive itself finishes, so the run can't end early.
+            // They are counted instead of the archive.
+            if (config.expand_archives && job.depth < config.max_depth && expand(job)) {
+                total_size -= entry.size;
+                retire();
+                continue;
+            }
+
+            if (!std::empty(entry.path) && !config.filter.matches(entry.path)) {
+                ++skipped;
+                finish(entry, job.archive, true);
+                continue;
+            }
+
+            const int64_t size = entry.size;
+
+            if (!entry.transform && size > max_block) {
+                finish(entry, job.archive, stream(entry));
+                continue;
+            }
+
+            if (!budget.acquire(size)) {
+                finish(entry, job.archive, false);
+                continue;
+            }
+
+            Item* item = new Item { std::move(entry), NaoBytes('\0', size_t(size)), size, job.archive };
+
+            if (item->entry.source->read_at(item->entry.offset, item->data.data(), size) != size) {
+                nerr << "Failed reading source for" << item->entry.target;
+
+                finish(item->entry, item->archive, false);
+                discard(item);
+                continue;
+            }
+
+            if (item->entry.transform) {
+                push(transform_queue, transform_signal, transform_space, item);
+            } else {
+                push(write_queue, write_signal, write_space, item);
+            }
+        }
+    }
+
+    void transformer() {
+        Item* item;
+
+        while (pop(transform_queue, transform_signal, transform_space, item)) {
+            bool success;
+            try {
+                success = item->entry.transform(item->data);
+            } catch (const std::exception& e) {
+                nerr << "Transform failed for" << item->entry.target << ':' << e.what();
+                success = false;
+            }
+
+            if (!success) {
+                finish(item->entry, item->archive, false);
+                discard(item);
+                continue;
+            }
+
+            push(write_queue, write_signal, write_space, item);
+        }
+
+        discard_all(transform_queue);
+    }
+
+    void writer() {
+        Item* item;
+
+        while (pop(write_queue, write_signal, write_space, item)) {
+            const bool success = write(item->entry.target,
+                item->data.const_data(), int64_t(std::size(item->data)));
+
+            finish(item->entry, item->archive, success);
+            discard(item);
+        }
+
+        discard_all(write_queue);
+    }
+
+    // Drop anything left behind after cancelling
+    void drain() {
+        discard_all(transform_queue);
+        discard_all(write_queue);
+
+        std::lock_guard lock(pending_mutex);
+        pending.clear();
+    }
+};
+
+NaoExtractionPipeline::NaoExtractionPipeline()
+    : NaoExtractionPipeline(Config()) {
+
+}
+
+NaoExtractionPipeline::NaoExtractionPipeline(const Config& config)
+    : d_ptr(new NEPPrivate(config)) {
+
+}
+
+NaoExtractionPipeline::~NaoExtractionPipeline() {
+    delete d_ptr;
+}
+
+void NaoExtractionPipeline::submit(const Entry& entry) {
+    d_ptr->submit(entry, 0);
+}
+
+void NaoExtractionPipeline::submit(NaoIO* source, const NaoString& target, const Transform& transform) {
+    submit({ source, target, transform });
+}
+
+void NaoExtractionPipeline::submit(NaoIO* source, int64_t offset, int64_t size,
+    const NaoString& target, const Transform& transform) {
+    submit({ source, target, transform, offset, size });
+}
+
+bool NaoExtractionPipeline::run(const ProgressCallback& progress) {
+    const Config& config = d_ptr->config;
+
+    const size_t readers = config.readers ? config.readers : std::max<size_t>(NaoParallel::io_threads() / 2, 2);
+    const size_t transformers = config.transformers
+        ? config.transformers : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    const size_t writers = config.writers ? config.writers : std::max<size_t>(NaoParallel::io_threads() / 2, 2);
+
+    d_ptr->failed = 0;
+    d_ptr->expanded = 0;
+    d_ptr->skipped = 0;
+    d_ptr->done_bytes = 0;
+    d_ptr->written = 0;
+
+    size_t running = readers + transformers + writers;
+    std::mutex done_mutex;
+    std::condition_variable done;
+
+    // Stages run on the shared pool, so repeated runs reuse the same threads
+    auto stage = [&](void (NEPPrivate::*func)()) {
+        NaoParallel::submit([&, func] {
+            (d_ptr->*func)();
+
+            // Notify while locked, run() may return as soon as it sees the last stage finish
+            std::lock_guard lock(done_mutex);
+            --running;
+            done.notify_all();
+        });
+    };
+
+    for (size_t i = 0; i < readers; ++i) {
+        stage(&NEPPrivate::reader);
+    }
+
+    for (size_t i = 0; i < transformers; ++i) {
+        stage(&NEPPrivate::transformer);
+    }
+
+    for (size_t i = 0; i < writers; ++i) {
+        stage(&NEPPrivate::writer);
+    }
+
+    // Report progress from this thread, so callers don't need to synchronise
+    {
+        std::unique_lock lock(done_mutex);
+
+        while (!done.wait_for(lock, std::chrono::milliseconds(100), [&running] { return running == 0; })) {
+            if (progress) {
+                progress(d_ptr->done_bytes);
+            }
+        }
+    }
+
+    d_ptr->drain();
+
+    if (progress) {
+        progress(d_ptr->done_bytes);
+    }
+
+    for (NaoIO* io : d_ptr->opened_roots) {
+        io->close();
+    }
+
+    d_ptr->opened_roots.clear();
+
+    if (d_ptr->cancelled) {
+        nwarn << "Cancelled after writing" << NaoString::bytes(uint64_t(d_ptr->written.load()));
+        return false;
+    }
+
+    // Expanded archives and filtered entries were never meant to be written
+    const size_t files = d_ptr->count - d_ptr->expanded - d_ptr->skipped;
+
+    nlog << "Extracted" << (files - d_ptr->failed) << "of" << files
+        << "files," << NaoString::bytes(uint64_t(d_ptr->written.load())) << "written";
+
+    if (d_ptr->expanded > 0) {
+        nlog << "Expanded" << d_ptr->expanded.load() << "nested archives";
+    }
+
+    return d_ptr->failed == 0;
+}
+
+void NaoExtractionPipeline::cancel() {
+    d_ptr->cancel();
+}
+
+bool NaoExtractionPipeline::cancelled() const {
+    return d_ptr->cancelled;
+}
+
+size_t NaoExtractionPipeline::count() const {
+    std::lock_guard lock(d_ptr->pending_mutex);
+    return d_ptr->count;
+}
+
+int64_t NaoExtractionPipeline::total_size() const {
+    return d_ptr->total_size;
+}
+
+size_t NaoExtractionPipeline::failed() const {
+    return d_ptr->failed;
+}
+
+size_t NaoExtractionPipeline::expanded() const {
+    return d_ptr->expanded;
+}
+
+size_t NaoExtractionPipeline::skipped() const {
+    return d_ptr->skipped;
+}
+
+int64_t NaoExtractionPipeline::bytes_written() const {
+    return d_ptr->written;
+}
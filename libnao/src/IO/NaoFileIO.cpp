@@ -21,8 +21,14 @@
 #include "Logging/NaoLogging.h"
 #include "Filesystem/Filesystem.h"
 
+#ifdef N_WINDOWS
+#   include <Windows.h>
+#endif
+
 NaoFileIO::NaoFileIO(const NaoString& path)
-    : _m_file_ptr(nullptr) {
+    : _m_file_ptr(nullptr)
+    , _m_write_time(0)
+    , _m_read_handle(nullptr) {
 
     _m_path = fs::absolute(path);
 
@@ -33,10 +39,24 @@ NaoFileIO::NaoFileIO(const NaoString& path)
     }
 }
 
+NaoFileIO::NaoFileIO(const NaoString& path, int64_t size, int64_t write_time)
+    : _m_file_ptr(nullptr)
+    , _m_write_time(write_time)
+    , _m_read_handle(nullptr) {
+
+    _m_path = fs::absolute(path);
+
+    set_size(size);
+}
+
 NaoFileIO::~NaoFileIO() {
     if (_m_file_ptr && NaoIO::open_mode()) {
         fclose(_m_file_ptr);
     }
+
+    if (_m_read_handle) {
+        CloseHandle(_m_read_handle);
+    }
 }
 
 int64_t NaoFileIO::pos() const {
@@ -84,6 +104,60 @@ int64_t NaoFileIO::read(char* buf, int64_t size) {
     return fread_s(buf, size, 1, size, _m_file_ptr);
 }
 
+int64_t NaoFileIO::read_at(int64_t pos, char* buf, int64_t size) {
+    if (open_mode() != ReadOnly) {
+        return NaoIO::read_at(pos, buf, size);
+    }
+
+    if (!buf) {
+        return 0i64;
+    }
+
+    // Separate handle so positional reads don't disturb the stream, opened on first use
+    if (!_m_read_handle) {
+        HANDLE handle = CreateFileA(_m_path.c_str(), GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (handle == INVALID_HANDLE_VALUE) {
+            nwarn << "Failed to open read handle, falling back to seeking";
+            return NaoIO::read_at(pos, buf, size);
+        }
+
+        // Another thread may have beaten us to it
+        if (InterlockedCompareExchangePointer(&_m_read_handle, handle, nullptr) != nullptr) {
+            CloseHandle(handle);
+        }
+    }
+
+    int64_t total = 0;
+
+    // ReadFile reads at most 4 GiB - 1 at once
+    while (total < size) {
+        OVERLAPPED overlapped { };
+        overlapped.Offset = DWORD((pos + total) & 0xFFFFFFFF);
+        overlapped.OffsetHigh = DWORD((pos + total) >> 32);
+
+        DWORD bytes_read = 0;
+        if (!ReadFile(_m_read_handle, buf + total,
+            DWORD(std::min<int64_t>(size - total, 0x40000000)), &bytes_read, &overlapped)) {
+            if (GetLastError() == ERROR_HANDLE_EOF) {
+                break;
+            }
+
+            nerr << "ReadFile failed with error" << GetLastError();
+            return (total > 0) ? total : -1i64;
+        }
+
+        if (bytes_read == 0) {
+            break;
+        }
+
+        total += bytes_read;
+    }
+
+    return total;
+}
+
 int64_t NaoFileIO::write(const char* buf, int64_t size) {
     if (open_mode() == Closed) {
         nerr << "File is not open (write)";
@@ -161,6 +235,11 @@ void NaoFileIO::close() {
         }
     }
 
+    if (_m_read_handle) {
+        CloseHandle(_m_read_handle);
+        _m_read_handle = nullptr;
+    }
+
     NaoIO::close();
 }
 
@@ -168,3 +247,7 @@ const NaoString& NaoFileIO::path() const {
     return _m_path;
 }
 
+int64_t NaoFileIO::write_time() const {
+    return _m_write_time;
+}
+
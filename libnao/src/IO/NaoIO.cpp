@@ -55,6 +55,14 @@ NaoBytes NaoIO::read(size_t size) {
     return bytes;
 }
 
+int64_t NaoIO::read_at(int64_t pos, char* buf, int64_t size) {
+    if (!seek(pos)) {
+        return -1i64;
+    }
+
+    return read(buf, size);
+}
+
 NaoBytes NaoIO::read_singleshot(size_t size) {
     if (size == 4) {
         // Return previously read fourcc if possible
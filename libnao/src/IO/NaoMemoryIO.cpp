@@ -68,6 +68,26 @@ int64_t NaoMemoryIO::read(char* buf, int64_t size) {
     return read;
 }
 
+int64_t NaoMemoryIO::read_at(int64_t pos, char* buf, int64_t size) {
+    if (!is_open(ReadOnly)) {
+        nerr << "Device is not open (read_at)";
+        return -1i64;
+    }
+
+    if (pos < 0 || pos > this->size()) {
+        nerr << "Position out of range";
+        return -1i64;
+    }
+
+    if (!buf) {
+        return 0i64;
+    }
+
+    return std::distance(buf,
+        std::copy_n(_m_data.const_data() + pos,
+        std::clamp(size, 0i64, this->size() - pos), buf));
+}
+
 int64_t NaoMemoryIO::write(const char* buf, int64_t size) {
     (void) buf;
     (void) size;
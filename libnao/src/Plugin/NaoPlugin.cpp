@@ -17,10 +17,28 @@
 
 #include "Plugin/NaoPlugin.h"
 
+#include "Filesystem/NTreeNode.h"
+
+NaoVector<NaoPlugin::Signature> NaoPlugin::signatures() const {
+    return { };
+}
+
 bool NaoPlugin::can_populate(N_UNUSED NTreeNode* node) {
     return false;
 }
 
+bool NaoPlugin::populate_batched(NTreeNode* node, const PopulateCallback& callback) {
+    if (!populate(node)) {
+        return false;
+    }
+
+    if (callback && !node->children().empty()) {
+        callback(node->children());
+    }
+
+    return true;
+}
+
 bool NaoPlugin::has_description(N_UNUSED NTreeNode* node) {
     return false;
 }
@@ -29,6 +47,26 @@ NaoString NaoPlugin::description(N_UNUSED NTreeNode* node) {
     return NaoString();
 }
 
+bool NaoPlugin::refresh(N_UNUSED NTreeNode* node, N_UNUSED Changes& changes,
+    N_UNUSED const CommitCallback& commit) {
+    return false;
+}
+
+NaoVector<NaoAction*> NaoPlugin::actions(N_UNUSED NTreeNode* node) {
+    return { };
+}
+
+#pragma region NaoAction
+
+NaoAction::NaoAction(NaoPlugin* parent)
+    : _m_parent(parent) { }
+
+NaoPlugin* NaoAction::parent() const {
+    return _m_parent;
+}
+
+#pragma endregion
+
 #if 0
 NaoPlugin::MoveEventArgs::MoveEventArgs(NaoObject* from, NaoObject* to)
     : from(from), to(to){ }
@@ -102,15 +140,4 @@ NaoObject* NaoPlugin::GetChild(const NaoString& name) {
     return nullptr;
 }
 
-#pragma region NaoAction
-
-NaoAction::NaoAction(NaoPlugin* parent)
-    : _m_parent(parent) { }
-
-NaoPlugin* NaoAction::parent() const {
-    return _m_parent;
-}
-
-#pragma endregion
-
 #endif
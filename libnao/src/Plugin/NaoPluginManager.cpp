@@ -46,6 +46,10 @@ NaoPlugin* NaoPluginManager::description_plugin(NTreeNode* node) const {
     return d_ptr->description_plugin(node);
 }
 
+int64_t NaoPluginManager::header_size() const {
+    return d_ptr->header_size();
+}
+
 
 #if 0
 //// D-pointer class
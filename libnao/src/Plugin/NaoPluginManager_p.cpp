@@ -20,18 +20,87 @@
 
 
 #include "Containers/NaoString.h"
+#include "Filesystem/NTreeNode.h"
+#include "IO/NaoIO.h"
 
 #define N_LOG_ID "NPMPrivate"
 #include "Logging/NaoLogging.h"
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
 #ifdef N_WINDOWS
 #   include <Windows.h>
+#else
+#   include <dlfcn.h>
+#endif
+
+#pragma region Native libraries
+
+static void* open_library(const NaoString& path) {
+#ifdef N_WINDOWS
+    return LoadLibraryA(path);
+#else
+    return dlopen(path, RTLD_NOW | RTLD_LOCAL);
 #endif
+}
+
+static void* find_symbol(void* handle, const char* name) {
+#ifdef N_WINDOWS
+    return reinterpret_cast<void*>(GetProcAddress(HMODULE(handle), name));
+#else
+    return dlsym(handle, name);
+#endif
+}
+
+static void close_library(void* handle) {
+#ifdef N_WINDOWS
+    FreeLibrary(HMODULE(handle));
+#else
+    dlclose(handle);
+#endif
+}
+
+static NaoString library_error() {
+#ifdef N_WINDOWS
+    return "error " + NaoString::number(GetLastError());
+#else
+    const char* error = dlerror();
+    return error ? error : "unknown error";
+#endif
+}
+
+#pragma endregion
+
+static bool same_signature(const NaoPlugin::Signature& lhs, const NaoPlugin::Signature& rhs) {
+    if (lhs.offset != rhs.offset || lhs.capabilities != rhs.capabilities
+        || std::size(lhs.bytes) != std::size(rhs.bytes)) {
+        return false;
+    }
+
+    // An empty mask is the same as one that compares all bits
+    for (size_t i = 0; i < std::size(lhs.bytes); ++i) {
+        const char lhs_mask = std::size(lhs.mask) == 0 ? char(0xFF) : lhs.mask.const_data()[i];
+        const char rhs_mask = std::size(rhs.mask) == 0 ? char(0xFF) : rhs.mask.const_data()[i];
+
+        if (lhs_mask != rhs_mask || (lhs.bytes.const_data()[i] & lhs_mask) != (rhs.bytes.const_data()[i] & rhs_mask)) {
+            return false;
+        }
+    }
+
+    return true;
+}
 
 NPMPrivate::~NPMPrivate() {
-    for (Plugin plugin : _m_plugins) {
-        delete plugin.plugin;
-        FreeLibrary(HMODULE(plugin.handle));
+    for (Plugin* plugin : _m_plugins) {
+        delete plugin->plugin.load();
+
+        if (plugin->handle) {
+            close_library(plugin->handle);
+        }
+
+        delete plugin;
     }
 }
 
@@ -69,7 +138,7 @@ bool NPMPrivate::init(const NaoString& plugin_dir) {
             !is_empty(file.path()) &&
             file.path().extension() == LIBNAO_PLUGIN_EXTENSION) {
             // If entry is not a directory, not empty and has the correct extension,
-            // the plugin is not in it's own folder
+            // the plugin is not in its own folder
 
             // Load entry directly
             target_lib = file.path();
@@ -90,12 +159,15 @@ bool NPMPrivate::init(const NaoString& plugin_dir) {
             continue;
         }
 
-        if (!_load(target_lib)) {
+        if (!_add(target_lib)) {
             nerr << "Failed to load library" << target_lib;
         }
     }
 
-    nlog << "Loaded" << _m_plugins.size() << "plugins";
+    size_t loaded = std::count_if(std::begin(_m_plugins), std::end(_m_plugins),
+        [](const Plugin* plugin) { return plugin->plugin.load() != nullptr; });
+
+    nlog << "Registered" << _m_plugins.size() << "plugins," << loaded << "loaded";
 
     // Success determined by whether we have any plugins at all
     _m_initialised = !_m_plugins.empty();
@@ -108,12 +180,35 @@ bool NPMPrivate::initialised() const {
 }
 
 NaoPlugin* NPMPrivate::populate_plugin(NTreeNode* node) const {
-    // Check all plugins
-    for (const Plugin& plugin : _m_plugins) {
-        // If it can populate
-        if (plugin->can_populate(node)) {
-            // Return it
-            return plugin.plugin;
+    if (node->has_populate_plugin()) {
+        return node->populate_plugin();
+    }
+
+    NaoPlugin* plugin = _find_populate_plugin(node);
+
+    // A directory may still appear on disk later
+    if (plugin || !node->is_dir()) {
+        node->set_populate_plugin(plugin);
+    }
+
+    return plugin;
+}
+
+NaoPlugin* NPMPrivate::_find_populate_plugin(NTreeNode* node) const {
+    // Files are identified by their header
+    if (!node->is_dir()) {
+        if (NaoPlugin* plugin = _match(_header(node), NaoPlugin::Populate)) {
+            return plugin;
+        }
+    }
+
+    // Check all plugins that may handle it
+    for (Plugin* plugin : _m_plugins) {
+        if (_is_candidate(plugin, node, NaoPlugin::Populate)) {
+            NaoPlugin* instance = _activate(plugin);
+            if (instance && instance->can_populate(node)) {
+                return instance;
+            }
         }
     }
 
@@ -122,12 +217,20 @@ NaoPlugin* NPMPrivate::populate_plugin(NTreeNode* node) const {
 }
 
 NaoPlugin* NPMPrivate::description_plugin(NTreeNode* node) const {
-    // Check all plugins
-    for (const Plugin& plugin : _m_plugins) {
-        // If it can populate
-        if (plugin->has_description(node)) {
-            // Return it
-            return plugin.plugin;
+    // Files are identified by their header
+    if (!node->is_dir()) {
+        if (NaoPlugin* plugin = _match(_header(node), NaoPlugin::Description)) {
+            return plugin;
+        }
+    }
+
+    // Check all plugins that may handle it
+    for (Plugin* plugin : _m_plugins) {
+        if (_is_candidate(plugin, node, NaoPlugin::Description)) {
+            NaoPlugin* instance = _activate(plugin);
+            if (instance && instance->has_description(node)) {
+                return instance;
+            }
         }
     }
 
@@ -136,53 +239,292 @@ NaoPlugin* NPMPrivate::description_plugin(NTreeNode* node) const {
 }
 
 
-bool NPMPrivate::_load(const NaoString& name) {
-#ifdef N_WINDOWS
+bool NPMPrivate::_add(const NaoString& library) {
+    Plugin* plugin = new Plugin();
+    plugin->library = library;
+    plugin->name = fs::path(library).stem();
 
-    Plugin plugin;
-    // Retrieve handle
-    plugin.handle = LoadLibraryA(name);
+    const NaoString manifest = fs::path(library).replace_extension(LIBNAO_PLUGIN_MANIFEST_EXTENSION);
 
-    // Make sure it's not null
-    if (plugin.handle == nullptr) {
-        nerr << "Failed to retrieve handle for" << name;
+    if (fs::exists(manifest)) {
+        NaoVector<NaoPlugin::Signature> signatures;
+
+        if (!_read_manifest(manifest, plugin, signatures)) {
+            nerr << "Invalid manifest" << manifest;
+            delete plugin;
+            return false;
+        }
+
+        plugin->has_manifest = true;
+        plugin->manifest_signatures = signatures;
+
+        _m_plugins.push_back(plugin);
+        _register_signatures(plugin, signatures);
+
+        nlog << "Registered plugin" << library << ("(\"" + plugin->name + "\")");
+
+        return true;
+    }
+
+    // Without a manifest the plugin has to be loaded to know what it handles
+    NaoPlugin* instance = _activate(plugin);
+    if (!instance) {
+        delete plugin;
         return false;
     }
 
-    // Get the libnao entrypoint
-    PluginFunc plugin_func = reinterpret_cast<PluginFunc>(
-        GetProcAddress(HMODULE(plugin.handle), "GetNaoPlugin"));
+    plugin->name = instance->name();
+    _m_plugins.push_back(plugin);
 
-    // If we got it
-    if (plugin_func) {
+    uint32_t capabilities = _register_signatures(plugin, instance->signatures());
 
-        // Retrieve the plugin instance
-        plugin.plugin = plugin_func();
+    // Asked about files for anything its signatures don't cover
+    plugin->generic_capabilities = ~capabilities & (NaoPlugin::Populate | NaoPlugin::Description);
 
-        // Save the plugin
-        _m_plugins.push_back(plugin);
+    return true;
+}
+
+bool NPMPrivate::_read_manifest(const NaoString& path, Plugin* plugin,
+    NaoVector<NaoPlugin::Signature>& signatures) const {
+
+    std::ifstream file(static_cast<fs::path>(path));
+    if (!file) {
+        nerr << "Failed to open" << path;
+        return false;
+    }
+
+    auto trim = [](std::string str) -> std::string {
+        const size_t first = str.find_first_not_of(" \t\r");
+        if (first == std::string::npos) {
+            return std::string();
+        }
+
+        return str.substr(first, str.find_last_not_of(" \t\r") - first + 1);
+    };
 
-        /*
-        // For all events
-        for (NaoPlugin::Event event : NaoPlugin::AllEvents) {
-            // Add plugin to subscribers if needed
-            if (plugin->SubscribedEvents() & event) {
-                _m_event_subscribers[event].push_back(plugin.plugin);
+    auto parse_hex = [](const std::string& str, NaoBytes& result) -> bool {
+        if (str.empty() || (std::size(str) % 2) != 0) {
+            return false;
+        }
+
+        std::string bytes(std::size(str) / 2, '\0');
+        for (size_t i = 0; i < std::size(bytes); ++i) {
+            char* end;
+            const std::string pair = str.substr(i * 2, 2);
+            bytes[i] = char(std::strtoul(pair.c_str(), &end, 16));
+
+            if (*end != '\0') {
+                return false;
             }
-        }*/
+        }
 
-        nlog << "Loaded plugin" << name << ("(\"" + plugin->name() + "\")");
+        result = NaoBytes(bytes.data(), int64_t(std::size(bytes)));
+        return true;
+    };
+
+    auto parse_capability = [](const std::string& str, uint32_t& capabilities) -> bool {
+        if (str == "populate") {
+            capabilities |= NaoPlugin::Populate;
+        } else if (str == "description") {
+            capabilities |= NaoPlugin::Description;
+        } else {
+            return false;
+        }
 
         return true;
+    };
+
+    std::string line;
+    for (size_t line_number = 1; std::getline(file, line); ++line_number) {
+        line = trim(line.substr(0, line.find('#')));
+
+        if (line.empty()) {
+            continue;
+        }
+
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            nerr << "Expected key = value on line" << line_number;
+            return false;
+        }
+
+        const std::string key = trim(line.substr(0, equals));
+        std::istringstream value(trim(line.substr(equals + 1)));
+
+        if (key == "name") {
+            plugin->name = value.str();
+        } else if (key == "signature") {
+            NaoPlugin::Signature signature { };
+            std::string pattern;
+
+            if (!(value >> signature.offset >> pattern)) {
+                nerr << "Expected an offset and a pattern on line" << line_number;
+                return false;
+            }
+
+            const size_t slash = pattern.find('/');
+            if (!parse_hex(pattern.substr(0, slash), signature.bytes)
+                || (slash != std::string::npos && !parse_hex(pattern.substr(slash + 1), signature.mask))) {
+                nerr << "Invalid pattern on line" << line_number;
+                return false;
+            }
+
+            for (std::string capability; value >> capability;) {
+                if (!parse_capability(capability, signature.capabilities)) {
+                    nerr << "Unknown capability" << capability << "on line" << line_number;
+                    return false;
+                }
+            }
+
+            signatures.push_back(signature);
+        } else if (key == "generic") {
+            for (std::string capability; value >> capability;) {
+                if (!parse_capability(capability, plugin->generic_capabilities)) {
+                    nerr << "Unknown capability" << capability << "on line" << line_number;
+                    return false;
+                }
+            }
+
+        } else {
+            nwarn << "Ignoring unknown key" << key << "on line" << line_number;
+        }
     }
 
-    nerr << "Failed to retrieve address of GetNaoPlugin() function.";
+    return true;
+}
 
-    return false;
-#endif
+bool NPMPrivate::_is_candidate(const Plugin* plugin, NTreeNode* node, uint32_t capability) {
+    if (plugin->generic_capabilities & capability) {
+        return true;
+    }
+
+    // A loaded plugin may have created the directory itself
+    return node->is_dir() && plugin->plugin.load(std::memory_order_acquire) != nullptr;
 }
 
-NaoPlugin* NPMPrivate::Plugin::operator->() const {
-    // Access plugin directly
-    return plugin;
+NaoPlugin* NPMPrivate::_activate(Plugin* plugin) const {
+    if (NaoPlugin* instance = plugin->plugin.load(std::memory_order_acquire)) {
+        return instance;
+    }
+
+    std::lock_guard lock(_m_load_mutex);
+
+    // Loaded by another thread while we were waiting
+    if (NaoPlugin* instance = plugin->plugin.load(std::memory_order_relaxed)) {
+        return instance;
+    }
+
+    if (plugin->failed) {
+        return nullptr;
+    }
+
+    plugin->failed = true;
+
+    // Retrieve handle
+    plugin->handle = open_library(plugin->library);
+
+    // Make sure it's not null
+    if (plugin->handle == nullptr) {
+        nerr << "Failed to retrieve handle for" << plugin->library << ("(" + library_error() + ")");
+        return nullptr;
+    }
+
+    // Get the libnao entrypoint
+    PluginFunc plugin_func = reinterpret_cast<PluginFunc>(find_symbol(plugin->handle, "GetNaoPlugin"));
+
+    if (!plugin_func) {
+        nerr << "Failed to retrieve address of GetNaoPlugin() function.";
+
+        close_library(plugin->handle);
+        plugin->handle = nullptr;
+
+        return nullptr;
+    }
+
+    // Retrieve the plugin instance
+    NaoPlugin* instance = plugin_func();
+
+    plugin->failed = false;
+    plugin->plugin.store(instance, std::memory_order_release);
+
+    nlog << "Loaded plugin" << plugin->library << ("(\"" + instance->name() + "\")");
+
+    if (plugin->has_manifest) {
+        _check_manifest(plugin, instance);
+    }
+
+    return instance;
+}
+
+void NPMPrivate::_check_manifest(const Plugin* plugin, NaoPlugin* instance) const {
+    const NaoVector<NaoPlugin::Signature> signatures = instance->signatures();
+
+    auto contains = [](const NaoVector<NaoPlugin::Signature>& list, const NaoPlugin::Signature& signature) {
+        return std::any_of(std::begin(list), std::end(list),
+            [&](const NaoPlugin::Signature& other) { return same_signature(signature, other); });
+    };
+
+    for (const NaoPlugin::Signature& signature : plugin->manifest_signatures) {
+        if (!contains(signatures, signature)) {
+            nwarn << "Manifest of" << plugin->name << "lists a signature at offset"
+                << signature.offset << "that the plugin doesn't have";
+        }
+    }
+
+    for (const NaoPlugin::Signature& signature : signatures) {
+        if (!contains(plugin->manifest_signatures, signature)) {
+            nwarn << "Plugin" << plugin->name << "has a signature at offset"
+                << signature.offset << "that its manifest doesn't list";
+        }
+    }
+}
+
+uint32_t NPMPrivate::_register_signatures(Plugin* plugin, const NaoVector<NaoPlugin::Signature>& signatures) {
+    uint32_t capabilities = 0;
+
+    for (const NaoPlugin::Signature& signature : signatures) {
+        if (!_m_signatures.add(signature, plugin)) {
+            nwarn << "Ignoring invalid signature from" << plugin->name;
+            continue;
+        }
+
+        capabilities |= signature.capabilities;
+    }
+
+    return capabilities;
+}
+
+int64_t NPMPrivate::header_size() const {
+    // Enough to tell files apart by their magic, even without any signatures
+    return std::max<int64_t>(int64_t(_m_signatures.header_size()), 4);
+}
+
+NaoBytes NPMPrivate::_header(NTreeNode* node) const {
+    // Probed earlier
+    if (node->has_header()) {
+        return node->header();
+    }
+
+    NaoIO* io = node->io();
+
+    if (!io || io->size() == 0) {
+        return NaoBytes();
+    }
+
+    return io->read_singleshot(size_t(std::min<int64_t>(io->size(), header_size())));
+}
+
+NaoPlugin* NPMPrivate::_match(const NaoBytes& header, uint32_t capability) const {
+    NaoPlugin* result = nullptr;
+
+    _m_signatures.find(header.const_data(), std::size(header),
+        [&](const NaoPlugin::Signature& signature, Plugin* plugin) {
+            if (signature.capabilities & capability) {
+                result = _activate(plugin);
+            }
+
+            return result != nullptr;
+        });
+
+    return result;
 }
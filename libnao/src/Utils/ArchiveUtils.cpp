@@ -0,0 +1,118 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Utils/ArchiveUtils.h"
+
+#define N_LOG_ID "ArchiveUtils"
+#include "Logging/NaoLogging.h"
+#include "Filesystem/Filesystem.h"
+#include "Filesystem/NTreeNode.h"
+#include "IO/NaoFileIO.h"
+#include "IO/NaoExtractionPipeline.h"
+#include "UI/NaoUIManager.h"
+#include "UI/NProgressDialog.h"
+#include "Utils/DesktopUtils.h"
+#include "Decoding/NaoDecodingException.h"
+#include "Decoding/Compression/NaoCRILAYLA.h"
+
+namespace ArchiveUtils {
+    NaoString existing_dir(NTreeNode* node) {
+        for (NTreeNode* dir = node->parent(); dir; dir = dir->parent()) {
+            if (fs::is_directory(dir->path())) {
+                return dir->path();
+            }
+        }
+
+        return NaoString();
+    }
+
+    NaoString ask_target_dir(NTreeNode* node, const NaoString& name) {
+        const NaoString target = DesktopUtils::save_as_dir(existing_dir(node), "", "Select target folder");
+
+        if (std::empty(target)) {
+            return NaoString();
+        }
+
+        const NaoString out_dir = target + N_PATHSEP + name;
+
+        if (!DesktopUtils::confirm_overwrite(out_dir, true)) {
+            return NaoString();
+        }
+
+        return out_dir;
+    }
+
+    bool extract(NTreeNode* archive, const Select& select, bool recursive) {
+        // An archive on disk gets its own IO. Nested archives are read through the tree, which
+        // stays valid because the node the action runs for is locked, and so are its parents
+        NaoFileIO* disk_io = fs::is_regular_file(archive->path()) ? new NaoFileIO(archive->path()) : nullptr;
+        NaoIO* io = disk_io ? disk_io : archive->io();
+
+        NaoVector<File> files;
+
+        try {
+            if (!select(io, files)) {
+                delete disk_io;
+                return false;
+            }
+        } catch (const NaoDecodingException& e) {
+            nerr << e.what();
+            delete disk_io;
+            return false;
+        }
+
+        // Nested archives are expanded while extracting, reading them in place
+        NaoExtractionPipeline::Config config;
+        config.expand_archives = recursive;
+
+        NaoExtractionPipeline extractor(config);
+
+        for (const File& file : files) {
+            // Uncompressed files skip the transform stage and large ones are streamed straight to disk
+            extractor.submit(io, file.entry.offset, file.entry.binary_size, file.target,
+                (file.entry.binary_size != file.entry.real_size) ? &NaoCRILAYLA::decompress_in_place : nullptr);
+        }
+
+        nlog << "Found" << extractor.count()
+            << (extractor.count() == 1 ? "file" : "files")
+            << "with a total size of" << NaoString::bytes(uint64_t(extractor.total_size()));
+
+        NProgressDialog progress(UIWindow);
+
+        progress.set_title("Extracting " + archive->name());
+        progress.set_text("Extracting " + NaoString::number(extractor.count())
+            + (extractor.count() == 1 ? " file" : " files"));
+        progress.set_max(extractor.total_size());
+        progress.start();
+
+        const bool success = extractor.run([&progress, &extractor](int64_t done) {
+            // Grows as nested archives are expanded
+            progress.set_max(extractor.total_size());
+            progress.set_progress(done);
+        });
+
+        progress.close();
+
+        delete disk_io;
+
+        if (!success) {
+            nerr << "Failed extracting" << extractor.failed() << "files";
+        }
+
+        return success;
+    }
+}
@@ -22,5 +22,13 @@
 class TestNaoVector : public QObject {
     Q_OBJECT
 
-
+    private slots:
+    void constructors();
+    void growth();
+    void lifetimes();
+    void move_only();
+    void no_default_constructor();
+    void insert();
+    void erase();
+    void empty_range();
 };
@@ -0,0 +1,188 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Containers/TestNaoSmallVector.h"
+
+#include <Containers/NaoSmallVector.h>
+#include <Containers/NaoString.h>
+
+#include <memory>
+
+void TestNaoSmallVector::inline_storage() {
+    NaoSmallVector<int, 4> vec;
+
+    QVERIFY(vec.is_inline());
+    QCOMPARE(vec.capacity(), size_t(4));
+
+    // The storage is part of the object itself
+    const char* object = reinterpret_cast<const char*>(&vec);
+
+    for (int i = 0; i < 4; ++i) {
+        vec.push_back(i);
+    }
+
+    QVERIFY(vec.is_inline());
+    QVERIFY(reinterpret_cast<const char*>(vec.data()) >= object);
+    QVERIFY(reinterpret_cast<const char*>(vec.data()) < object + sizeof(vec));
+    QCOMPARE(vec.back(), 3);
+
+    const NaoSmallVector<NaoString, 8> parts = NaoString("foo/bar/baz").split_small('/');
+
+    QVERIFY(parts.is_inline());
+    QCOMPARE(std::size(parts), size_t(3));
+    QCOMPARE(parts[1], "bar");
+}
+
+void TestNaoSmallVector::spill() {
+    NaoSmallVector<NaoString, 2> vec { "a", "b" };
+
+    QVERIFY(vec.is_inline());
+
+    vec.push_back("c");
+
+    QVERIFY(!vec.is_inline());
+    QVERIFY(vec.capacity() >= 3);
+
+    for (int i = 0; i < 100; ++i) {
+        vec.emplace_back(NaoString::number(i));
+    }
+
+    QCOMPARE(std::size(vec), size_t(103));
+    QCOMPARE(vec[0], "a");
+    QCOMPARE(vec[2], "c");
+    QCOMPARE(vec.back(), "99");
+
+    QVERIFY_EXCEPTION_THROWN(static_cast<void>(vec.at(103)), std::out_of_range);
+}
+
+void TestNaoSmallVector::copy_move() {
+    NaoSmallVector<std::unique_ptr<int>, 4> small;
+    small.push_back(std::make_unique<int>(1));
+
+    // Inline elements are moved one by one
+    NaoSmallVector<std::unique_ptr<int>, 4> moved(std::move(small));
+
+    QVERIFY(moved.is_inline());
+    QCOMPARE(*moved.front(), 1);
+
+    // ReSharper disable once bugprone-use-after-move
+    QVERIFY(std::empty(small));
+
+    // Heap storage is taken over
+    for (int i = 2; i <= 10; ++i) {
+        moved.push_back(std::make_unique<int>(i));
+    }
+
+    int* heap = moved.front().get();
+    NaoSmallVector<std::unique_ptr<int>, 4> taken;
+    taken = std::move(moved);
+
+    QVERIFY(!taken.is_inline());
+    QCOMPARE(taken.front().get(), heap);
+    QCOMPARE(*taken.back(), 10);
+
+    // ReSharper disable once bugprone-use-after-move
+    QVERIFY(moved.is_inline());
+
+    NaoSmallVector<NaoString, 2> strings { "x", "y", "z" };
+    NaoSmallVector<NaoString, 2> copy(strings);
+
+    QCOMPARE(std::size(copy), size_t(3));
+    QCOMPARE(copy[2], "z");
+
+    NaoSmallVector<NaoString, 2> other { "w" };
+    other.swap(copy);
+
+    QCOMPARE(std::size(other), size_t(3));
+    QCOMPARE(std::size(copy), size_t(1));
+    QCOMPARE(copy.front(), "w");
+}
+
+void TestNaoSmallVector::insert_erase() {
+    NaoSmallVector<int, 8> vec { 1, 5 };
+    const int middle[] { 2, 3, 4 };
+
+    vec.insert(std::begin(vec) + 1, std::begin(middle), std::end(middle));
+
+    QVERIFY(vec.is_inline());
+    QCOMPARE(std::size(vec), size_t(5));
+
+    for (int i = 0; i < 5; ++i) {
+        QCOMPARE(vec[i], i + 1);
+    }
+
+    // Spills to the heap
+    vec.insert(std::end(vec), std::begin(middle), std::end(middle));
+    vec.insert(std::begin(vec), std::begin(middle), std::end(middle));
+
+    QVERIFY(!vec.is_inline());
+    QCOMPARE(std::size(vec), size_t(11));
+    QCOMPARE(vec.front(), 2);
+    QCOMPARE(vec[3], 1);
+    QCOMPARE(vec.back(), 4);
+
+    QCOMPARE(*vec.erase(std::begin(vec)), 3);
+    // Erasing the tail returns the new end, which only exists after erasing
+    const int* const last = vec.erase(std::begin(vec) + 2, std::end(vec));
+
+    QVERIFY(last == std::end(vec));
+    QCOMPARE(std::size(vec), size_t(2));
+    QVERIFY(vec.contains(4));
+    QCOMPARE(vec.index_of(7), size_t(-1));
+}
+
+void TestNaoSmallVector::shrink() {
+    NaoSmallVector<NaoString, 4> vec;
+
+    for (int i = 0; i < 20; ++i) {
+        vec.push_back(NaoString::number(i));
+    }
+
+    QVERIFY(!vec.is_inline());
+
+    vec.erase(std::begin(vec) + 2, std::end(vec));
+    vec.shrink_to_fit();
+
+    // Back to inline storage once everything fits again
+    QVERIFY(vec.is_inline());
+    QCOMPARE(vec.capacity(), size_t(4));
+    QCOMPARE(vec[1], "1");
+
+    vec.clear();
+
+    QVERIFY(std::empty(vec));
+}
+
+void TestNaoSmallVector::empty_range() {
+    NaoSmallVector<NaoString, 4> vec;
+
+    for (int i = 0; i < 6; ++i) {
+        vec.push_back(NaoString::number(i));
+    }
+
+    // Empty ranges must leave every element untouched
+    QCOMPARE(*vec.erase(std::begin(vec) + 3, std::begin(vec) + 3), "3");
+
+    const NaoString* const none = nullptr;
+    QCOMPARE(*vec.insert(std::begin(vec) + 3, none, none), "3");
+
+    QCOMPARE(std::size(vec), size_t(6));
+
+    for (int i = 0; i < 6; ++i) {
+        QCOMPARE(vec[i], NaoString::number(i));
+    }
+}
@@ -16,3 +16,230 @@
 */
 
 #include "Containers/TestNaoVector.h"
+
+#include <Containers/NaoVector.h>
+#include <Containers/NaoString.h>
+
+#include <memory>
+#include <numeric>
+
+// Counts live instances, to check that only live elements are constructed
+struct Counted {
+    static inline int64_t live = 0;
+
+    Counted() : value(0) { ++live; }
+    Counted(int v) : value(v) { ++live; }
+    Counted(const Counted& other) : value(other.value) { ++live; }
+    Counted(Counted&& other) noexcept : value(other.value) { ++live; }
+    ~Counted() { --live; }
+
+    Counted& operator=(const Counted&) = default;
+    Counted& operator=(Counted&&) noexcept = default;
+
+    int value;
+};
+
+// Can only be constructed with a value
+struct NoDefault {
+    explicit NoDefault(int v) : value(v) { }
+
+    int value;
+};
+
+void TestNaoVector::constructors() {
+    NaoVector<int> sized(5);
+
+    QCOMPARE(std::size(sized), size_t(5));
+    QVERIFY(std::all_of(std::begin(sized), std::end(sized), [](int v) { return v == 0; }));
+
+    NaoVector<int> empty;
+
+    QVERIFY(std::empty(empty));
+    QCOMPARE(empty.capacity(), size_t(0));
+
+    NaoVector<int> list { 1, 2, 3 };
+    NaoVector<int> copy(list);
+
+    QCOMPARE(std::size(copy), size_t(3));
+    QCOMPARE(copy[2], 3);
+
+    NaoVector<int> moved(std::move(copy));
+
+    QCOMPARE(std::size(moved), size_t(3));
+
+    // ReSharper disable once bugprone-use-after-move
+    QCOMPARE(copy.data(), nullptr);
+
+    list = { 4, 5 };
+    moved = list;
+
+    QCOMPARE(std::size(moved), size_t(2));
+    QCOMPARE(moved.back(), 5);
+}
+
+void TestNaoVector::growth() {
+    NaoVector<int> vec;
+
+    size_t reallocations = 0;
+    const int* data = vec.data();
+
+    for (int i = 0; i < 30000; ++i) {
+        vec.push_back(i);
+
+        if (vec.data() != data) {
+            data = vec.data();
+            ++reallocations;
+        }
+    }
+
+    // Geometric growth only needs a logarithmic number of reallocations
+    QVERIFY(reallocations <= 12);
+    QCOMPARE(vec.capacity() % NaoVector<int>::data_alignment, size_t(0));
+
+    for (int i = 0; i < 30000; ++i) {
+        QCOMPARE(vec[i], i);
+    }
+
+    // Reserving skips geometric growth, but still rounds up to data_alignment
+    NaoVector<int> reserved;
+    reserved.reserve(100);
+
+    QCOMPARE(reserved.capacity(), size_t(112));
+
+    reserved.shrink_to_fit();
+
+    QCOMPARE(reserved.capacity(), size_t(0));
+}
+
+void TestNaoVector::lifetimes() {
+    {
+        NaoVector<Counted> vec;
+
+        // Spare capacity holds no objects
+        vec.reserve(64);
+        QCOMPARE(Counted::live, int64_t(0));
+
+        for (int i = 0; i < 100; ++i) {
+            vec.emplace_back(i);
+        }
+
+        QCOMPARE(Counted::live, int64_t(100));
+
+        vec.erase(std::begin(vec) + 10, std::begin(vec) + 20);
+        QCOMPARE(Counted::live, int64_t(90));
+        QCOMPARE(vec[10].value, 20);
+
+        vec.erase(std::begin(vec));
+        QCOMPARE(Counted::live, int64_t(89));
+
+        const Counted extra[] { 1, 2, 3 };
+        vec.insert(std::begin(vec) + 5, std::begin(extra), std::end(extra));
+        QCOMPARE(Counted::live, int64_t(95));
+
+        vec.clear();
+        QCOMPARE(Counted::live, int64_t(3));
+    }
+
+    QCOMPARE(Counted::live, int64_t(0));
+}
+
+void TestNaoVector::move_only() {
+    NaoVector<std::unique_ptr<int>> vec;
+
+    // Reallocating has to move every element
+    for (int i = 0; i < 100; ++i) {
+        vec.push_back(std::make_unique<int>(i));
+    }
+
+    QCOMPARE(std::size(vec), size_t(100));
+    QCOMPARE(*vec[99], 99);
+
+    vec.erase(std::begin(vec));
+    QCOMPARE(*vec.front(), 1);
+
+    NaoVector<std::unique_ptr<int>> other(std::move(vec));
+    QCOMPARE(*other.back(), 99);
+}
+
+void TestNaoVector::no_default_constructor() {
+    NaoVector<NoDefault> vec;
+
+    for (int i = 0; i < 50; ++i) {
+        vec.emplace_back(i);
+    }
+
+    vec.push_back(NoDefault(50));
+
+    QCOMPARE(std::size(vec), size_t(51));
+    QCOMPARE(vec.back().value, 50);
+
+    NaoVector<NoDefault> copy;
+    copy = vec;
+
+    QCOMPARE(copy[25].value, 25);
+}
+
+void TestNaoVector::insert() {
+    NaoVector<int> vec { 1, 2, 6 };
+    const int middle[] { 3, 4, 5 };
+
+    // Fits in the current capacity
+    vec.insert(std::begin(vec) + 2, std::begin(middle), std::end(middle));
+    QCOMPARE(std::size(vec), size_t(6));
+
+    for (int i = 0; i < 6; ++i) {
+        QCOMPARE(vec[i], i + 1);
+    }
+
+    // Needs to grow
+    NaoVector<int> many(40);
+    std::iota(std::begin(many), std::end(many), 100);
+
+    QCOMPARE(*vec.insert(std::begin(vec) + 1, std::begin(many), std::end(many)), 100);
+    QCOMPARE(std::size(vec), size_t(46));
+    QCOMPARE(vec[0], 1);
+    QCOMPARE(vec[40], 139);
+    QCOMPARE(vec[41], 2);
+    QCOMPARE(vec.back(), 6);
+
+    // Pushing an element of the vector itself, while reallocating
+    NaoVector<Counted> self(NaoVector<Counted>::data_alignment);
+    self.front().value = 7;
+    self.push_back(self.front());
+
+    QCOMPARE(self.back().value, 7);
+}
+
+void TestNaoVector::erase() {
+    NaoVector<int> vec { 1, 2, 3, 4, 5 };
+
+    QCOMPARE(*vec.erase(std::begin(vec) + 1), 3);
+    QCOMPARE(std::size(vec), size_t(4));
+
+    // end() may only be taken after erasing
+    const NaoVector<int>::iterator last = vec.erase(std::begin(vec) + 2, std::end(vec));
+
+    QCOMPARE(last, std::end(vec));
+    QCOMPARE(std::size(vec), size_t(2));
+    QCOMPARE(vec.back(), 3);
+}
+
+void TestNaoVector::empty_range() {
+    NaoVector<NaoString> vec;
+
+    for (int i = 0; i < 6; ++i) {
+        vec.push_back(NaoString::number(i));
+    }
+
+    // Empty ranges must leave every element untouched
+    QCOMPARE(*vec.erase(std::begin(vec) + 3, std::begin(vec) + 3), "3");
+
+    const NaoString* const none = nullptr;
+    QCOMPARE(*vec.insert(std::begin(vec) + 3, none, none), "3");
+
+    QCOMPARE(std::size(vec), size_t(6));
+
+    for (int i = 0; i < 6; ++i) {
+        QCOMPARE(vec[i], NaoString::number(i));
+    }
+}
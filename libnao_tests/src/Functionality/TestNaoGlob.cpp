@@ -0,0 +1,140 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Functionality/TestNaoGlob.h"
+
+#include <Functionality/NaoGlob.h>
+#include <Functionality/NaoPathFilter.h>
+
+void TestNaoGlob::star() {
+    const NaoGlob glob("*.wtp");
+
+    QVERIFY(glob.matches("tex.wtp"));
+    QVERIFY(glob.matches("TEX.WTP"));
+    QVERIFY(glob.matches(".wtp"));
+    QVERIFY(!glob.matches("tex.wtpx"));
+    QVERIFY(!glob.matches("tex.wta"));
+
+    // Without separators only the file name is matched
+    QVERIFY(glob.matches("ui/core/tex.wtp"));
+
+    // A single star stays within a directory
+    const NaoGlob dir("ui/*.wtp");
+
+    QVERIFY(dir.matches("ui/tex.wtp"));
+    QVERIFY(!dir.matches("ui/core/tex.wtp"));
+    QVERIFY(!dir.matches("data/ui/tex.wtp"));
+}
+
+void TestNaoGlob::double_star() {
+    const NaoGlob glob("core/**/*.bnk");
+
+    QVERIFY(glob.matches("core/a.bnk"));
+    QVERIFY(glob.matches("core/sound/a.bnk"));
+    QVERIFY(glob.matches("core/sound/en/a.bnk"));
+    QVERIFY(!glob.matches("core/sound/a.wem"));
+    QVERIFY(!glob.matches("data/core/a.bnk"));
+    QVERIFY(!glob.matches("coreX/a.bnk"));
+
+    const NaoGlob all("core/**");
+
+    QVERIFY(all.matches("core/a.bnk"));
+    QVERIFY(all.matches("core/sound/en/a.bnk"));
+    QVERIFY(!all.matches("data/a.bnk"));
+}
+
+void TestNaoGlob::sets() {
+    const NaoGlob glob("[!a-c]*.txt");
+
+    QVERIFY(glob.matches("d.txt"));
+    QVERIFY(glob.matches("readme.txt"));
+    QVERIFY(!glob.matches("a.txt"));
+    QVERIFY(!glob.matches("b1.txt"));
+    QVERIFY(!glob.matches("c.txt"));
+
+    const NaoGlob range("pl[0-9][0-9].dat");
+
+    QVERIFY(range.matches("pl01.dat"));
+    QVERIFY(!range.matches("pl0a.dat"));
+    QVERIFY(!range.matches("pl1.dat"));
+
+    // Neither sets nor '?' match a separator
+    QVERIFY(!NaoGlob("a[!x]b/c").matches("a/b/c"));
+    QVERIFY(!NaoGlob("a?b/c").matches("a/b/c"));
+    QVERIFY(NaoGlob("a?b/c").matches("a_b/c"));
+}
+
+void TestNaoGlob::separators() {
+    const NaoGlob glob("core\\**\\*.bnk");
+
+    QCOMPARE(glob.pattern(), "core/**/*.bnk");
+
+    QVERIFY(glob.matches("core/sound/a.bnk"));
+    QVERIFY(glob.matches("core\\sound\\a.bnk"));
+    QVERIFY(glob.matches("CORE\\a.BNK"));
+
+    // Mixed separators in a path are fine too
+    QVERIFY(NaoGlob("core/*/*.bnk").matches("core\\sound/a.bnk"));
+
+    // File name patterns still only see the last component
+    QVERIFY(NaoGlob("*.bnk").matches("core\\sound\\a.bnk"));
+    QVERIFY(!NaoGlob("sound*").matches("core\\sound\\a.bnk"));
+}
+
+void TestNaoGlob::filter() {
+    NaoPathFilter filter;
+
+    QVERIFY(filter.empty());
+    QVERIFY(filter.matches("anything/at/all"));
+
+    filter.exclude("*.txt");
+
+    QVERIFY(!filter.empty());
+    QVERIFY(filter.matches("core/a.bnk"));
+    QVERIFY(!filter.matches("core/readme.txt"));
+
+    // Once there are includes, a path must match one of them
+    filter.include("core/**/*.bnk");
+    filter.include("*.wtp");
+
+    QVERIFY(filter.matches("core/sound/a.bnk"));
+    QVERIFY(filter.matches("ui/tex.wtp"));
+    QVERIFY(!filter.matches("ui/tex.wta"));
+
+    // Excludes win over includes
+    filter.exclude("core/sound/**");
+
+    QVERIFY(filter.matches("core/a.bnk"));
+    QVERIFY(!filter.matches("core/sound/a.bnk"));
+    QVERIFY(!filter.matches("core\\sound\\a.bnk"));
+
+    // Regexes see '/' as separator and apply to the whole path
+    NaoPathFilter regex;
+
+    QVERIFY(regex.include_regex("core/[a-z]+\\.bnk"));
+    QVERIFY(!regex.include_regex("core/("));
+
+    QVERIFY(regex.matches("core\\A.bnk"));
+    QVERIFY(!regex.matches("core/sound/a.bnk"));
+
+    // Copies are independent
+    NaoPathFilter copy = filter;
+    copy.exclude("*.wtp");
+
+    QVERIFY(filter.matches("ui/tex.wtp"));
+    QVERIFY(!copy.matches("ui/tex.wtp"));
+}
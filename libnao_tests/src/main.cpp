@@ -19,6 +19,8 @@
 
 #include "Containers/TestNaoString.h"
 #include "Containers/TestNaoVector.h"
+#include "Containers/TestNaoSmallVector.h"
+#include "Functionality/TestNaoGlob.h"
 
 #define ASSERT_TEST(T) \
 { \
@@ -31,6 +33,8 @@ int main(int argc, char* argv[]){
 
     ASSERT_TEST(TestNaoString);
     ASSERT_TEST(TestNaoVector);
+    ASSERT_TEST(TestNaoSmallVector);
+    ASSERT_TEST(TestNaoGlob);
 
     return status;
 }
@@ -0,0 +1,85 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <libnao.h>
+
+#include <Containers/NaoString.h>
+#include <Containers/NaoVector.h>
+#include <Functionality/NaoPathFilter.h>
+
+class NaoIO;
+
+/*
+ * Flattens CPK and DAT archives into a list of the entries that pass a filter.
+ * Only archive indices are read, entries are described by their byte range in
+ * the archive they're in. Nested archives are optionally replaced by a
+ * directory holding their contents, these are read in place from the outer
+ * archive unless they are compressed.
+ * All IOs stay valid for as long as the walker exists.
+ */
+class ArchiveWalker {
+    public:
+
+    struct Entry {
+        // Path relative to the top archive, using N_PATHSEP
+        NaoString path;
+
+        // Innermost archive containing this entry
+        NaoIO* archive;
+
+        // Offset in archive
+        int64_t offset;
+
+        int64_t binary_size;
+        int64_t real_size;
+
+        bool compressed;
+    };
+
+    ArchiveWalker(bool recursive, const NaoPathFilter& filter);
+    ~ArchiveWalker();
+
+    ArchiveWalker(const ArchiveWalker&) = delete;
+    ArchiveWalker& operator=(const ArchiveWalker&) = delete;
+
+    // Add all matching entries in the archive in io, which must be open, returns false if it couldn't be read
+    bool walk(NaoIO* io);
+
+    N_NODISCARD const NaoVector<Entry>& entries() const;
+
+    // Number of archives read, including nested ones
+    N_NODISCARD size_t archive_count() const;
+
+    // Number of files in all archives that were read, before filtering
+    N_NODISCARD size_t scanned_count() const;
+
+    private:
+
+    bool _walk(NaoIO* io, const NaoString& prefix, size_t depth);
+
+    bool _m_recursive;
+    NaoPathFilter _m_filter;
+
+    NaoVector<Entry> _m_entries;
+    size_t _m_archives;
+    size_t _m_scanned;
+
+    // Nested archives, read in place or decompressed
+    NaoVector<NaoIO*> _m_ios;
+};
@@ -0,0 +1,118 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "ArchiveWalker.h"
+
+#define N_LOG_ID "ArchiveWalker"
+#include <Logging/NaoLogging.h>
+#include <Decoding/NaoDecodingException.h>
+#include <Decoding/Archives/NaoArchiveFormat.h>
+#include <IO/NaoIO.h>
+
+// Guards against archives that (claim to) contain themselves
+static constexpr size_t max_depth = 16;
+
+ArchiveWalker::ArchiveWalker(bool recursive, const NaoPathFilter& filter)
+    : _m_recursive(recursive)
+    , _m_filter(filter)
+    , _m_archives(0)
+    , _m_scanned(0) {
+
+}
+
+ArchiveWalker::~ArchiveWalker() {
+    for (NaoIO* io : _m_ios) {
+        delete io;
+    }
+}
+
+bool ArchiveWalker::walk(NaoIO* io) {
+    return _walk(io, NaoString(), 0);
+}
+
+const NaoVector<ArchiveWalker::Entry>& ArchiveWalker::entries() const {
+    return _m_entries;
+}
+
+size_t ArchiveWalker::archive_count() const {
+    return _m_archives;
+}
+
+size_t ArchiveWalker::scanned_count() const {
+    return _m_scanned;
+}
+
+//// Private
+
+bool ArchiveWalker::_walk(NaoIO* io, const NaoString& prefix, size_t depth) {
+    // Only the index is needed, no objects or IOs are created for the entries
+    NaoVector<NaoArchiveIndexCache::Entry> index;
+
+    try {
+        index = NaoArchiveFormat::index(io, NaoArchiveFormat::detect(io));
+    } catch (const NaoDecodingException& e) {
+        nerr << e.what();
+        return false;
+    }
+
+    ++_m_archives;
+
+    for (const NaoArchiveIndexCache::Entry& item : index) {
+        // Directories are implied by the paths of their children
+        if (item.is_dir) {
+            continue;
+        }
+
+        ++_m_scanned;
+
+        Entry entry {
+            std::empty(prefix) ? item.name : (prefix + item.name),
+            io,
+            item.offset,
+            item.binary_size,
+            item.real_size,
+            item.binary_size != item.real_size
+        };
+
+        if (_m_recursive && depth < max_depth) {
+            NaoIO* nested = nullptr;
+
+            try {
+                nested = NaoArchiveFormat::open(io, entry.offset, entry.binary_size);
+            } catch (const NaoDecodingException& e) {
+                nwarn << "Keeping unreadable nested archive" << entry.path << e.what();
+            }
+
+            if (nested) {
+                _m_ios.push_back(nested);
+
+                // The archive becomes a directory with the same (cleaned) name
+                if (_walk(nested, NaoArchiveFormat::expanded_path(entry.path) + N_PATHSEP, depth + 1)) {
+                    continue;
+                }
+
+                nwarn << "Keeping unreadable nested archive" << entry.path;
+            }
+        }
+
+        if (_m_filter.matches(entry.path)) {
+            _m_entries.push_back(entry);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,335 @@
+/*
+    This file is part of libnao.
+
+    libnao is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libnao is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with libnao.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "ArchiveWalker.h"
+
+#define N_LOG_ID "naocli"
+#include <Logging/NaoLogging.h>
+#include <IO/NaoFileIO.h>
+#include <IO/NaoExtractionPipeline.h>
+#include <Functionality/NaoPathFilter.h>
+#include <Decoding/Compression/NaoCRILAYLA.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static constexpr const char* usage =
+    "Usage: naocli <command> [options] <archive>...\n"
+    "\n"
+    "Commands:\n"
+    "  list                  List all files\n"
+    "  extract               Extract files to <output>/<archive name>/\n"
+    "  index                 Print offset (in the containing archive), stored size, real size,\n"
+    "                        compression and path of all files\n"
+    "\n"
+    "Options:\n"
+    "  -o, --output <dir>    Output directory for extract (default: current directory)\n"
+    "  -i, --include <glob>  Only process files matching glob, may be repeated\n"
+    "  -x, --exclude <glob>  Skip files matching glob, may be repeated\n"
+    "  --include-regex <re>  Only process files whose whole path matches re, may be repeated\n"
+    "  --exclude-regex <re>  Skip files whose whole path matches re, may be repeated\n"
+    "  -r, --recursive       Descend into nested archives, extract expands them while extracting\n"
+    "  -j, --threads <n>     Threads per extraction stage (default: based on core count)\n"
+    "  -q, --quiet           Only print errors and statistics\n"
+    "  -h, --help            Show this message\n"
+    "\n"
+    "Globs: '*' stays within a directory, '**' crosses directories, '?' and [a-z] match\n"
+    "a single character. Globs without a separator match the file name only.\n"
+    "Filters are matched against the archive index, only matching files are read.\n"
+    "When extracting recursively, files are first checked for being an archive.\n";
+
+enum class Command {
+    List,
+    Extract,
+    Index
+};
+
+struct Options {
+    Command command;
+
+    NaoString output = ".";
+    NaoPathFilter filter;
+
+    bool recursive = false;
+    bool quiet = false;
+    size_t threads = 0;
+
+    NaoVector<NaoString> archives;
+};
+
+static bool parse_args(int argc, char** argv, Options& options) {
+    if (argc < 2) {
+        return false;
+    }
+
+    if (std::strcmp(argv[1], "list") == 0) {
+        options.command = Command::List;
+    } else if (std::strcmp(argv[1], "extract") == 0) {
+        options.command = Command::Extract;
+    } else if (std::strcmp(argv[1], "index") == 0) {
+        options.command = Command::Index;
+    } else {
+        if (std::strcmp(argv[1], "-h") != 0 && std::strcmp(argv[1], "--help") != 0) {
+            nerr << "Unknown command" << argv[1];
+        }
+
+        return false;
+    }
+
+    for (int i = 2; i < argc; ++i) {
+        const char* arg = argv[i];
+
+        auto is = [arg](const char* short_name, const char* long_name) {
+            return std::strcmp(arg, short_name) == 0 || std::strcmp(arg, long_name) == 0;
+        };
+
+        // Value of an option that takes one
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                nerr << "Missing value for" << arg;
+                return nullptr;
+            }
+
+            return argv[++i];
+        };
+
+        if (is("-o", "--output")) {
+            const char* dir = value();
+            if (!dir) {
+                return false;
+            }
+
+            options.output = dir;
+        } else if (is("-i", "--include")) {
+            const char* glob = value();
+            if (!glob) {
+                return false;
+            }
+
+            options.filter.include(glob);
+        } else if (is("-x", "--exclude")) {
+            const char* glob = value();
+            if (!glob) {
+                return false;
+            }
+
+            options.filter.exclude(glob);
+        } else if (std::strcmp(arg, "--include-regex") == 0) {
+            const char* regex = value();
+            if (!regex || !options.filter.include_regex(regex)) {
+                return false;
+            }
+        } else if (std::strcmp(arg, "--exclude-regex") == 0) {
+            const char* regex = value();
+            if (!regex || !options.filter.exclude_regex(regex)) {
+                return false;
+            }
+        } else if (is("-r", "--recursive")) {
+            options.recursive = true;
+        } else if (is("-q", "--quiet")) {
+            options.quiet = true;
+        } else if (is("-j", "--threads")) {
+            const char* threads = value();
+            if (!threads) {
+                return false;
+            }
+
+            options.threads = std::strtoull(threads, nullptr, 10);
+        } else if (is("-h", "--help")) {
+            return false;
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            nerr << "Unknown option" << arg;
+            return false;
+        } else {
+            options.archives.push_back(arg);
+        }
+    }
+
+    if (std::empty(options.archives)) {
+        nerr << "No archives given";
+        return false;
+    }
+
+    return true;
+}
+
+static double mib_per_second(int64_t bytes, double seconds) {
+    return (seconds > 0.) ? (bytes / (1024. * 1024.) / seconds) : 0.;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+
+    if (!parse_args(argc, argv, options)) {
+        std::fputs(usage, stderr);
+        return 2;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    bool success = true;
+
+    // Everything must stay alive until the pipeline has run
+    NaoVector<NaoFileIO*> files;
+    NaoVector<ArchiveWalker*> walkers;
+
+    // Nested archives are expanded by the pipeline's readers, instead of walking them up front
+    const bool expand = options.command == Command::Extract && options.recursive;
+
+    NaoExtractionPipeline::Config config;
+    config.readers = options.threads;
+    config.transformers = options.threads;
+    config.writers = options.threads;
+
+    if (expand) {
+        config.expand_archives = true;
+        config.filter = options.filter;
+    }
+
+    NaoExtractionPipeline pipeline(config);
+
+    size_t archives = 0;
+    size_t scanned = 0;
+    size_t selected_count = 0;
+    int64_t selected_size = 0;
+
+    for (const NaoString& path : options.archives) {
+        NaoFileIO* file = new NaoFileIO(path);
+        files.push_back(file);
+
+        if (!file->open(NaoIO::ReadOnly)) {
+            nerr << "Failed opening" << path;
+            success = false;
+            continue;
+        }
+
+        ArchiveWalker* walker = expand
+            ? new ArchiveWalker(false, NaoPathFilter())
+            : new ArchiveWalker(options.recursive, options.filter);
+        walkers.push_back(walker);
+
+        if (!walker->walk(file)) {
+            nerr << "Failed reading" << path;
+            success = false;
+            continue;
+        }
+
+        archives += walker->archive_count();
+        scanned += walker->scanned_count();
+
+        const NaoString out_dir = options.output + N_PATHSEP
+            + NaoString(fs::path(path).filename()).clean_dir_name();
+
+        for (const ArchiveWalker::Entry& entry : walker->entries()) {
+            ++selected_count;
+            selected_size += entry.binary_size;
+
+            switch (options.command) {
+                case Command::List:
+                    if (!options.quiet) {
+                        std::printf("%12" PRId64 "  %s%c%s\n", entry.real_size,
+                            path.c_str(), N_PATHSEP, entry.path.c_str());
+                    }
+                    break;
+
+                case Command::Index:
+                    if (!options.quiet) {
+                        std::printf("%#12" PRIx64 " %12" PRId64 " %12" PRId64 " %c %s%c%s\n",
+                            entry.offset, entry.binary_size, entry.real_size,
+                            entry.compressed ? 'C' : '-',
+                            path.c_str(), N_PATHSEP, entry.path.c_str());
+                    }
+                    break;
+
+                case Command::Extract:
+                    // The path lets the pipeline filter files after expanding archives
+                    pipeline.submit({
+                        entry.archive,
+                        out_dir + N_PATHSEP + entry.path,
+                        entry.compressed ? &NaoCRILAYLA::decompress_in_place : nullptr,
+                        entry.offset,
+                        entry.binary_size,
+                        expand ? entry.path : NaoString()
+                    });
+                    break;
+            }
+        }
+    }
+
+    const double index_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (options.command == Command::Extract) {
+        int last_percent = -1;
+
+        if (!pipeline.run([&](int64_t done) {
+                const int percent = int(done * 100 / std::max<int64_t>(pipeline.total_size(), 1));
+
+                if (!options.quiet && percent != last_percent) {
+                    last_percent = percent;
+                    std::fprintf(stderr, "\r%3d%%", percent);
+                }
+            })) {
+            nerr << "Failed extracting" << pipeline.failed() << "files";
+            success = false;
+        }
+
+        if (!options.quiet) {
+            std::fputc('\n', stderr);
+        }
+    }
+
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    // Statistics go to stderr, so listings can be piped
+    if (expand) {
+        const size_t files = pipeline.count() - pipeline.expanded();
+
+        std::fprintf(stderr, "%zu archives, %zu of %zu files, found while extracting\n",
+            archives + pipeline.expanded(), files - pipeline.skipped(), files);
+    } else {
+        std::fprintf(stderr, "%zu archives, %zu of %zu files, %s indexed in %.3f s\n",
+            archives, selected_count, scanned,
+            NaoString::bytes(uint64_t(selected_size)).c_str(), index_seconds);
+    }
+
+    if (options.command == Command::Extract) {
+        const double extract_seconds = seconds - index_seconds;
+
+        std::fprintf(stderr, "%s read, %s written in %.3f s (%.1f MiB/s in, %.1f MiB/s out)\n",
+            NaoString::bytes(uint64_t(pipeline.total_size())).c_str(),
+            NaoString::bytes(uint64_t(pipeline.bytes_written())).c_str(),
+            extract_seconds,
+            mib_per_second(pipeline.total_size(), extract_seconds),
+            mib_per_second(pipeline.bytes_written(), extract_seconds));
+    }
+
+    for (ArchiveWalker* walker : walkers) {
+        delete walker;
+    }
+
+    for (NaoFileIO* file : files) {
+        delete file;
+    }
+
+    return success ? 0 : 1;
+}